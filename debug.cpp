@@ -62,7 +62,7 @@ void print_rs (rates& rs) {
 	todo:
 */
 void print_cl (con_levels& cl) {
-	for (int i = 0; i < cl.num_con_levels; i++) {
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		print_con(cl, i);
 	}
 }
@@ -77,7 +77,7 @@ void print_cl (con_levels& cl) {
 */
 void print_cl_at (con_levels& cl, int timestep) {
 	cerr << "timestep: " << timestep << ", concentrations:\n";
-	for (int i = 0; i < cl.num_con_levels; i++) {
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		cerr << "  " << i << ": " << cl.cons[i][timestep][0];
 		for (int k = 1; k < cl.cells; k++) {
 			cerr << "," << cl.cons[i][timestep][k];
@@ -94,7 +94,7 @@ void print_cl_at (con_levels& cl, int timestep) {
 	todo:
 */
 void print_cl_when_nonzero (con_levels& cl) {
-	for (int i = 0; i < cl.num_con_levels; i++) {
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		for (int j = 0; j < cl.time_steps; j++) {
 			for (int k = 0; k < cl.cells; k++) {
 				if (cl.cons[i][j][k] != 0) {
@@ -116,9 +116,9 @@ void print_cl_when_nonzero (con_levels& cl) {
 */
 void print_cl_when_same (con_levels& cl) {
 	for (int j = 0; j < cl.time_steps; j++) {
-		double value = cl.cons[0][j][0];
+		double value = cl.cons[cl.first_level][j][0];
 		bool same = true;
-		for (int i = 0; i < cl.num_con_levels; i++) {
+		for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 			for (int k = 0; k < cl.cells; k++) {
 				if (cl.cons[i][j][k] != value) {
 					same = false;
@@ -146,10 +146,10 @@ void print_cl_when_same (con_levels& cl) {
 void print_cl_when_different (con_levels& cl) {
 	for (int j = 0; j < cl.time_steps; j++) {
 		bool different = false;
-		for (int i = 0; i < cl.num_con_levels; i++) {		
+		for (int i = cl.first_level; i < cl.num_con_levels; i++) {		
 			double value = cl.cons[i][j][0];
 			for (int k = 0; k < cl.cells; k++) {
-				if (i != BIRTH && cl.cons[i][j][k] != value && cl.cons[i][j][k] != 0) {
+				if (cl.cons[i][j][k] != value && cl.cons[i][j][k] != 0) {
 					different = true;
 					cerr << "timestep: " << j << ", cell: " << k << ", value: " << i << "\n";
 				}
@@ -208,7 +208,7 @@ void print_con_at (con_levels& cl, int concentration, int timestep) {
 void print_cl_nonzero_at (con_levels& cl, int timestep) {
 	cerr << "timestep: " << timestep << ", nonzero: ";
 	bool first = true;
-	for (int i = 0; i < cl.num_con_levels; i++) {
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		for (int k = 0; k < cl.cells; k++) {
 			if (cl.cons[i][timestep][k] != 0) {
 				if (first) {
@@ -235,8 +235,103 @@ void print_cl_nonzero_at (con_levels& cl, int timestep) {
 */
 void print_cl_at_for (con_levels& cl, int timestep, int cell) {
 	cerr << "timestep: " << timestep << ", cell: " << cell << "\n";
-	for (int i = 0; i < cl.num_con_levels; i++) {
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		cerr << "  concentration " << i << ": " << cl.cons[i][timestep][cell] << "\n";
 	}
 }
 
+
+/* decompress_block decompresses a block in the LZ4 block format (see compress_block in io.cpp)
+	parameters:
+		src: the compressed block
+		size: the size in bytes of the compressed block
+		dst: the buffer to decompress into
+		max_size: the size in bytes of dst
+	returns: the size in bytes of the decompressed block, or -1 if the block is malformed or does not fit in dst
+	notes:
+	todo:
+*/
+int decompress_block (const unsigned char* src, int size, unsigned char* dst, int max_size) {
+	const unsigned char* end = src + size;
+	int out = 0;
+	while (src < end) {
+		int token = *src++;
+		int num_literals = token >> 4;
+		if (num_literals == 15) {
+			int more;
+			do {
+				if (src >= end) {
+					return -1;
+				}
+				more = *src++;
+				num_literals += more;
+			} while (more == 255);
+		}
+		if (num_literals > end - src || num_literals > max_size - out) {
+			return -1;
+		}
+		memcpy(dst + out, src, num_literals);
+		src += num_literals;
+		out += num_literals;
+		if (src == end) { // The last sequence has only literals
+			break;
+		}
+		if (end - src < 2) {
+			return -1;
+		}
+		int offset = src[0] | (src[1] << 8);
+		src += 2;
+		int length = (token & 15) + LZ_MIN_MATCH;
+		if ((token & 15) == 15) {
+			int more;
+			do {
+				if (src >= end) {
+					return -1;
+				}
+				more = *src++;
+				length += more;
+			} while (more == 255);
+		}
+		if (offset == 0 || offset > out || length > max_size - out) {
+			return -1;
+		}
+		for (int i = 0; i < length; i++, out++) { // Byte by byte since the match can overlap what it copies
+			dst[out] = dst[out - offset];
+		}
+	}
+	return out;
+}
+
+/* check_ccons_column checks that a column of a chunked concentrations file decodes to the values it was written from
+	parameters:
+		data: the column as written to the file
+		size: the size in bytes of the column as written
+		column: the column's values as bits, indexed by [time steps][cells]
+		num_steps: the number of time steps in the column
+		cells: the number of cells in each time step
+	returns: true if the column decodes to exactly the given values, false otherwise
+	notes:
+		This decodes the column the way a reader of the file would (see ccons_header): a column whose size equals its raw size is raw, otherwise it is decompressed, its planes of bytes are joined, and its deltas are added back up.
+	todo:
+*/
+bool check_ccons_column (const unsigned char* data, int size, const uint32_t* column, int num_steps, int cells) {
+	int num_values = num_steps * cells;
+	int raw_size = sizeof(uint32_t) * num_values;
+	if (size == raw_size) {
+		return memcmp(data, column, raw_size) == 0;
+	}
+	unsigned char* planes = new unsigned char[raw_size];
+	bool same = decompress_block(data, size, planes, raw_size) == raw_size;
+	for (int i = 0; same && i < num_values; i++) {
+		uint32_t value = 0;
+		for (int b = 0; b < (int)sizeof(uint32_t); b++) {
+			value |= (uint32_t)planes[b * num_values + i] << (8 * b);
+		}
+		if (i >= cells) {
+			value += column[i - cells];
+		}
+		same = value == column[i];
+	}
+	delete[] planes;
+	return same;
+}
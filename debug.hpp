@@ -36,6 +36,8 @@ void print_con(con_levels&, int);
 void print_con_at(con_levels&, int, int);
 void print_cl_nonzero_at(con_levels&, int);
 void print_cl_at_for(con_levels&, int, int);
+int decompress_block(const unsigned char*, int, unsigned char*, int);
+bool check_ccons_column(const unsigned char*, int, const uint32_t*, int, int);
 
 #endif
 
@@ -40,6 +40,21 @@ For the time being, I'm focusing on obtaining the needed data.
 actual_cell: the index of the cell in the PSM
 */
 
+/* same_cell checks whether the given position in the PSM held the same cell at both given analysis time steps
+	parameters:
+		sd: the current simulation's data
+		cell: the index of the cell in the PSM
+		time1: the first time step of the analysis cl
+		time2: the second time step of the analysis cl
+	returns: true if no cell was born at the position between the two time steps, false otherwise
+	notes:
+		Analysis time steps are sd.big_gran simulation time steps apart.
+	todo:
+*/
+bool same_cell (sim_data& sd, int cell, int time1, int time2) {
+	return sd.lin.born(cell, time1 * sd.big_gran) == sd.lin.born(cell, time2 * sd.big_gran);
+}
+
 /*
  * This function would look at the concentrations level index mr of a cell specified by actual_cell at every time steps
  * Find out the peaks and troughs by comparing the c.l of a timestep compared to 2 mins before and 2 mins after that time step. 
@@ -53,11 +68,18 @@ int get_peaks_and_troughs1 (sim_data& sd, con_levels& cl, int actual_cell, int t
 	
 	int num_points = 0; // number of critical point (peaks and troughs)
 	int col = actual_cell % sd.width_total;// which column in PSM does this cell belong to
-	double** conc = cl.cons[mr];
+	con_slice conc = cl.cons[mr];
+	
+	// The peaks and troughs are the strict extrema of the windows reaching 2 minutes before and after each time step
+	double reach = 2 / sd.step_size / sd.big_gran;
+	int window_size = 2 * (int)reach + 8; // Enough for the time steps of two consecutive windows, with room for rounding
+	extremum_window peaks(conc, actual_cell, true, window_size);
+	extremum_window troughs(conc, actual_cell, false, window_size);
+	int next_time = time_start; // The next time step to add to the windows
 	
 	// looping through the time steps, as long as the cell at different time step is born at the same time? 20160519: Isnt the condition about birth time redundant because the birthtime of a cell is always
 	// the same throughout its life time? 
-	for (int j = time_start + 1; j < sd.time_end - 1 && cl.cons[BIRTH][j][actual_cell] == cl.cons[BIRTH][j - 1][actual_cell] && cl.cons[BIRTH][j][actual_cell] == cl.cons[BIRTH][j + 1][actual_cell]; j++) {
+	for (int j = time_start + 1; j < sd.time_end - 1 && same_cell(sd, actual_cell, j, j - 1) && same_cell(sd, actual_cell, j, j + 1); j++) {
 		
 		//find the actual position of the cell in the PSM based on its index given by actual_cell, This is necessary because of the data structure we use to build the concentration table 
 		int pos = 0;//which column in PSM does this belong to
@@ -68,13 +90,15 @@ int get_peaks_and_troughs1 (sim_data& sd, con_levels& cl, int actual_cell, int t
 		}
 	
 		// check if the current point is a peak
-		bool is_peak = true;
 		// define: the peak is as the step with highest concentration compared to the timesteps 2 mins before and after that time step
-		for (int k = MAX(j - (2 / sd.step_size / sd.big_gran), time_start); k <= MIN(j + 2 / sd.step_size / sd.big_gran, sd.time_end); k++) {
-			if (conc[j][actual_cell] <= conc[k][actual_cell] && j!=k) {
-				is_peak = false;
-			}
+		int window_start = MAX(j - reach, time_start);
+		for (; next_time <= MIN(j + reach, sd.time_end); next_time++) {
+			peaks.add(next_time);
+			troughs.add(next_time);
 		}
+		peaks.drop_before(window_start);
+		troughs.drop_before(window_start);
+		bool is_peak = peaks.strict(j);
 		// if a peak, record the time step, type (PEAK) and position
 		if (is_peak) {
 			crit_points[num_points] = j;
@@ -84,12 +108,7 @@ int get_peaks_and_troughs1 (sim_data& sd, con_levels& cl, int actual_cell, int t
 		}
 		
 		// check if the current point is a trough
-		bool is_trough = true;
-		for (int k = MAX(j - (2 / sd.step_size / sd.big_gran), time_start); k <= MIN(j + 2 / sd.step_size / sd.big_gran, sd.time_end ); k++) {
-			if (conc[j][actual_cell] >= conc[k][actual_cell] && j!=k) {
-				is_trough = false;
-			}
-		}
+		bool is_trough = troughs.strict(j);
 		if (is_trough) {
 			crit_points[num_points] = j;
 			type[num_points] = -1;
@@ -115,10 +134,18 @@ int get_peaks_and_troughs2 (sim_data& sd, con_levels& cl, int actual_cell, int t
 	int num_points = 0;
 	int col = actual_cell % sd.width_total;// column index of the cell we are looking at
 	
-	double** conc = cl.cons[mr];
+	con_slice conc = cl.cons[mr];
 	int compl_count=0;
+	
+	// The peaks and troughs are the strict extrema of the windows reaching 2 minutes before and after each time step
+	double reach = 2 / sd.step_size / sd.big_gran;
+	int window_size = 2 * (int)reach + 8; // Enough for the time steps of two consecutive windows, with room for rounding
+	extremum_window peaks(conc, actual_cell, true, window_size);
+	extremum_window troughs(conc, actual_cell, false, window_size);
+	int next_time = time_start; // The next time step to add to the windows
+	
 	// loop through the time steps. 20160519: I think the part where we check the birth time is redundant
-	for (int j = time_start + 1; j < sd.time_end - 1 && cl.cons[BIRTH][j][actual_cell] == cl.cons[BIRTH][j - 1][actual_cell] && cl.cons[BIRTH][j][actual_cell] == cl.cons[BIRTH][j + 1][actual_cell]; j++) {
+	for (int j = time_start + 1; j < sd.time_end - 1 && same_cell(sd, actual_cell, j, j - 1) && same_cell(sd, actual_cell, j, j + 1); j++) {
 		
 		mh1_comp[compl_count]=cl.cons[CMH1][j][actual_cell];                 //record concentration value of mh1 151221
 		mespa_comp[compl_count]=cl.cons[CMMESPA][j][actual_cell];           //record concentration value of mespa 151221
@@ -133,13 +160,14 @@ int get_peaks_and_troughs2 (sim_data& sd, con_levels& cl, int actual_cell, int t
 		}
 	
 		// check if the current point is a peak
-		bool is_peak = true;
-		for (int k = MAX(j - (2 / sd.step_size / sd.big_gran), time_start); k <= MIN(j + 2 / sd.step_size / sd.big_gran, sd.time_end - 1); k++) {
-			if (conc[j][actual_cell] <= conc[k][actual_cell] && j!=k) {
-				is_peak = false;
-				
-			}
+		int window_start = MAX(j - reach, time_start);
+		for (; next_time <= MIN(j + reach, sd.time_end - 1); next_time++) {
+			peaks.add(next_time);
+			troughs.add(next_time);
 		}
+		peaks.drop_before(window_start);
+		troughs.drop_before(window_start);
+		bool is_peak = peaks.strict(j);
 		if (is_peak) {
 			crit_points[num_points] = j;
 			type[num_points] = 1;
@@ -148,12 +176,7 @@ int get_peaks_and_troughs2 (sim_data& sd, con_levels& cl, int actual_cell, int t
 		}
 		
 		// check if the current point is a trough
-		bool is_trough = true;
-		for (int k = MAX(j - (2 / sd.step_size / sd.big_gran), time_start); k <= MIN(j + 2 / sd.step_size / sd.big_gran, sd.time_end - 1); k++) {
-			if (conc[j][actual_cell] >= conc[k][actual_cell] && j!=k) {
-				is_trough = false;
-			}
-		}
+		bool is_trough = troughs.strict(j);
 		if (is_trough) {
 			crit_points[num_points] = j;
 			type[num_points] = -1;
@@ -192,8 +215,23 @@ double test_compl(sim_data& sd, double* con1, double* con2) {  // 151221: calcul
 }
 
 
-
+/* osc_features_ant calculates the oscillation features of mh1, mh7, mdelta, mespa, and mespb in the anterior
+	parameters:
+		sd: the current simulation's data
+		ip: the program's input parameters
+		wtfeat: the oscillation features the wild type produced
+		filename_feats: the directory to print the features files to (if ip.ant_features)
+		cl: the concentration levels of the anterior simulation
+		md: the mutant being analyzed, whose features are stored in md.feat
+		start_line, end_line, start_col, end_col: the lines and columns of cells to analyze
+		set_num: the index of the parameter set being simulated
+	returns: nothing
+	notes:
+		Only the features in md.demand are calculated, see declare_feature_demands.
+	todo:
+*/
 void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* filename_feats, con_levels& cl, mutant_data& md, int start_line, int end_line, int start_col, int end_col, int set_num) {
+	phase_timer timer(sd, PHASE_FEATURES_ANT);
 	static int con[5] = {CMH1, CMH7, CMDELTA, CMMESPA, CMMESPB};
 	static int ind[5] = {IMH1, IMH7, IMDELTA, IMMESPA, IMMESPB};
 	static const char* concs[5] = {"mh1", "mh7," "mdelta", "mespa", "mespb"};
@@ -217,6 +255,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 	memset(mh1_comp, 0, sizeof(double) * (sd.width_total*sd.steps_split - 2));
 	memset(mespa_comp, 0, sizeof(double) * (sd.width_total*sd.steps_split - 2));
 	memset(mespb_comp, 0, sizeof(double) * (sd.width_total*sd.steps_split - 2));
+	bool need_comp = md.demand.needs(FD_COMP, IMMESPA) || md.demand.needs(FD_COMP, IMMESPB); // Whether the complementary expression of mespa and mespb is tested
 	
 	
 	//Loop through all of 5 gene concentrations we are interested in. 
@@ -238,202 +277,209 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 		
 		int mr = con[i];
 		int index = ind[i];
-		double** conc = cl.cons[mr];//concentration level table for the gene we are looking at.
+		con_slice conc = cl.cons[mr];//concentration level table for the gene we are looking at.
 		double amp_avg = 0;	// average amplitude of this genes over all the cells
 		double period_avg = 0; // average period of this gene over all cells
         int time_start;
 		int num_cells_passed = 0;
 		
-		//determine time start: 20160519: Right now, the time start is always anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split);
-		if (md.induction == 0) {
-		    time_start = anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split); // time after which the PSM is full of cells
-        } else {
-            //time_start = anterior_time(sd, md.induction + (30 / sd.big_gran));
-			time_start = anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split);//anterior_time(sd, sd.steps_til_growth + (30 / sd.step_size));
-        }
+		// Only follow the peaks and troughs of every cell if a feature found from them is needed
+		bool need_period_time = md.demand.needs(FD_PERIOD_TIME, index);
+		bool analyze_cells = md.demand.needs(FD_PERIOD_ANT, index) || md.demand.needs(FD_AMPLITUDE_ANT, index) || need_period_time || (mr == CMMESPA && need_comp);
+		if (analyze_cells) {
+			//determine time start: 20160519: Right now, the time start is always anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split);
+			if (md.induction == 0) {
+			    time_start = anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split); // time after which the PSM is full of cells
+	        } else {
+	            //time_start = anterior_time(sd, md.induction + (30 / sd.big_gran));
+				time_start = anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial) * sd.steps_split);//anterior_time(sd, sd.steps_til_growth + (30 / sd.step_size));
+	        }
         
-        // loop through all the cells in the antrior part of the thing
-		for (int col = start_col; col < end_col; col++) {						
-			for (int line = start_line; line < end_line; line++) {
-				int pos = cl.active_start_record[time_start]; // always looking at cell at position active_start because that is the newest cell
-				int cell = line * sd.width_total + pos;	//index of the cell
-				int num_points = 0;
+	        // loop through all the cells in the antrior part of the thing
+			for (int col = start_col; col < end_col; col++) {						
+				for (int line = start_line; line < end_line; line++) {
+					int pos = cl.active_start_record[time_start]; // always looking at cell at position active_start because that is the newest cell
+					int cell = line * sd.width_total + pos;	//index of the cell
+					int num_points = 0;
 				
-				// calulate crit_points, type and position of critical points of this gene we are looking at of this cell 
-				//20160519: Shouldn't we say mr!=CMMESPA and mr != CMMESPB? Check with Prof. Ay to update this part.
-				// Or maybe we do not need to because only to calculate these complementary once?
-                if ( mr != CMMESPA) {
-				    num_points = get_peaks_and_troughs1(sd, cl, cell, time_start, crit_points, type, position, mr);
-                } else {// if we are calculating osc features of CMMESPA
-					num_points = get_peaks_and_troughs2(sd, cl, cell, time_start, crit_points, type, position, mr, mh1_comp, mespa_comp, mespb_comp);  // 151221: get_peaks_and_troughs2 records the concentration value of mh1, mespa and mespb and store them in mh1_comp, mespa_comp, mespb_comp
-					// calculate the correlations of mh1 and mespa, then mh1 and mespb
-					comp_score_a+=test_compl(sd, mh1_comp, mespa_comp);
-					comp_score_b+=test_compl(sd, mh1_comp, mespb_comp);
-				}
+					// calulate crit_points, type and position of critical points of this gene we are looking at of this cell 
+					//20160519: Shouldn't we say mr!=CMMESPA and mr != CMMESPB? Check with Prof. Ay to update this part.
+					// Or maybe we do not need to because only to calculate these complementary once?
+	                if ( mr != CMMESPA) {
+					    num_points = get_peaks_and_troughs1(sd, cl, cell, time_start, crit_points, type, position, mr);
+	                } else {// if we are calculating osc features of CMMESPA
+						num_points = get_peaks_and_troughs2(sd, cl, cell, time_start, crit_points, type, position, mr, mh1_comp, mespa_comp, mespb_comp);  // 151221: get_peaks_and_troughs2 records the concentration value of mh1, mespa and mespb and store them in mh1_comp, mespa_comp, mespb_comp
+						// calculate the correlations of mh1 and mespa, then mh1 and mespb
+						if (need_comp) {
+							comp_score_a+=test_compl(sd, mh1_comp, mespa_comp);
+							comp_score_b+=test_compl(sd, mh1_comp, mespb_comp);
+						}
+					}
 				
-				// after done finding the peaks and troughs of the cell by running through all times steps
-				// now find the period and amplitudes
-				double periods[num_points];	//array of period length through the life time of the cell 
-				double per_pos[num_points];
-                double per_time[num_points];
-				double amplitudes[num_points];
-				double amp_pos[num_points];
-                //double amp_time[num_points]; // amp_time is not used in the new calculation methods
-				memset(periods, 0, sizeof(double) * num_points);
-				memset(amplitudes, 0, sizeof(double) * num_points);
-				memset(per_pos, 0, sizeof(double) * num_points);
-				memset(amp_pos, 0, sizeof(double) * num_points);
-
-				int pers = 0;	// period index, used for periods[]
-				int amps = 0;	// amplitude index, used for amplitudes[]
-				if (num_points >= 3) { 
-					// Calculate all the periods and amplitudes
+					// after done finding the peaks and troughs of the cell by running through all times steps
+					// now find the period and amplitudes
+					double periods[num_points];	//array of period length through the life time of the cell 
+					double per_pos[num_points];
+	                double per_time[num_points];
+					double amplitudes[num_points];
+					double amp_pos[num_points];
+	                //double amp_time[num_points]; // amp_time is not used in the new calculation methods
+					memset(periods, 0, sizeof(double) * num_points);
+					memset(amplitudes, 0, sizeof(double) * num_points);
+					memset(per_pos, 0, sizeof(double) * num_points);
+					memset(amp_pos, 0, sizeof(double) * num_points);
+
+					int pers = 0;	// period index, used for periods[]
+					int amps = 0;	// amplitude index, used for amplitudes[]
+					if (num_points >= 3) { 
+						// Calculate all the periods and amplitudes
 					
- 					// Find the first peak and the first trough occurring in the graph
-					int cur_point = 0;
+	 					// Find the first peak and the first trough occurring in the graph
+						int cur_point = 0;
 					
-					for (; cur_point < num_points; cur_point++) {		
-						// Check for period
-						if (type[cur_point] == 1 && cur_point >= 2) {
-							periods[pers] = (crit_points[cur_point] - crit_points[cur_point - 2]) * sd.step_size * sd.big_gran;
-							per_pos[pers] = position[cur_point - 2] + (position[cur_point] - position[cur_point - 2]) / 2;
-                            per_time[pers] = periods[pers]/2;//(crit_points[cur_point] - crit_points[cur_point - 2]) / 2 * sd.step_size * sd.big_gran;
-							pers++;
-						}
+						for (; cur_point < num_points; cur_point++) {		
+							// Check for period
+							if (type[cur_point] == 1 && cur_point >= 2) {
+								periods[pers] = (crit_points[cur_point] - crit_points[cur_point - 2]) * sd.step_size * sd.big_gran;
+								per_pos[pers] = position[cur_point - 2] + (position[cur_point] - position[cur_point - 2]) / 2;
+	                            per_time[pers] = periods[pers]/2;//(crit_points[cur_point] - crit_points[cur_point - 2]) / 2 * sd.step_size * sd.big_gran;
+								pers++;
+							}
 						
-						// Check for amplitude
-						if (type[cur_point] == 1 && cur_point >= 1 && cur_point < num_points - 1) {
-							amplitudes[amps] = conc[crit_points[cur_point]][cell] - (conc[crit_points[cur_point - 1]][cell] + conc[crit_points[cur_point + 1]][cell]) / 2;
-							amp_pos[amps] = position[cur_point];
-                            //amp_time[amps] = crit_points[cur_point];
-							amps++;
+							// Check for amplitude
+							if (type[cur_point] == 1 && cur_point >= 1 && cur_point < num_points - 1) {
+								amplitudes[amps] = conc[crit_points[cur_point]][cell] - (conc[crit_points[cur_point - 1]][cell] + conc[crit_points[cur_point + 1]][cell]) / 2;
+								amp_pos[amps] = position[cur_point];
+	                            //amp_time[amps] = crit_points[cur_point];
+								amps++;
+							}
 						}
-					}
 					
-					//// Giudicelli test 20160519: This can be separated into a function
-					bool passed = true;
-					// Try to fit out period data to the curve provided by Giudicelli et al.
-					if (pers < 3) { // If we don't have at least 3 periods then the oscillations were not good enough
-						passed = false;
-					} else {
-						int first_fit = per_pos[0] * 100 / (sd.width_total - 1); // Find the place on the curve of the first period for comparison purposes
-						//if (mr == CMH1){cout<<1<<" "<<1<<endl;}
-						for (int i = 1; i < pers; i++) {
-							if (per_pos[i] > 0.85 * (sd.width_total - 1)) {
- 								break;
- 							}
-
-							int percentage = per_pos[i] * 100 / (sd.width_total - 1); // Find the place on the curve of the current period
-							double ratio = periods[i] / periods[0]; // The ratio between the current period and the first period
-							//if (mr==CMH1){cout<<ratio<<" "<<curve[percentage] / curve[first_fit]<<endl;}
-							if (!( (0.9 * curve[percentage] / curve[first_fit]) < ratio && ratio < (1.1 * curve[percentage] / curve[first_fit]))) {   //JY WT.2. checking every period for every cell
-								passed = false;
-								break;
+						//// Giudicelli test 20160519: This can be separated into a function
+						bool passed = true;
+						// Try to fit out period data to the curve provided by Giudicelli et al.
+						if (pers < 3) { // If we don't have at least 3 periods then the oscillations were not good enough
+							passed = false;
+						} else {
+							int first_fit = per_pos[0] * 100 / (sd.width_total - 1); // Find the place on the curve of the first period for comparison purposes
+							//if (mr == CMH1){cout<<1<<" "<<1<<endl;}
+							for (int i = 1; i < pers; i++) {
+								if (per_pos[i] > 0.85 * (sd.width_total - 1)) {
+	 								break;
+	 							}
+
+								int percentage = per_pos[i] * 100 / (sd.width_total - 1); // Find the place on the curve of the current period
+								double ratio = periods[i] / periods[0]; // The ratio between the current period and the first period
+								//if (mr==CMH1){cout<<ratio<<" "<<curve[percentage] / curve[first_fit]<<endl;}
+								if (!( (0.9 * curve[percentage] / curve[first_fit]) < ratio && ratio < (1.1 * curve[percentage] / curve[first_fit]))) {   //JY WT.2. checking every period for every cell
+									passed = false;
+									break;
+								}
 							}
 						}
-					}
 					
-					if (passed && mr == CMH1) {
-						num_cells_passed++;
-					}
+						if (passed && mr == CMH1) {
+							num_cells_passed++;
+						}
 					
-					// the amplitude is the average of the amplitudes of all oscillations
-					// 20160519: should really be updated inthe loop above to avoid inefficiency
-					double amp_cell = 0;	// sum of all amplitudes of the cell 
-					for (int i = 0; i < amps; i++) {
-						amp_cell += amplitudes[i];
-					}
-					//double period_cell = 0;
-					//int rang = (int)(0.85 * pers);
-					//int count = 0;
-					/*for (; rang < pers; rang++) {
-						period_cell += periods[rang];
-						count++;
-					}*/
+						// the amplitude is the average of the amplitudes of all oscillations
+						// 20160519: should really be updated inthe loop above to avoid inefficiency
+						double amp_cell = 0;	// sum of all amplitudes of the cell 
+						for (int i = 0; i < amps; i++) {
+							amp_cell += amplitudes[i];
+						}
+						//double period_cell = 0;
+						//int rang = (int)(0.85 * pers);
+						//int count = 0;
+						/*for (; rang < pers; rang++) {
+							period_cell += periods[rang];
+							count++;
+						}*/
 					
-					if (amps == 0){
-						amp_avg+=0;
-					} else {
-						amp_avg += amp_cell / (amps);
-					}
+						if (amps == 0){
+							amp_avg+=0;
+						} else {
+							amp_avg += amp_cell / (amps);
+						}
 					
-					// period of this cell is considered the first period through out the cell's life time
-					period_avg += (periods[0]);
-				} else {
-					amp_avg += 1;
-					period_avg += 1;
-				}
-                // Printing to files for the anterior features
-                // 20160519: wayy to many loops, and can absolutely be combined into fewer loops, or be combined with the above lops (when we constructs the arrays)
-                // for the sake of efficiency
-				if (ip.ant_features) {
-					for (int j = 0; j < pers; j++) {
-						features_files[PERIOD] << per_pos[j] << ",";
-					}
-					features_files[PERIOD] << endl;
-					for (int j = 0; j < pers; j++) {
-						features_files[PERIOD] << periods[j] << ",";
-					}
-					features_files[PERIOD] << endl;
-					for (int j = 0; j < amps; j++) {
-						features_files[AMPLITUDE] << amp_pos[j] << ",";
+						// period of this cell is considered the first period through out the cell's life time
+						period_avg += (periods[0]);
+					} else {
+						amp_avg += 1;
+						period_avg += 1;
 					}
-					features_files[AMPLITUDE] << endl;
-					for (int j = 0; j < amps; j++) {
-						features_files[AMPLITUDE] << amplitudes[j] << ",";
+	                // Printing to files for the anterior features
+	                // 20160519: wayy to many loops, and can absolutely be combined into fewer loops, or be combined with the above lops (when we constructs the arrays)
+	                // for the sake of efficiency
+					if (ip.ant_features) {
+						for (int j = 0; j < pers; j++) {
+							features_files[PERIOD] << per_pos[j] << ",";
+						}
+						features_files[PERIOD] << endl;
+						for (int j = 0; j < pers; j++) {
+							features_files[PERIOD] << periods[j] << ",";
+						}
+						features_files[PERIOD] << endl;
+						for (int j = 0; j < amps; j++) {
+							features_files[AMPLITUDE] << amp_pos[j] << ",";
+						}
+						features_files[AMPLITUDE] << endl;
+						for (int j = 0; j < amps; j++) {
+							features_files[AMPLITUDE] << amplitudes[j] << ",";
+						}
+						features_files[AMPLITUDE] << endl;
 					}
-					features_files[AMPLITUDE] << endl;
-				}
 
-                // Updating mutant data
-                // 20160519: Right now this get overwritten eachtime we enter a new cell--> eliminate this part os that it is faster? 
-                for (int j = 0; j < pers; j++) {                                                    // 151221: may be unused
-					if (per_time[j] >= anterior_time(sd, md.induction)) {
-						///20160519: check if the half_hour_index is calculated right, what is the 3000 doing here?
-                    	double half_hour_index = 0.5 * (((int)(per_time[j] - anterior_time(sd, md.induction)) * sd.big_gran / 3000) + 1);
-                   		if (per_pos[j] < sd.width_initial) {
-                   		    md.feat.period_post_time[index][half_hour_index] = periods[j];   //JY WT.2.
-                    	} else {
-                    	    md.feat.period_ant_time[index][half_hour_index] = periods[j];    
-                    	}
-					}
-                }
-               /* for (int j = 0; j < amps; j++) {
-					if (amp_time[j] >= anterior_time(sd, md.induction)) {
-                    	double half_hour_index = 0.5 * ((int)((amp_time[j] - anterior_time(sd, md.induction)) * sd.big_gran / 3000) + 1);
-                    	if (per_pos[j] < sd.width_initial) {
-                    	    md.feat.amplitude_post_time[index][half_hour_index] = amplitudes[j];
-                    	} else {
-                    	    md.feat.amplitude_ant_time[index][half_hour_index] = amplitudes[j];
-                    	}
-					}
-                }*/
+	                // Updating mutant data
+	                // 20160519: Right now this get overwritten eachtime we enter a new cell--> eliminate this part os that it is faster? 
+	                for (int j = 0; j < pers && need_period_time; j++) {                                // 151221: may be unused
+						if (per_time[j] >= anterior_time(sd, md.induction)) {
+							///20160519: check if the half_hour_index is calculated right, what is the 3000 doing here?
+	                    	double half_hour_index = 0.5 * (((int)(per_time[j] - anterior_time(sd, md.induction)) * sd.big_gran / 3000) + 1);
+	                   		if (per_pos[j] < sd.width_initial) {
+	                   		    md.feat.period_post_time[index][half_hour_index] = periods[j];   //JY WT.2.
+	                    	} else {
+	                    	    md.feat.period_ant_time[index][half_hour_index] = periods[j];    
+	                    	}
+						}
+	                }
+	               /* for (int j = 0; j < amps; j++) {
+						if (amp_time[j] >= anterior_time(sd, md.induction)) {
+	                    	double half_hour_index = 0.5 * ((int)((amp_time[j] - anterior_time(sd, md.induction)) * sd.big_gran / 3000) + 1);
+	                    	if (per_pos[j] < sd.width_initial) {
+	                    	    md.feat.amplitude_post_time[index][half_hour_index] = amplitudes[j];
+	                    	} else {
+	                    	    md.feat.amplitude_ant_time[index][half_hour_index] = amplitudes[j];
+	                    	}
+						}
+	                }*/
 
-				type.reset(sd.steps_total / (20/sd.step_size));
-				crit_points.reset(sd.steps_total / (20/sd.step_size));
-			}//end of for loop for all cells in a line (a column of cells)		
-			time_start += sd.steps_split / sd.big_gran; // skip in time until a new column of cells has been formed
-		}// end of for loop for all the cells in the anterior part. 
+					type.reset(sd.steps_total / (20/sd.step_size));
+					crit_points.reset(sd.steps_total / (20/sd.step_size));
+				}//end of for loop for all cells in a line (a column of cells)		
+				time_start += sd.steps_split / sd.big_gran; // skip in time until a new column of cells has been formed
+			}// end of for loop for all the cells in the anterior part. 
 		
-		//close files if previously opened for data(periods, amplitudes) record
-		if (ip.ant_features) {
-			features_files[PERIOD].close();
-			features_files[AMPLITUDE].close();
-		}
+			//close files if previously opened for data(periods, amplitudes) record
+			if (ip.ant_features) {
+				features_files[PERIOD].close();
+				features_files[AMPLITUDE].close();
+			}
 		
 		
-		/* Previously, amp_avg and perido_avg is the sum of all average amplitudes and average periods of each cells
-		 * Now amp_avg and period_avg is the average of average amplitudes and periods of all cells
-		 */ 
-		amp_avg /= (end_line - start_line) * (end_col - start_col);
-		period_avg /= (end_line - start_line) * (end_col - start_col);
+			/* Previously, amp_avg and perido_avg is the sum of all average amplitudes and average periods of each cells
+			 * Now amp_avg and period_avg is the average of average amplitudes and periods of all cells
+			 */ 
+			amp_avg /= (end_line - start_line) * (end_col - start_col);
+			period_avg /= (end_line - start_line) * (end_col - start_col);
 		
-		/* 20160519: This is also updating md.feat.period_post[index]=period_avg, which should be updated in the osc_features_pos function
-		 * updating the period_avg and amplitude_avg into feat of the mutant data for the specific gene we are looking at
-		 */
-		//20160519: Ha commented this: md.feat.period_post[index]=period_avg;
-        md.feat.period_ant[index] = period_avg;
-		md.feat.amplitude_ant[index] = amp_avg; 
+			/* 20160519: This is also updating md.feat.period_post[index]=period_avg, which should be updated in the osc_features_pos function
+			 * updating the period_avg and amplitude_avg into feat of the mutant data for the specific gene we are looking at
+			 */
+			//20160519: Ha commented this: md.feat.period_post[index]=period_avg;
+	        md.feat.period_ant[index] = period_avg;
+			md.feat.amplitude_ant[index] = amp_avg; 
+		}
 		
 		
 		if (md.index == MUTANT_WILDTYPE) {                              //151221: calculate oscillation features for wildtype, including posterior amplitude, anterior amplitude and syncrony score for different species
@@ -452,20 +498,20 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 			int time_half = anterior_time(sd,(600+30)/sd.step_size);         //half hours after induction, 10 snapshot in 30 minutes
 			int time_half_end = anterior_time(sd,(600+60)/sd.step_size);
 			for (;time_half<time_half_end; time_half+=(3/sd.step_size)){
-				md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
-				md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
-				md.feat.amplitude_post[index] +=  avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
+				if (md.demand.needs(FD_AMPLITUDE_POST_TIME, index, 0.5)) md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
+				if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 0.5)) md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
+				if (md.demand.needs(FD_AMPLITUDE_POST, index)) md.feat.amplitude_post[index] +=  avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
 				//md.feat.sync_score_post[index]+=post_sync(sd,cl, index + 1, time_half);
-				md.feat.sync_score_ant[index]+= ant_sync(sd, cl, index + 1, time_half);
+				if (md.demand.needs(FD_SYNC_ANT, index)) md.feat.sync_score_ant[index]+= ant_sync(sd, cl, index + 1, time_half);
 			}
 			
 			//md.feat.sync_score_post[index]/=10;
-			md.feat.sync_score_ant[index]/=10;
+			if (md.demand.needs(FD_SYNC_ANT, index)) md.feat.sync_score_ant[index]/=10;
 			if (index == 0) {	// IMH1
 				int time_three = anterior_time(sd, (600+180)/sd.step_size);          //three hours after induction, 10 snapshot in 30 minutes
 				int time_three_end = anterior_time(sd, (600+210)/sd.step_size);
 				for (;time_three<time_three_end; time_three+=(3/sd.step_size)){
-					md.feat.amplitude_post_time[index][3]+= avg_amp(sd,cl,index+1,time_three, 0, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_POST_TIME, index, 3)) md.feat.amplitude_post_time[index][3]+= avg_amp(sd,cl,index+1,time_three, 0, sd.width_total);
 					//md.feat.amplitude_ant_time[index][3]+=avg_amp(sd,cl,index+1,time_three, 0.6*sd.width_total, sd.width_total);
 				}
 
@@ -476,14 +522,14 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_one_end = anterior_time(sd, (600+90)/sd.step_size);
 				for (;time_one<time_one_end; time_one+=(3/sd.step_size)){
 					
-					md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 1)) md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
 				}
 
 				int time_two = anterior_time(sd, (600+120)/sd.step_size);            //two hours after induction, 10 snapshot in 30 minutes
 				int time_two_end = anterior_time(sd, (600+150)/sd.step_size);            
 				for (;time_two<time_two_end; time_two+=(3/sd.step_size)){
 					
-					md.feat.amplitude_ant_time[index][2]+= avg_amp(sd,cl,index+1,time_two, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 2)) md.feat.amplitude_ant_time[index][2]+= avg_amp(sd,cl,index+1,time_two, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 
@@ -498,16 +544,16 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_half = anterior_time(sd,(600+30)/sd.step_size);         //half hours after induction, 10 snapshot in 30 minutes
 				int time_half_end = anterior_time(sd,(600+60)/sd.step_size);
 				for (;time_half<time_half_end; time_half+=(3/sd.step_size)){
-					md.feat.sync_score_ant[0]+=ant_sync(sd, cl, 0 + 1, time_half);
-					md.feat.sync_score_ant[3]+=ant_sync(sd, cl, 3 + 1, time_half);
+					if (md.demand.needs(FD_SYNC_ANT, IMH1)) md.feat.sync_score_ant[0]+=ant_sync(sd, cl, 0 + 1, time_half);
+					if (md.demand.needs(FD_SYNC_ANT, IMMESPB)) md.feat.sync_score_ant[3]+=ant_sync(sd, cl, 3 + 1, time_half);
 					//md.feat.sync_score_post[0]+=post_sync(sd,cl, 0 + 1, time_half);
-					md.feat.amplitude_post[0] +=  avg_amp(sd,cl,0+1,time_half, 0, sd.width_initial);
-					md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_POST, IMH1)) md.feat.amplitude_post[0] +=  avg_amp(sd,cl,0+1,time_half, 0, sd.width_initial);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 0.5)) md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
 				}
 				
 				
-				md.feat.sync_score_ant[0]/=10;
-				md.feat.sync_score_ant[3]/=10;
+				if (md.demand.needs(FD_SYNC_ANT, IMH1)) md.feat.sync_score_ant[0]/=10;
+				if (md.demand.needs(FD_SYNC_ANT, IMMESPB)) md.feat.sync_score_ant[3]/=10;
 				//md.feat.sync_score_post[0]/=10;
 			}
 
@@ -520,7 +566,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_half = anterior_time(sd,(600+30)/sd.step_size);                    //half hours after induction, 10 snapshot in 30 minutes
 				int time_half_end = anterior_time(sd,(600+60)/sd.step_size);
 				for (;time_half<time_half_end; time_half+=(3/sd.step_size)){
-					md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
+					if (md.demand.needs(FD_AMPLITUDE_POST_TIME, index, 0.5)) md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
 					
 				}
 			}
@@ -530,7 +576,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_half_end = anterior_time(sd,(600+60)/sd.step_size);
 				for (;time_half<time_half_end; time_half+=(3/sd.step_size)){
 					//cout<<md.feat.amplitude_ant_time[0][0.5]<<endl;
-					md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 0.5)) md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 
@@ -538,10 +584,10 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_onehalf = anterior_time(sd,(600+90)/sd.step_size);                 //one and a half hours after induction, 10 snapshot in 30 minutes
 				int time_onehalf_end = anterior_time(sd,(600+120)/sd.step_size);
 				for (;time_onehalf<time_onehalf_end; time_onehalf+=(3/sd.step_size)){
-					md.feat.sync_time[index][1.5]+=ant_sync(sd, cl, index + 1, time_onehalf);
+					if (md.demand.needs(FD_SYNC_TIME, index, 1.5)) md.feat.sync_time[index][1.5]+=ant_sync(sd, cl, index + 1, time_onehalf);
 					
 				}
-				md.feat.sync_time[index][1.5]/=10;
+				if (md.demand.needs(FD_SYNC_TIME, index, 1.5)) md.feat.sync_time[index][1.5]/=10;
 			}
 		}
 
@@ -550,8 +596,8 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_half = anterior_time(sd,(600+30)/sd.step_size);           //half hours after induction, 10 snapshot in 30 minutes
 				int time_half_end = anterior_time(sd,(600+60)/sd.step_size);
 				for (;time_half<time_half_end; time_half+=(3/sd.step_size)){
-					md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
-					md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_POST_TIME, index, 0.5)) md.feat.amplitude_post_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0, sd.width_initial);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 0.5)) md.feat.amplitude_ant_time[index][0.5]+=avg_amp(sd,cl,index+1,time_half, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 		}
@@ -561,13 +607,13 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_three = anterior_time(sd, (600+180)/sd.step_size);          //three hours after induction, 10 snapshot in 30 minutes
 				int time_three_end = anterior_time(sd, (600+210)/sd.step_size);
 				for (;time_three<time_three_end; time_three+=(3/sd.step_size)){
-					md.feat.amplitude_post_time[index][3]+=avg_amp(sd,cl,index+1,time_three, 0, sd.width_total);
-					md.feat.sync_time[index][3]+=ant_sync(sd, cl, index + 1, time_three);
+					if (md.demand.needs(FD_AMPLITUDE_POST_TIME, index, 3)) md.feat.amplitude_post_time[index][3]+=avg_amp(sd,cl,index+1,time_three, 0, sd.width_total);
+					if (md.demand.needs(FD_SYNC_TIME, index, 3)) md.feat.sync_time[index][3]+=ant_sync(sd, cl, index + 1, time_three);
 					//md.feat.amplitude_ant_time[index][3]+=avg_amp(sd,cl,index+1,time_three, 0.6*sd.width_total, sd.width_total);
 				}
 
 				
-				md.feat.sync_time[index][3]/=10;
+				if (md.demand.needs(FD_SYNC_TIME, index, 3)) md.feat.sync_time[index][3]/=10;
 			}
 
 			if (index==2) {
@@ -575,7 +621,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_two_end = anterior_time(sd, (600+150)/sd.step_size);
 				for (;time_two<time_two_end; time_two+=(3/sd.step_size)){
 					
-					md.feat.amplitude_ant_time[index][2]+=avg_amp(sd,cl,index+1,time_two, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 2)) md.feat.amplitude_ant_time[index][2]+=avg_amp(sd,cl,index+1,time_two, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 
@@ -583,9 +629,9 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_three = anterior_time(sd, (600+180)/sd.step_size);        //three hours after induction, 10 snapshot in 30 minutes
 				int time_three_end = anterior_time(sd, (600+210)/sd.step_size);
 				for (;time_three<time_three_end; time_three+=(3/sd.step_size)){
-					md.feat.sync_time[index][3]+=ant_sync(sd, cl, index + 1, time_three);
+					if (md.demand.needs(FD_SYNC_TIME, index, 3)) md.feat.sync_time[index][3]+=ant_sync(sd, cl, index + 1, time_three);
 				}
-				md.feat.sync_time[index][3]/=10;
+				if (md.demand.needs(FD_SYNC_TIME, index, 3)) md.feat.sync_time[index][3]/=10;
 			}
 		}
 
@@ -595,7 +641,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_one_end = anterior_time(sd, (600+90)/sd.step_size);
 				for (;time_one<time_one_end; time_one+=(3/sd.step_size)){
 					
-					md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 1)) md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 		}
@@ -606,7 +652,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 				int time_one_end = anterior_time(sd, (600+90)/sd.step_size);
 				for (;time_one<time_one_end; time_one+=(3/sd.step_size)){
 					
-					md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
+					if (md.demand.needs(FD_AMPLITUDE_ANT_TIME, index, 1)) md.feat.amplitude_ant_time[index][1]+=avg_amp(sd,cl,index+1,time_one, 0.6*sd.width_total, sd.width_total);
 				}
 			}
 		}
@@ -643,7 +689,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 			}
 			features_files[SYNC].close();
 		}
-		if (index == IMMESPA) { //151221: complementary score for mespa and mespb
+		if (index == IMMESPA && need_comp) { //151221: complementary score for mespa and mespb
 			// for complementary mesp expression take 6 snapshots and average comp score
 			//double num = 0;
 			
@@ -682,6 +728,7 @@ void osc_features_ant (sim_data& sd, input_params& ip, features& wtfeat, char* f
 */
 
 void osc_features_post (sim_data& sd, input_params& ip, con_levels& cl, features& feat, features& wtfeat, char* filename_feats, int start, int end, int set_num) {   //151221:  we are only using the this for the peaktotrough condition in wildtype mutant. maybe you can delete some unnecessary lines
+	phase_timer timer(sd, PHASE_FEATURES_POST);
 	
 
 	int strlen_set_num = INT_STRLEN(set_num); // How many bytes the ASCII representation of set_num takes
@@ -720,7 +767,7 @@ void osc_features_post (sim_data& sd, input_params& ip, con_levels& cl, features
 		double peaktotrough_end = 0;
 		double peaktotrough_mid = 0; 
 		double num_good_somites = 0;
-		double** conc = cl.cons[mr];//get the concentration table (in terms of time step and cell) of the concentration level we are trying to look at.
+		con_slice conc = cl.cons[mr];//get the concentration table (in terms of time step and cell) of the concentration level we are trying to look at.
 
 		//looping through all of the cells
 		for (int x = 0; x < sd.height; x++) {
@@ -840,6 +887,58 @@ void osc_features_post (sim_data& sd, input_params& ip, con_levels& cl, features
 	mfree(str_set_num);
 }
 
+/* osc_features_stream calculates the posterior oscillation features osc_features_post does from the peaks and troughs the given simulation's feature stream found
+	parameters:
+		sd: the current simulation's data, whose stream has followed the simulation
+		feat: the oscillation features of the mutant simulated
+	returns: nothing
+	notes:
+		This finishes the stream first. The features are summed over the cells in the same order osc_features_post sums them so they come out identical.
+		The period is not calculated since osc_features_post does not store it.
+	todo:
+*/
+void osc_features_stream (sim_data& sd, features& feat) {
+	phase_timer timer(sd, PHASE_FEATURES_STREAM);
+	static const int ind[NUM_STREAM_CONS] = {IMH1, IMH7, IMDELTA}; // In the order of feature_stream's concentration levels
+	feature_stream& fs = sd.stream;
+	fs.finish();
+	
+	for (int i = 0; i < NUM_STREAM_CONS; i++) {
+		double amplitude = 0;
+		double peaktotrough_end = 0;
+		double peaktotrough_mid = 0;
+		double num_good_somites = 0;
+		for (int x = 0; x < sd.height; x++) {
+			for (int y = 0; y < sd.width_current; y++) {
+				int cell = x * sd.width_total + y;
+				int num_peaks = fs.num_peaks[i * fs.cells + cell];
+				if (num_peaks >= 3) {
+					double peak_penult = fs.peak(i, cell, num_peaks - 2);
+					double trough_ult = fs.trough(i, cell, num_peaks - 2);
+					double trough_penult = fs.trough(i, cell, num_peaks - 3);
+					double peak_mid = fs.peak(i, cell, num_peaks / 2);
+					double trough_mid = fs.trough(i, cell, num_peaks / 2);
+					
+					amplitude += (peak_penult - (trough_penult + trough_ult) / 2);
+					peaktotrough_end += trough_ult > 1 ? peak_penult / trough_ult : peak_penult;
+					peaktotrough_mid += trough_mid > 1 ? peak_mid / trough_mid : peak_mid;
+				} else {
+					amplitude ++;
+					peaktotrough_end ++;
+					peaktotrough_mid ++;
+				}
+				num_good_somites += fs.num_troughs[i * fs.cells + cell] - 1;
+			}
+		}
+		
+		int cells = sd.height * sd.width_current;
+		feat.amplitude_post[ind[i]] = amplitude / cells;
+		feat.peaktotrough_end[ind[i]] = peaktotrough_end / cells;
+		feat.peaktotrough_mid[ind[i]] = peaktotrough_mid / cells;
+		feat.num_good_somites[ind[i]] = num_good_somites / cells;
+	}
+}
+
 double avg_amp (sim_data& sd, con_levels& cl, int con, int time, int start , int end){              //151221: calculate the average concentration value, and use it as amplitude
 	int pos_start = cl.active_start_record[time];
 	int pos_cur = 0;
@@ -916,7 +1015,7 @@ void plot_ant_sync (sim_data& sd, con_levels& cl, int time_start, ofstream* file
 	
 	first_row[0] = cl.cons[CMH1][time_start][col];	
 	int time = time_start + 1;
-	for (; cl.cons[BIRTH][time][col] == cl.cons[BIRTH][time - 1][col]; time++) {
+	for (; same_cell(sd, col, time, time - 1); time++) {
 		first_row[time - time_start] = cl.cons[CMH1][time][col];
 	}
 	int time_end = time;
@@ -931,7 +1030,7 @@ void plot_ant_sync (sim_data& sd, con_levels& cl, int time_start, ofstream* file
 	memset(sync_avg, 0, sizeof(double) * num_points);
 	for (int x = 1; x < sd.height; x++) {
 		int cell = x * sd.width_total + col;
-		for (int time = time_start + 1; cl.cons[BIRTH][time][cell] == cl.cons[BIRTH][time - 1][cell]; time++) {
+		for (int time = time_start + 1; same_cell(sd, cell, time, time - 1); time++) {
 			other_row[time - time_start] = cl.cons[CMH1][time][cell];
 		}
 		
@@ -26,9 +26,11 @@ feats.hpp contains function declarations for feats.cpp.
 #include "structs.hpp"
 #include "tests.hpp"
 
+bool same_cell(sim_data&, int, int, int);
 int get_peaks_and_troughs1(sim_data&, con_levels&, int, int, growin_array&, growin_array&, growin_array&, int);
 int get_peaks_and_troughs2(sim_data&, con_levels&, int, int, growin_array&, growin_array&, growin_array&, int, double*, double*, double*);
 void osc_features_post(sim_data&, input_params&, con_levels&, features&, features&, char*, int, int, int);
+void osc_features_stream(sim_data&, features&);
 double test_mesp_complementary(sim_data&, con_levels&, int);
 double test_compl(sim_data& sd, double* con1, double* con2, int num_cell);
 void osc_features_ant(sim_data&, input_params&, features&, char*, con_levels&, mutant_data&, int, int, int, int, int);
@@ -32,6 +32,7 @@ Avoid adding biological functions in this file and add them to sim.cpp instead.
 using namespace std;
 
 terminal* term = NULL; // The global terminal struct
+extern bool embedded; // Declared in main.cpp
 
 /* copy_str copies the given string, allocating enough memory for the new string
 	parameters:
@@ -47,24 +48,26 @@ char* copy_str (const char* str) {
 
 /* random_int generates a random integer in the range specififed by the given pair of integers
 	parameters:
+		rng: the random number generator to draw from
 		range: a pair of integers that specifies the lower and upper bounds in that order
 	returns: the random integer
 	notes:
 	todo:
 */
-int random_int (pair<int, int> range) {
-	return range.first + (rand() % (range.second - range.first + 1));
+int random_int (rng_state& rng, pair<int, int> range) {
+	return range.first + (int)(rng.next() % (uint32_t)(range.second - range.first + 1));
 }
 
 /* random_double generates a random double in the range specified by the given pair of doubles
 	parameters:
+		rng: the random number generator to draw from
 		range: a pair of doubles that specifies the lower and upper bounds in that order
 	returns: the random double
 	notes:
 	todo:
 */
-double random_double (pair<double, double> range) {
-	return range.first + (range.second - range.first) * rand() / (RAND_MAX + 1.0);
+double random_double (rng_state& rng, pair<double, double> range) {
+	return range.first + (range.second - range.first) * (rng.next() / 4294967296.0); // Divide by 2^32 to get a number in [0, 1)
 }
 
 /* interpolate linearly interpolates the value at the given location between two given points
@@ -164,6 +167,15 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 			} else if (option_set(option, "-B", "--binary-cons-output")) {
 				ip.binary_cons_output = true;
 				i--;
+			} else if (option_set(option, "-J", "--chunked-cons")) {
+				ensure_nonempty(option, value);
+				ip.chunk_steps = atoi(value);
+			} else if (option_set(option, "-z", "--compress-cons")) {
+				ip.compress_cons = true;
+				i--;
+			} else if (option_set(option, "-n", "--cons-levels")) {
+				ensure_nonempty(option, value);
+				store_cons_levels(ip, value);
 			} else if (option_set(option, "-f", "--print-osc-features")) {
 				ensure_nonempty(option, value);
 				store_filename(&(ip.features_file), value);
@@ -191,6 +203,14 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 				ensure_nonempty(option, value);
 				store_filename(&(ip.scores_file), value);
 				ip.print_scores = true;
+			} else if (option_set(option, "-pf", "--print-profile")) {
+				ensure_nonempty(option, value);
+				store_filename(&(ip.profile_file), value);
+				ip.print_profile = true;
+			} else if (option_set(option, "-tf", "--print-trace")) {
+				ensure_nonempty(option, value);
+				store_filename(&(ip.trace_file), value);
+				ip.print_trace = true;
 			} else if (option_set(option, "-L", "--print-cells")) {
 				ensure_nonempty(option, value);
 				ip.num_colls_print = atoi(value);
@@ -288,6 +308,12 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 			} else if (option_set(option, "-C", "--short-circuit")) {
 				ip.short_circuit = true;
 				i--;
+			} else if (option_set(option, "-F", "--predict-fail")) {
+				ensure_nonempty(option, value);
+				ip.predict_fail = atoi(value);
+				if (ip.predict_fail < 0) {
+					usage("The number of periods without clear oscillations to predict failure after must be a nonnegative integer. Set -F or --predict-fail to at least 0.");
+				}
 			} else if (option_set(option, "-M", "--mutants")) {
 				ensure_nonempty(option, value);
 				ip.num_active_mutants = atoi(value);
@@ -297,6 +323,18 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 					sprintf(message, "The number of mutants to run must be a positive integer up to the number of coded-in mutants. Set -M or --mutants to be at least 1 and no more than %d.", NUM_MUTANTS);
 					usage(message);
 				}
+			} else if (option_set(option, "-j", "--threads")) {
+				ensure_nonempty(option, value);
+				ip.num_threads = atoi(value);
+				if (ip.num_threads < 1) {
+					usage("The number of threads to simulate with must be a positive integer. Set -j or --threads to at least 1.");
+				}
+			} else if (option_set(option, "-k", "--ensemble")) {
+				ensure_nonempty(option, value);
+				ip.num_lanes = atoi(value);
+				if (ip.num_lanes < 1) {
+					usage("The number of parameter sets to simulate at once must be a positive integer. Set -k or --ensemble to at least 1.");
+				}
 			} else if (option_set(option, "-I", "--pipe-in")) {
 				ensure_nonempty(option, value);
 				ip.piping = true;
@@ -311,6 +349,16 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 				if (ip.pipe_out <= 0) {
 					usage("The file descriptor to pipe data into must be a positive integer. Set -O or --pipe-out to be at least 1.");
 				}
+			} else if (option_set(option, "-H", "--shm-ring")) {
+				ensure_nonempty(option, value);
+				ip.piping = true;
+				store_filename(&(ip.shm_name), value);
+			} else if (option_set(option, "-N", "--daemon")) {
+				ip.daemon = true;
+				i--;
+			} else if (option_set(option, "-U", "--pipe-records")) {
+				ip.pipe_records = true;
+				i--;
 			} else if (option_set(option, "-c", "--no-color")) {
 				mfree(term->blue);
 				mfree(term->red);
@@ -328,8 +376,8 @@ void accept_input_params (int num_args, char** args, input_params& ip) {
 				if (!ip.quiet) {
 					ip.quiet = true;
 					ip.cout_orig = cout.rdbuf();
-					cout.rdbuf(ip.null_stream->rdbuf());
-					term->set_verbose_streambuf(ip.null_stream->rdbuf());
+					cout.rdbuf(ip.null_stream);
+					term->set_verbose_streambuf(ip.null_stream);
 				}
 				i--;
 			} else if (option_set(option, "-h", "--help")) {
@@ -378,6 +426,32 @@ void ensure_nonempty (const char* option, const char* arg) {
 	}
 }
 
+/* store_cons_levels stores the concentration levels to print in chunked concentrations files from the given comma-separated list
+	parameters:
+		ip: the program's input parameters
+		list: the comma-separated list of levels
+	returns: nothing
+	notes:
+		Only the list's syntax is checked here; check_input_params checks the levels themselves.
+	todo:
+*/
+void store_cons_levels (input_params& ip, char* list) {
+	ip.num_cons_levels = 0;
+	char* level = list;
+	while (true) {
+		char* end;
+		long value = strtol(level, &end, 10);
+		if (end == level || (*end != ',' && *end != '\0') || ip.num_cons_levels == CCONS_MAX_LEVELS) {
+			usage("The concentration levels to print must be a comma-separated list of at most six levels, e.g. 1,2,6. Fix -n or --cons-levels.");
+		}
+		ip.cons_levels[ip.num_cons_levels++] = value;
+		if (*end == '\0') {
+			break;
+		}
+		level = end + 1;
+	}
+}
+
 /* check_input_params checks that the given command-line arguments are semantically valid
 	parameters:
 		ip: the program's input parameters
@@ -402,10 +476,47 @@ void check_input_params (input_params& ip) {
 	if (ip.time_til_growth > ip.time_total) {
 		usage("The time until growth must be no more than the total simulation time. Set the time until growth (-G or --time-til-growth) to <= the total time (-m or --total-time).");
 	}
-	if (ip.piping && (ip.pipe_in == 0 || ip.pipe_out == 0)) {
+	if (ip.num_lanes > 1 && (int)(ip.time_total / ip.step_size) != (int)(ip.time_til_growth / ip.step_size) && ip.width_initial != ip.width_total) {
+		usage("Ensemble mode only supports posterior-only simulations. Set the time until growth (-G or --time-til-growth) to the total time (-m or --minutes) or set -k or --ensemble to 1.");
+	}
+	if (ip.predict_fail > 0 && (ip.print_cons || ip.post_features)) {
+		usage("Predicting failures watches the streamed posterior features, which printing concentrations or posterior features turns off. Set -F or --predict-fail to 0 or stop printing concentrations (-t or --print-cons) and posterior features (-P or --posterior-feats).");
+	}
+	if (ip.chunk_steps < 0) {
+		usage("The number of time steps in each chunk of the concentrations files must be positive. Set -J or --chunked-cons to at least 1.");
+	}
+	if (ip.chunk_steps > 0 && !ip.print_cons) {
+		usage("Chunked concentrations files are a format for printing concentrations. Print concentrations with -t or --print-cons or stop using -J or --chunked-cons.");
+	}
+	if (ip.chunk_steps > 0 && ip.binary_cons_output) {
+		usage("Concentrations can be printed as .bcons or chunked .ccons files, not both. Stop using either -B or --binary-cons-output or -J or --chunked-cons.");
+	}
+	if (ip.chunk_steps == 0 && (ip.compress_cons || ip.num_cons_levels > 0)) {
+		usage("Compressing and choosing concentration levels are only available for chunked concentrations files. Set -J or --chunked-cons or stop using -z or --compress-cons and -n or --cons-levels.");
+	}
+	for (int i = 0; i < ip.num_cons_levels; i++) {
+		if (ip.cons_levels[i] < MIN_CON_LEVEL || ip.cons_levels[i] >= NUM_CON_STORE) {
+			usage("Only mRNA levels are stored for printing. Set -n or --cons-levels to a comma-separated list of levels from 1 (mh1) to 6 (mdelta).");
+		}
+		for (int j = 0; j < i; j++) {
+			if (ip.cons_levels[i] == ip.cons_levels[j]) {
+				usage("Each concentration level can only be printed once. Remove the repeated levels from -n or --cons-levels.");
+			}
+		}
+	}
+	if (ip.shm_name != NULL && (ip.pipe_in != 0 || ip.pipe_out != 0)) {
+		usage("Data can be exchanged through pipes or a shared memory region, not both. Stop using either -H or --shm-ring or the pipes (-I or --pipe-in and -O or --pipe-out).");
+	}
+	if (ip.piping && ip.shm_name == NULL && (ip.pipe_in == 0 || ip.pipe_out == 0)) {
 		usage("If one end of a pipe is specified, the other must be as well. Set the file descriptors for both the pipe in (-I or --pipe-in) and the pipe out (-O or --pipe-out).");
 	}
-	if (!(ip.piping || ip.read_params || ip.read_ranges)) {
+	if (ip.pipe_records && !ip.piping) {
+		usage("Score records are piped to the sampler. Set the file descriptors for both the pipe in (-I or --pipe-in) and the pipe out (-O or --pipe-out), give a shared memory region with -H or --shm-ring, or stop using -U or --pipe-records.");
+	}
+	if (ip.daemon && !ip.piping) {
+		usage("Daemon mode serves batches of parameter sets over a pipe. Set the file descriptors for both the pipe in (-I or --pipe-in) and the pipe out (-O or --pipe-out), give a shared memory region with -H or --shm-ring, or stop using -N or --daemon.");
+	}
+	if (!(embedded || ip.piping || ip.read_params || ip.read_ranges)) { // A library's caller gives the sets directly
 		usage("Parameter must be piped in via -I or --pipe-in, read from a file via -i or --params-file, or generated from a ranges file and number of sets via -R or --ranges-file and -p or --parameter-sets, respectively.");
 	}
 	if (!ip.dir_path && (ip.print_cons || ip.ant_features || ip.post_features)) {
@@ -474,24 +585,19 @@ void init_seeds (input_params& ip, int set_num, bool append, bool indent_message
 	}
 }
 
-/* reset_sesed resets the simulation seed and fast-forwards it if necessary (to avoid running an anterior simulation with the same random numbers as the previously run posterior)
+/* reset_seed restarts the simulation's random number streams for the given set and the current section
 	parameters:
-		ip: the program's input parameters
 		sd: the current simulation's data
+		set_num: the index of the parameter set being simulated
 	returns: nothing
 	notes:
-		If the simulation is changed to generated a different number of random numbers in the posterior then this function must be updated to reflect that.
+		Every mutant of a set starts from the same streams so mutants are compared under the same cell perturbations.
+		The section is part of each stream's counter, so the anterior never reuses the posterior's numbers and no fast-forwarding is needed.
 	todo:
 */
-void reset_seed (input_params& ip, sim_data& sd) {
-	srand(ip.seed);
-	if (sd.section == SEC_ANT) { // If simulating the anterior, return to the last location in the random number generation to avoid duplicate numbers
-		for (int i = 0; i < NUM_RATES; i++) {
-			for (int k = 0; k < sd.cells_total; k++) {
-				rand();
-			}
-		}
-	}
+void reset_seed (sim_data& sd, int set_num) {
+	sd.rng_perturb.seed(sd.seed, set_num, sd.section, RNG_PERTURB);
+	sd.rng_split.seed(sd.seed, set_num, sd.section, RNG_SPLIT);
 }
 
 /* init_verbosity sets the verbose stream to /dev/null if verbose mode is not enabled
@@ -503,7 +609,7 @@ void reset_seed (input_params& ip, sim_data& sd) {
 */
 void init_verbosity (input_params& ip) {
 	if (!ip.verbose) {
-		term->set_verbose_streambuf(ip.null_stream->rdbuf());
+		term->set_verbose_streambuf(ip.null_stream);
 	}
 }
 
@@ -516,28 +622,27 @@ void init_verbosity (input_params& ip) {
 	returns: nothing
 	notes:
 		This function is responsible for filling in sets via whatever method the user specified so add any future input methods here.
-		
+		A parameter sets file is not read into sets but streamed a chunk at a time (see params_stream), so only its first chunk is parsed here. If the file ends within the first chunk, ip.num_sets becomes the number of sets in the file; otherwise it stays the most sets to read until the stream ends.
 	todo:
 */
 void read_sim_params (input_params& ip, input_data& params_data, double**& sets, input_data& ranges_data) {
 	cout << term->blue;
 	if (ip.piping) { // If the user specified piping
-		cout << "Reading pipe " << term->reset << "(file descriptor " << ip.pipe_in << ") . . . ";
+		if (ip.shm_name != NULL) {
+			cout << "Reading shared memory " << term->reset << "(" << ip.shm_name << ") . . . ";
+			open_shm(ip);
+		} else {
+			cout << "Reading pipe " << term->reset << "(file descriptor " << ip.pipe_in << ") . . . ";
+		}
 		read_pipe(sets, ip);
 		term->done();
 	} else if (ip.read_params) { // If the user specified a parameter sets input file
-		read_file(&params_data);
-		sets = new double*[ip.num_sets];
-		for (int i = 0; i < ip.num_sets; i++) {
-			if (params_data.index < params_data.size) { // Parse only as many lines as specified, even if the file is longer
-				sets[i] = new double[NUM_RATES];
-				memset(sets[i], 0, sizeof(double) * NUM_RATES);
-				if(!parse_param_line(sets[i], params_data.buffer, params_data.index)) { // Parse each line until the file is empty or the required number of sets have been found
-					ip.num_sets = i;
-				}
-			} else {
-				ip.num_sets = i;
-			}
+		open_stream(&params_data);
+		ip.pstream = new params_stream(&params_data);
+		read_params_header(*(ip.pstream));
+		int max_sets = MIN(PARAMS_CHUNK, ip.num_sets); // Parse only as many lines as specified, even if the file is longer
+		if (read_params_chunk(*(ip.pstream), max_sets) < max_sets) {
+			ip.num_sets = ip.pstream->num_sets;
 		}
 	} else if (ip.read_ranges) { // If the user specified a ranges input file to generate random numbers from
 		cout << "Generating " << term->reset << ip.num_sets << " random parameter sets according to the ranges in " << ranges_data.filename << " . . ." << endl;
@@ -545,12 +650,13 @@ void read_sim_params (input_params& ip, input_data& params_data, double**& sets,
 		read_file(&ranges_data);
 		sets = new double*[ip.num_sets];
 		pair <double, double> ranges[NUM_RATES];
-		parse_ranges_file(ranges, ranges_data.buffer);
-		srand(ip.pseed);
+		parse_ranges_file(ranges, ranges_data);
+		rng_state rng;
 		for (int i = 0; i < ip.num_sets; i++) {
+			rng.seed(ip.pseed, i, 0, RNG_PARAMS); // Each set has its own stream so it can be regenerated without generating the sets before it
 			sets[i] = new double[NUM_RATES];
 			for (int j = 0; j < NUM_RATES; j++) {
-				sets[i][j] = random_double(ranges[j]);
+				sets[i][j] = random_double(rng, ranges[j]);
 			}
 		}
 		term->done();
@@ -590,41 +696,56 @@ void read_gradients_params (input_params& ip, input_data& gradients_data) {
 /* fill_perturbations fills the factors_perturb array in the given rates struct based on the given perturbations input buffer
 	parameters:
 		rs: the current simulation's rates to fill
-		perturbs: the perturbations buffer taken from the input file
+		perturb_data: the input_data for the perturbations input file (its buffer is NULL if no file was given)
 	returns: nothing
 	notes:
 		The buffer should contain one perturbation factor per line in the format 'factor start end' where 'start' is the index of the concentration to start applying the perturbation and 'end' is the index of the concentration after which to stop applying the perturbation. A perturbation with a maximum absolute percentage of 'factor' is applied to every concentration from 'start' to 'end'.
+		Blank lines and lines starting with # will be ignored, as will anything after a # following a perturbation.
 	todo:
-		TODO allow comments in files
 */
-void fill_perturbations (rates& rs, char* perturbs) {
-	if (perturbs != NULL) {
-		static const char* usage_message = "There was an error reading the given perturbations file.";
-		int index = 0;
-		while (perturbs[index] != '\0') {
+void fill_perturbations (rates& rs, input_data& perturb_data) {
+	if (perturb_data.buffer != NULL) {
+		char* buffer = perturb_data.buffer;
+		int& i = perturb_data.index;
+		while (i < perturb_data.size) {
+			skip_blanks(buffer, i);
+			if (end_of_content(buffer[i])) { // Skip blank lines and comments
+				next_line(perturb_data);
+				continue;
+			}
+			
+			// Read the perturbations
 			double factor = 0; // The perturbation factor
 			int con_start = 0; // The starting concentration
 			int con_end = 0; // The ending concentration
+			if (!parse_double(buffer, i, factor)) {
+				parse_error(perturb_data, "Expected the perturbation factor.");
+			}
+			skip_blanks(buffer, i);
+			if (!parse_int(buffer, i, con_start)) {
+				parse_error(perturb_data, "Expected the index of the first rate to perturb.");
+			}
+			skip_blanks(buffer, i);
+			if (!parse_int(buffer, i, con_end)) {
+				parse_error(perturb_data, "Expected the index of the last rate to perturb.");
+			}
+			skip_blanks(buffer, i);
+			if (!end_of_content(buffer[i])) {
+				parse_error(perturb_data, "Expected the end of the line.");
+			}
+			if (factor < 0) {
+				usage("The given perturbations file includes at least one factor less than 0. Adjust the perturbations file given with -u or --perturb-file.");
+			}
+			if (con_start < 0 || con_start >= NUM_RATES || con_end < 0 || con_end >= NUM_RATES) {
+				usage("The given perturbations file includes rates outside of the valid range. Adjust the perturbations file given with -u or --perturb-file or add the appropriate rates by editing the macros file and recompiling.");
+			}
 			
-			// Read the perturbations
-			if (sscanf(perturbs + index, "%lf %d %d", &factor, &con_start, &con_end) == 3) {
-				if (factor < 0) {
-					usage("The given perturbations file includes at least one factor less than 0. Adjust the perturbations file given with -u or --perturb-file.");
-				}
-				if (con_start < 0 || con_start >= NUM_RATES || con_end < 0 || con_end >= NUM_RATES) {
-					usage("The given perturbations file includes rates outside of the valid range. Adjust the perturbations file given with -u or --perturb-file or add the appropriate rates by editing the macros file and recompiling.");
-				}
-				
-				// If the given factor and index range is valid then fill the current simulation's rates with the perturbations
-				factor /= 100;
-				for (int i = con_start; i <= con_end; i++) {
-					rs.factors_perturb[i] = factor;
-				}
-			} else {
-				cout << sscanf(perturbs + index, "%lf %d %d", &factor, &con_start, &con_end);
-				usage(usage_message);
+			// If the given factor and index range is valid then fill the current simulation's rates with the perturbations
+			factor /= 100;
+			for (int j = con_start; j <= con_end; j++) {
+				rs.factors_perturb[j] = factor;
 			}
-			while (not_EOL(perturbs[index++])) {} // Skip to the next line
+			next_line(perturb_data);
 		}
 	}
 }
@@ -632,40 +753,57 @@ void fill_perturbations (rates& rs, char* perturbs) {
 /* fill_gradients fills the factors_gradient array in the given rates struct based on the given gradients input buffer
 	parameters:
 		rs: the current simulation's rates to fill
-		gradients: the gradients buffer taken from the input file
+		gradients_data: the input_data for the gradients input file (its buffer is NULL if no file was given)
 	returns: nothing
 	notes:
 		The buffer should contain one gradient per line in format 'concentration (position factor) (position factor) ...' with at least one (position factor) pair where 'concentration' is the index of the concentration to which to apply the gradient, 'position' is a column in the cell tissue, and 'factor' is the percentage the concentration should reach at the associated position.
+		Each line's factors are interpolated from the first column, so gradients given on earlier lines never affect later ones.
+		Blank lines and lines starting with # will be ignored, as will anything after a # following a gradient.
 	todo:
-		TODO allow comments in files
 */
-void fill_gradients (rates& rs, char* gradients) {
-	if (gradients != NULL) {
-		static const char* usage_message = "There was an error reading the given gradients file.";
-		int con; // The index of the concentration 
-		int column; // The column in the cell tissue
-		double factor; // The factor to apply
-		int last_column = 0; // The last column in the cell tissue given a gradient factor
-		int start_column; // The first column to apply the gradient from
-		int i = 0; // The index in the buffer
-		while (gradients[i] != '\0') {
+void fill_gradients (rates& rs, input_data& gradients_data) {
+	if (gradients_data.buffer != NULL) {
+		char* buffer = gradients_data.buffer;
+		int& i = gradients_data.index;
+		while (i < gradients_data.size) {
+			skip_blanks(buffer, i);
+			if (end_of_content(buffer[i])) { // Skip blank lines and comments
+				next_line(gradients_data);
+				continue;
+			}
+			
 			// Read the concentration value
-			if (sscanf(gradients + i, "%d", &con) != 1) {
-				usage(usage_message);
+			int con; // The index of the concentration
+			if (!parse_int(buffer, i, con)) {
+				parse_error(gradients_data, "Expected the index of the rate to apply the gradient to.");
 			}
-			if (con < 0 || con > NUM_RATES) {
+			if (con < 0 || con >= NUM_RATES) {
 				usage("The given gradients file includes rate indices outside of the valid range. Please adjust the gradients file or add the appropriate rates by editing the macros file and recompiling.");
 			}
 			rs.using_gradients = true; // Mark that at least one concentration has a gradient
 			rs.has_gradient[con] = true; // Mark that this concentration has a gradient
 			
 			// Read every (position factor) pair
-			while (gradients[i++] != ' ') {} // Skip past the concentration index
-			while (not_EOL(gradients[i])) {
-				// Read a position factor pair
-				if (sscanf(gradients + i, "(%d %lf)", &column, &factor) != 2) {
-					usage(usage_message);
+			int column = 0; // The column in the cell tissue
+			int last_column = 0; // The last column in the cell tissue given a gradient factor
+			int num_pairs = 0; // The number of pairs read
+			skip_blanks(buffer, i);
+			while (buffer[i] == '(') {
+				i++;
+				skip_blanks(buffer, i);
+				if (!parse_int(buffer, i, column)) {
+					parse_error(gradients_data, "Expected the position of a (position factor) pair.");
 				}
+				skip_blanks(buffer, i);
+				double factor; // The factor to apply
+				if (!parse_double(buffer, i, factor)) {
+					parse_error(gradients_data, "Expected the factor of a (position factor) pair.");
+				}
+				skip_blanks(buffer, i);
+				if (buffer[i] != ')') {
+					parse_error(gradients_data, "Expected a closing parenthesis after the (position factor) pair.");
+				}
+				i++;
 				if (column < 0 || column >= rs.width) {
 					usage("The given gradients file includes positions outside of the given simulation width. Please adjust the gradients file or increase the width of the simulation using -x or --total-width.");
 				}
@@ -675,39 +813,41 @@ void fill_gradients (rates& rs, char* gradients) {
 				
 				// Apply the gradient factor
 				factor /= 100;
-				start_column = last_column;
+				int start_column = last_column; // The first column to apply the gradient from
 				last_column = column;
 				for (int j = start_column + 1; j < column; j++) {
 					rs.factors_gradient[con][j] = interpolate(j, start_column, column, rs.factors_gradient[con][start_column], factor);
 				}
 				rs.factors_gradient[con][column] = factor;
-				while (gradients[i++] != ')') {} // Skip past the end of the pair
-				while (gradients[i] == ' ') {i++;} // Skip any whitespace before the next pair
+				num_pairs++;
+				skip_blanks(buffer, i); // Skip any whitespace before the next pair
+			}
+			if (num_pairs == 0 || !end_of_content(buffer[i])) {
+				parse_error(gradients_data, "Expected a (position factor) pair.");
 			}
 			
 			// Apply the last gradient factor to the rest of the columns
 			for (int j = column + 1; j < rs.width; j++) {
 				rs.factors_gradient[con][j] = rs.factors_gradient[con][column];
 			}
-			i++;
+			next_line(gradients_data);
 		}
 	}
 }
 
-/* calc_max_delay_size calculates the maximum delay any given parameter set includes and returns that +1 to size con_levels structs
+/* calc_delay_size calculates the maximum delay the given parameter sets include and returns that +1 to size con_levels structs
 	parameters:
-		ip: the program's input parameters
 		sd: the current simulation's data
 		rs: the current simulation's rates take perturbation factors from
 		sets: the array of parameter sets to take delays from
-	returns: nothing
+		num_sets: the number of sets in the array
+	returns: the number of time steps the longest delay takes plus 1
 	notes:
-		This function calculates the maximum delay using every parameter set because this way con_levels structs that are sized based on the maximum delay do not have to be resized for every set.
 	todo:
 */
-void calc_max_delay_size (input_params& ip, sim_data& sd, rates& rs, double** sets) {
+int calc_delay_size (sim_data& sd, rates& rs, double** sets, int num_sets) {
 	double max = 0;
-	for (int i = 0; i < ip.num_sets; i++) {
+	for (int i = 0; i < num_sets; i++) {
 		for (int j = MIN_DELAY; j <= MAX_DELAY; j++) { 
 			for (int k = 0; k < sd.width_total; k++) {
 				// Calculate the minimum delay, accounting for the maximum allowable perturbation and gradients
@@ -715,11 +855,54 @@ void calc_max_delay_size (input_params& ip, sim_data& sd, rates& rs, double** se
 			}
 		}
 	}
-	sd.max_delay_size = MIN(max, sd.time_total) / sd.step_size + 1; // If the maximum delay is longer than the simulation time then set the maximum delay to the simulation time
+	return MIN(max, sd.time_total) / sd.step_size + 1; // If the maximum delay is longer than the simulation time then set the maximum delay to the simulation time
+}
+
+/* set_delay_size sets the given simulation's maximum delay size and the history sized by it
+	parameters:
+		sd: the current simulation's data
+		max_delay_size: the maximum delay size (see calc_delay_size)
+	returns: nothing
+	notes:
+		Everything sized by the history must be sized again after this is called (see fit_context).
+	todo:
+*/
+void set_delay_size (sim_data& sd, int max_delay_size) {
+	sd.max_delay_size = max_delay_size;
+	for (sd.history_size = 1; sd.history_size < sd.max_delay_size; sd.history_size *= 2); // Round the history up to a power of two
+	sd.history_mask = sd.history_size - 1;
 	if (sd.big_gran > sd.max_delay_size) { //warning if the big_gran is greater than the maximum delay time
 		cout << term->red << "The given big granularity cannot be larger than the maximum delay time (in time steps) of any given parameter set! Please reduce the big granularity with -b or --big-granularity. Remember that adding perturbations to a delay will likely increase its duration." << term->reset << endl;
-		exit(EXIT_INPUT_ERROR);
+		quit(EXIT_INPUT_ERROR);
+	}
+}
+
+/* calc_max_delay_size calculates the maximum delay any given parameter set includes and sets the simulation's sizes for it
+	parameters:
+		ip: the program's input parameters
+		sd: the current simulation's data
+		rs: the current simulation's rates take perturbation factors from
+		sets: the array of parameter sets to take delays from
+	returns: whether or not the sizes grew
+	notes:
+		This function calculates the maximum delay using every parameter set because this way con_levels structs that are sized based on the maximum delay do not have to be resized for every set.
+		A streamed parameter sets file is the exception: only its first chunk has been parsed, so the sizes fit that chunk and every later chunk is sized for as it is parsed (see take_set).
+		The sizes never shrink, so in daemon mode a batch with shorter delays than an earlier one keeps the structs already allocated. If they grow, everything sized by them must be resized (see resize_mutant_data and create_contexts).
+	todo:
+*/
+bool calc_max_delay_size (input_params& ip, sim_data& sd, rates& rs, double** sets) {
+	int max_delay_size;
+	if (ip.pstream != NULL) {
+		ip.pstream->delay_size = calc_delay_size(sd, rs, ip.pstream->sets, ip.pstream->num_sets);
+		max_delay_size = ip.pstream->delay_size;
+	} else {
+		max_delay_size = calc_delay_size(sd, rs, sets, ip.num_sets);
 	}
+	if (max_delay_size <= sd.max_delay_size) {
+		return false;
+	}
+	set_delay_size(sd, max_delay_size);
+	return true;
 }
 
 /* delete_file closes the given file and frees it from memory
@@ -917,7 +1100,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
 	for (int i = 0; i < sd.num_active_mutants; i++) {
 		mds[i].index = i;
 		//sd.active_start right now is initialized to be sd.width_initial - 1
-		mds[i].cl.initialize(NUM_CON_LEVELS, sd.max_delay_size, sd.cells_total, sd.active_start);
+		mds[i].cl.initialize(MIN_CON_LEVEL, NUM_CON_LEVELS, sd.history_size, sd.cells_total, sd.active_start);
 	}
 	
 	// Wild type
@@ -930,6 +1113,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_WILDTYPE].overexpression_factor = 0;
 	mds[MUTANT_WILDTYPE].tests[SEC_POST] = test_wildtype_post;
 	mds[MUTANT_WILDTYPE].tests[SEC_ANT] = test_wildtype_ant;
+	mds[MUTANT_WILDTYPE].ant_demand = demand_wildtype_ant;
 	mds[MUTANT_WILDTYPE].wave_test = test_wildtype_wave;
 	mds[MUTANT_WILDTYPE].num_conditions[SEC_POST] = 3;
 	mds[MUTANT_WILDTYPE].cond_scores[SEC_POST][0] = CW_A;
@@ -1008,6 +1192,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_DELTA].overexpression_factor = 0;
 	mds[MUTANT_DELTA].tests[SEC_POST] = test_delta_mutant_post;
 	mds[MUTANT_DELTA].tests[SEC_ANT] = test_delta_mutant_ant;
+	mds[MUTANT_DELTA].ant_demand = demand_delta_mutant_ant;
 	mds[MUTANT_DELTA].num_conditions[SEC_POST] = 3;
 	mds[MUTANT_DELTA].cond_scores[SEC_POST][0] = CW_B;
 	mds[MUTANT_DELTA].cond_scores[SEC_POST][1] = CW_A;
@@ -1121,6 +1306,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_HER7OVER].overexpression_factor = 2;
 	mds[MUTANT_HER7OVER].tests[SEC_POST] = test_her7over_mutant_post;
 	mds[MUTANT_HER7OVER].tests[SEC_ANT] = test_her7over_mutant_ant;
+	mds[MUTANT_HER7OVER].ant_demand = demand_her7over_mutant_ant;
 	mds[MUTANT_HER7OVER].num_conditions[SEC_POST] = 0;
 	mds[MUTANT_HER7OVER].num_conditions[SEC_ANT] = 8;
 	mds[MUTANT_HER7OVER].cond_scores[SEC_ANT][0] = CW_A;
@@ -1146,6 +1332,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_HER1OVER].overexpression_factor = 2;
 	mds[MUTANT_HER1OVER].tests[SEC_POST] = test_her1over_mutant_post;
 	mds[MUTANT_HER1OVER].tests[SEC_ANT] = test_her1over_mutant_ant;
+	mds[MUTANT_HER1OVER].ant_demand = demand_her1over_mutant_ant;
 	mds[MUTANT_HER1OVER].num_conditions[SEC_POST] = 1;
 	mds[MUTANT_HER1OVER].cond_scores[SEC_POST][0] = CW_B;
 	mds[MUTANT_HER1OVER].num_conditions[SEC_ANT] = 5;
@@ -1212,6 +1399,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_DAPT].overexpression_factor = 0;
 	mds[MUTANT_DAPT].tests[SEC_POST] = test_DAPT_mutant_post;
 	mds[MUTANT_DAPT].tests[SEC_ANT] = test_DAPT_mutant_ant;
+	mds[MUTANT_DAPT].ant_demand = demand_DAPT_mutant_ant;
 	mds[MUTANT_DAPT].num_conditions[SEC_POST] = 1;
 	mds[MUTANT_DAPT].cond_scores[SEC_POST][0] = CW_A;
 	mds[MUTANT_DAPT].num_conditions[SEC_ANT] = 6;
@@ -1238,6 +1426,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_MESPAOVER].overexpression_factor = 2;
 	mds[MUTANT_MESPAOVER].tests[SEC_POST] = test_MESPAOVER_mutant_post;
 	mds[MUTANT_MESPAOVER].tests[SEC_ANT] = test_MESPAOVER_mutant_ant;
+	mds[MUTANT_MESPAOVER].ant_demand = demand_MESPAOVER_mutant_ant;
 	mds[MUTANT_MESPAOVER].num_conditions[SEC_POST] = 0;
 	
 	mds[MUTANT_MESPAOVER].num_conditions[SEC_ANT] = 1;
@@ -1260,6 +1449,7 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
     mds[MUTANT_MESPBOVER].overexpression_factor = 2;
 	mds[MUTANT_MESPBOVER].tests[SEC_POST] = test_MESPBOVER_mutant_post;
 	mds[MUTANT_MESPBOVER].tests[SEC_ANT] = test_MESPBOVER_mutant_ant;
+	mds[MUTANT_MESPBOVER].ant_demand = demand_MESPBOVER_mutant_ant;
 	mds[MUTANT_MESPBOVER].num_conditions[SEC_POST] = 0;
 	
 	mds[MUTANT_MESPBOVER].num_conditions[SEC_ANT] = 2;
@@ -1273,6 +1463,45 @@ mutant_data* create_mutant_data (sim_data& sd, input_params& ip) {
 	
 }
 
+/* declare_feature_demands fills in which anterior oscillation features must be calculated for each mutant
+	parameters:
+		ip: the program's input parameters
+		sd: the current simulation's data
+		mds: the array of mutant data
+	returns: nothing
+	notes:
+		Every feature is needed when the anterior features are dumped to files or the features file is printed, as is every feature of a mutant without a demand function.
+		The wild type's demand gains the entries every other active mutant reads from its features.
+	todo:
+*/
+void declare_feature_demands (input_params& ip, sim_data& sd, mutant_data mds[]) {
+	for (int i = 0; i < sd.num_active_mutants; i++) {
+		mds[i].demand.clear();
+	}
+	for (int i = 0; i < sd.num_active_mutants; i++) {
+		if (ip.ant_features || ip.print_features || mds[i].ant_demand == NULL) {
+			mds[i].demand.need_all();
+		} else {
+			mds[i].ant_demand(mds[i].demand, mds[MUTANT_WILDTYPE].demand);
+		}
+	}
+}
+
+/* resize_mutant_data resizes every mutant's concentration levels to the current maximum delay size
+	parameters:
+		sd: the current simulation's data
+		mds: the array of mutant data
+	returns: nothing
+	notes:
+		This is needed when the sizes change after the mutant data was created (i.e. in daemon mode or when a worker moves to a chunk of streamed sets, see fit_context).
+	todo:
+*/
+void resize_mutant_data (sim_data& sd, mutant_data mds[]) {
+	for (int i = 0; i < sd.num_active_mutants; i++) {
+		mds[i].cl.initialize(MIN_CON_LEVEL, NUM_CON_LEVELS, sd.history_size, sd.cells_total, sd.active_start);
+	}
+}
+
 /* delete_mutant_data frees the given array of mutant data from memory
 	parameters:
 		mds: the array of mutant data
@@ -1284,19 +1513,198 @@ void delete_mutant_data (mutant_data mds[]) {
 	delete[] mds;
 }
 
+/* create_contexts creates a simulation context for every worker thread
+	parameters:
+		ip: the program's input parameters
+		sd: the simulation data created in main, borrowed by the first context and copied by the others
+		rs: the rates created in main, borrowed by the first context and copied by the others
+		mds: the array of mutant data created in main, borrowed by the first context
+		queue: the queue every worker takes parameter sets from
+		dirnames_cons: the array of mutant directory paths
+	returns: the array of contexts
+	notes:
+		Every context gets its own concentration levels, so workers never touch each other's memory while simulating.
+		In ensemble mode every worker gets one context per lane, so worker i owns contexts i * ip.num_lanes through (i + 1) * ip.num_lanes - 1.
+		If tracing, the trace is created with the first contexts and every context records into its worker's timeline.
+	todo:
+*/
+sim_context* create_contexts (input_params& ip, sim_data& sd, rates& rs, mutant_data mds[], set_queue* queue, char** dirnames_cons) {
+	int num_contexts = ip.num_threads * ip.num_lanes;
+	sim_context* contexts = new sim_context[num_contexts];
+	if (ip.print_trace && ip.tracer == NULL) {
+		ip.tracer = new trace_recorder(ip.num_threads);
+	}
+	for (int i = 0; i < num_contexts; i++) {
+		sim_context& ctx = contexts[i];
+		ctx.index = i;
+		ctx.ip = &ip;
+		ctx.queue = queue;
+		ctx.dirnames_cons = dirnames_cons;
+		if (i == 0) { // The first worker uses the data main already created
+			ctx.owns_data = false;
+			ctx.sd = &sd;
+			ctx.rs = &rs;
+			ctx.mds = mds;
+		} else {
+			ctx.owns_data = true;
+			ctx.sd = new sim_data(ip);
+			ctx.sd->max_delay_size = sd.max_delay_size;
+			ctx.sd->history_size = sd.history_size;
+			ctx.sd->history_mask = sd.history_mask;
+			ctx.rs = new rates(sd.width_total, sd.cells_total);
+			copy_rate_factors(rs, *(ctx.rs));
+			ctx.mds = create_mutant_data(*(ctx.sd), ip);
+			declare_feature_demands(ip, *(ctx.sd), ctx.mds);
+			ctx.sd->initialize_conditions_data(ctx.mds);
+		}
+		size_context(ctx);
+		ctx.sd->trace = (ip.tracer != NULL) ? &(ip.tracer->buffers[i / ip.num_lanes]) : NULL;
+		ctx.sd->stream.initialize(sd.cells_total);
+		ctx.sd->watch.initialize(sd.cells_total);
+	}
+	return contexts;
+}
+
+/* size_context sizes everything in the given context that depends on its simulation's maximum delay size
+	parameters:
+		ctx: the worker's context
+	returns: nothing
+	notes:
+	todo:
+*/
+void size_context (sim_context& ctx) {
+	sim_data& sd = *(ctx.sd);
+	int max_cl_size = MAX(sd.steps_til_growth, sd.max_delay_size + sd.steps_total - sd.steps_til_growth) / sd.big_gran + 1;
+	if (sd.stream_features && sd.no_growth) { // Only the posterior is simulated and its features are streamed, so no time steps are stored
+		max_cl_size = 1;
+	}
+	ctx.cl.initialize(MIN_CON_LEVEL, NUM_CON_STORE, max_cl_size, sd.cells_total, sd.active_start); // Concentration levels for analysis and storage
+	ctx.baby_cl.initialize(MIN_CON_LEVEL, NUM_CON_LEVELS, sd.history_size, sd.cells_total, sd.active_start); // Concentration levels for simulating (time in this cl is treated cyclically)
+	sd.lin.initialize(sd.cells_total, sd.width_total, sd.max_delay_size / MAX(sd.steps_split, 1) + 2, sd.history_size, sd.steps_total / MAX(sd.steps_split, 1) + 1); // Enough generations for the longest delay to span a split every sd.steps_split time steps
+}
+
+/* fit_context sizes the given context for a parameter set of the given maximum delay size
+	parameters:
+		ctx: the worker's context
+		max_delay_size: the maximum delay size of the chunk the worker's set came from (see params_stream)
+	returns: nothing
+	notes:
+		Nothing is done if the context already has the size, so a worker only sizes again when it moves to a chunk with a different maximum delay. Every set is then simulated exactly as if its chunk were the only sets given.
+		The memory of the concentration levels is kept whenever it is big enough for the new size.
+	todo:
+*/
+void fit_context (sim_context& ctx, int max_delay_size) {
+	sim_data& sd = *(ctx.sd);
+	if (max_delay_size == sd.max_delay_size) {
+		return;
+	}
+	set_delay_size(sd, max_delay_size);
+	size_context(ctx);
+	resize_mutant_data(sd, ctx.mds);
+}
+
+/* copy_rate_factors copies the perturbation and gradient factors of one rates struct to another
+	parameters:
+		from: the rates to copy from
+		to: the rates to copy to
+	returns: nothing
+	notes:
+		Both structs must have been created with the same width and number of cells.
+	todo:
+*/
+void copy_rate_factors (rates& from, rates& to) {
+	memcpy(to.factors_perturb, from.factors_perturb, sizeof(from.factors_perturb));
+	to.using_gradients = from.using_gradients;
+	for (int i = 0; i < NUM_RATES; i++) {
+		memcpy(to.factors_gradient[i], from.factors_gradient[i], sizeof(double) * from.width);
+		to.has_gradient[i] = from.has_gradient[i];
+	}
+}
+
+/* delete_contexts frees the given array of contexts from memory
+	parameters:
+		contexts: the array of contexts
+		ip: the program's input parameters
+	returns: nothing
+	notes:
+		Only the data a context allocated itself is freed; the data borrowed from main is left for main to free.
+		Each context's profile is added to the first context's before it is freed, so main's profile covers every worker (see print_profile).
+	todo:
+*/
+void delete_contexts (sim_context contexts[], input_params& ip) {
+	for (int i = 0; i < ip.num_threads * ip.num_lanes; i++) {
+		if (contexts[i].owns_data) {
+			if (contexts[i].sd->prof != NULL) { // Keep the worker's times in the first context's profile, which belongs to main
+				contexts[0].sd->prof->merge(*(contexts[i].sd->prof));
+			}
+			delete_mutant_data(contexts[i].mds);
+			delete contexts[i].rs;
+			delete contexts[i].sd;
+		}
+	}
+	delete[] contexts;
+}
+
+/* delete_trace frees the trace from memory
+	parameters:
+		ip: the program's input parameters
+	returns: nothing
+	notes:
+		The trace must be printed first (see print_trace).
+	todo:
+*/
+void delete_trace (input_params& ip) {
+	delete ip.tracer;
+	ip.tracer = NULL;
+}
+
+/* create_ensembles creates an ensemble for every worker thread in ensemble mode
+	parameters:
+		ip: the program's input parameters
+		sd: the simulation data created in main, used to size the ensembles' interleaved data
+		contexts: the array of contexts created by create_contexts, ip.num_lanes of which are given to each ensemble
+	returns: the array of ensembles
+	notes:
+	todo:
+*/
+ensemble* create_ensembles (input_params& ip, sim_data& sd, sim_context contexts[]) {
+	ensemble* ensembles = new ensemble[ip.num_threads];
+	for (int i = 0; i < ip.num_threads; i++) {
+		ensembles[i].initialize(ip.num_lanes, &contexts[i * ip.num_lanes], sd);
+	}
+	return ensembles;
+}
+
+/* delete_ensembles frees the given array of ensembles from memory
+	parameters:
+		ensembles: the array of ensembles
+	returns: nothing
+	notes:
+		The lanes' contexts are freed separately with delete_contexts.
+	todo:
+*/
+void delete_ensembles (ensemble ensembles[]) {
+	delete[] ensembles;
+}
+
 /* delete_sets frees the given array of parameter sets from memory
 	parameters:
 		sets: the array of parameter sets
 		ip: the program's input parameters
 	returns: nothing
 	notes:
+		The stream of a parameter sets file is freed here too since it replaces sets (which is then NULL).
 	todo:
 */
 void delete_sets (double** sets, input_params& ip) {
-	for (int i = 0; i < ip.num_sets; i++) {
-		delete[] sets[i];
+	if (sets != NULL) {
+		for (int i = 0; i < ip.num_sets; i++) {
+			delete[] sets[i];
+		}
+		delete[] sets;
 	}
-	delete[] sets;
+	delete ip.pstream;
+	ip.pstream = NULL;
 }
 
 /* copy_cl_to_mutant copies the given concentration levels to the given mutant's concentration levels
@@ -1306,17 +1714,17 @@ void delete_sets (double** sets, input_params& ip) {
 		md: the data of the mutant that just ran
 	returns: nothing
 	notes:
+		cl is a ring of sd.history_size time steps whose oldest step is sd.time_baby (where the simulation left off). The ring is unrolled so the mutant stores the steps from oldest to newest, making its newest step history_size - 1.
 	todo:
 */
 void copy_cl_to_mutant (sim_data& sd, con_levels& cl, mutant_data& md) {
-	for (int i = 0; i < cl.num_con_levels; i++) {
-		for (int j_sim = sd.time_baby, j_md = 0; j_md < sd.max_delay_size; j_sim = WRAP(j_sim + 1, sd.max_delay_size), j_md++) {
-			for (int k = 0; k < cl.cells; k++) {
-				md.cl.cons[i][j_md][k] = cl.cons[i][j_sim][k];
-			}
-			md.cl.active_start_record[j_md] = cl.active_start_record[j_sim];
-			md.cl.active_end_record[j_md] = cl.active_end_record[j_sim];
+	for (int j_md = 0; j_md < sd.history_size; j_md++) {
+		int j_sim = RING(sd.time_baby + j_md, sd.history_mask);
+		for (int i = cl.first_level; i < cl.num_con_levels; i++) {
+			memcpy(md.cl.cons[i][j_md], cl.cons[i][j_sim], sizeof(double) * cl.cells);
 		}
+		md.cl.active_start_record[j_md] = cl.active_start_record[j_sim];
+		md.cl.active_end_record[j_md] = cl.active_end_record[j_sim];
 	}
 }
 
@@ -1327,22 +1735,16 @@ void copy_cl_to_mutant (sim_data& sd, con_levels& cl, mutant_data& md) {
 		md: the data of the mutant that will run again
 	returns: nothing
 	notes:
+		The mutant's steps are stored oldest to newest (see copy_cl_to_mutant), so after copying them in order the newest step is history_size - 1, which is exactly the previous step of ring position 0 where the next simulation starts.
 	todo:
 */
 void copy_mutant_to_cl (sim_data& sd, con_levels& cl, mutant_data& md) {
-	for (int i = 0; i < md.cl.num_con_levels; i++) {
-		for (int j = 0; j < md.cl.time_steps; j++) {
-			for (int k = 0; k < md.cl.cells; k++) {
-				cl.cons[i][j][k] = md.cl.cons[i][j][k];
-			}
-			cl.active_start_record[j] = md.cl.active_start_record[j];
-			cl.active_end_record[j] = md.cl.active_end_record[j];
-		}
-	}
-	for (int j = 0; j < md.cl.time_steps; j++) {
-		for (int k = 0; k < md.cl.cells; k++) {
-			cl.cons[BIRTH][j][k] -= sd.steps_til_growth + sd.max_delay_size;
+	for (int j = 0; j < sd.history_size; j++) {
+		for (int i = md.cl.first_level; i < md.cl.num_con_levels; i++) {
+			memcpy(cl.cons[i][j], md.cl.cons[i][j], sizeof(double) * md.cl.cells);
 		}
+		cl.active_start_record[j] = md.cl.active_start_record[j];
+		cl.active_end_record[j] = md.cl.active_end_record[j];
 	}
 }
 
@@ -28,25 +28,28 @@ init.hpp contains function declarations for init.cpp.
 using namespace std;
 
 char* copy_str(const char*);
-int random_int(pair<int, int>);
-double random_double(pair<double, double>);
+int random_int(rng_state&, pair<int, int>);
+double random_double(rng_state&, pair<double, double>);
 double interpolate(double, int, int, double, double);
 void init_terminal();
 void free_terminal();
 void accept_input_params(int, char**, input_params&);
 bool option_set(const char*, const char*, const char*);
 void ensure_nonempty(const char*, const char*);
+void store_cons_levels(input_params&, char*);
 void check_input_params(input_params&);
 int generate_seed();
 void init_seeds(input_params&, int, bool, bool);
-void reset_seed(input_params&, sim_data& sd);
+void reset_seed(sim_data&, int);
 void init_verbosity(input_params&);
 void read_sim_params(input_params&, input_data&, double**&, input_data&);
 void read_perturb_params(input_params&, input_data&);
 void read_gradients_params(input_params&, input_data&);
-void fill_perturbations(rates&, char*);
-void fill_gradients(rates&, char*);
-void calc_max_delay_size(input_params&, sim_data&, rates&, double**);
+void fill_perturbations(rates&, input_data&);
+void fill_gradients(rates&, input_data&);
+int calc_delay_size(sim_data&, rates&, double**, int);
+void set_delay_size(sim_data&, int);
+bool calc_max_delay_size(input_params&, sim_data&, rates&, double**);
 void delete_file(ofstream*);
 ofstream* create_passed_file(input_params&);
 char** create_dirs(input_params&, sim_data&, mutant_data[]);
@@ -55,7 +58,17 @@ ofstream* create_features_file(input_params&, mutant_data[]);
 ofstream* create_conditions_file(input_params&, mutant_data[]);
 ofstream* create_scores_file (input_params&, mutant_data[]);
 mutant_data* create_mutant_data(sim_data&, input_params&);
+void declare_feature_demands(input_params&, sim_data&, mutant_data[]);
+void resize_mutant_data(sim_data&, mutant_data[]);
 void delete_mutant_data(mutant_data[]);
+sim_context* create_contexts(input_params&, sim_data&, rates&, mutant_data[], set_queue*, char**);
+void size_context(sim_context&);
+void fit_context(sim_context&, int);
+void copy_rate_factors(rates&, rates&);
+void delete_contexts(sim_context[], input_params&);
+void delete_trace(input_params&);
+ensemble* create_ensembles(input_params&, sim_data&, sim_context[]);
+void delete_ensembles(ensemble[]);
 void delete_sets(double**, input_params&);
 void copy_cl_to_mutant(sim_data&, con_levels&, mutant_data&);
 void copy_mutant_to_cl(sim_data&, con_levels&, mutant_data&);
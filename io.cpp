@@ -21,19 +21,36 @@ io.cpp contains functions for input and output of files and pipes. All I/O relat
 */
 
 #include <cerrno> // Needed for errno, EEXIST
-#include <cstdio> // Needed for fopen, fclose, fseek, ftell, rewind
-#include <sys/stat.h> // Needed for mkdir
-#include <unistd.h> // Needed for read, write, close
+#include <cstdio> // Needed for fopen, fclose, fread, fileno
+#include <sys/stat.h> // Needed for mkdir, fstat
+#include <unistd.h> // Needed for read, write, close, sysconf
+#include <fcntl.h> // Needed for O_RDWR
+#include <sched.h> // Needed for sched_yield
+#include <signal.h> // Needed for kill
+#include <ctime> // Needed for nanosleep
+#include <sys/mman.h> // Needed for shm_open, mmap, munmap, madvise
+#include <climits> // Needed for INT_MAX
+#include <iomanip> // Needed for setprecision
+#include <locale.h> // Needed for newlocale, strtod_l
 
 #include "io.hpp" // Function declarations
 #include "sim.hpp" // Needed for anterior_time
 
 #include "main.hpp"
 
+#if defined(CHECK_CCONS)
+	#include "debug.hpp" // Needed for check_ccons_column
+#endif
+
 using namespace std;
 
 extern terminal* term; // Declared in init.cpp
 
+output_writer* running_writer = NULL; // The output writer while its thread runs, so quit can finish it (see finish_output_writer)
+
+const char* phase_names[NUM_PHASES] = {"model", "update_rates", "calculate_delay_indices", "split", "osc_features_post", "osc_features_ant", "osc_features_stream", "test", "wave_testing", "print_concentrations", "print_cell_columns", "print_passed", "print_osc_features", "print_conditions", "print_scores"}; // The name of each phase in the profile and trace, indexed by the PHASE_ macros
+const char* section_names[NUM_SECTIONS + 1] = {"posterior", "anterior", "wave", "none"}; // The name of each section in the profile and trace, plus the extra section of phases outside of any mutant
+
 /* not_EOL returns whether or not a given character is the end of a line or file (i.e. '\n' or '\0', respectively)
 	parameters:
 		c: the character to check
@@ -74,7 +91,7 @@ void create_dir (char* dir) {
 	// Create a directory, allowing the owner and group to read and write but others to only read
 	if (mkdir(dir, 0775) != 0 && errno != EEXIST) { // If the error is that the directory already exists, ignore it
 		cout << term->red << "Couldn't create '" << dir << "' directory!" << term->reset << endl;
-		exit(EXIT_FILE_WRITE_ERROR);
+		quit(EXIT_FILE_WRITE_ERROR);
 	}
 	
 	term->done();
@@ -100,17 +117,70 @@ void open_file (ofstream* file_pointer, char* file_name, bool append) {
 		}
 	} catch (ofstream::failure) {
 		cout << term->red << "Couldn't write to " << file_name << "!" << term->reset << endl;
-		exit(EXIT_FILE_WRITE_ERROR);
+		quit(EXIT_FILE_WRITE_ERROR);
 	}
 	term->done();
 }
 
+/* map_file maps the file of the given input_data struct into memory if it is a regular file
+	parameters:
+		ifd: the input_data struct to contain the mapping
+		file: the file, already opened
+	returns: true if the file was mapped, false if it must be read instead (e.g. it is a pipe)
+	notes:
+		Pages are only read from disk as the parsers reach them, and the kernel is told they will be reached in order so it reads ahead of the parsers. A file of any size therefore takes no memory up front and reading it overlaps with parsing it.
+		The file is mapped over an anonymous mapping one page longer than it, so its contents are always followed by null characters like a buffer that was read into.
+	todo:
+*/
+bool map_file (input_data* ifd, FILE* file) {
+	struct stat info;
+	if (fstat(fileno(file), &info) != 0 || !S_ISREG(info.st_mode)) {
+		return false;
+	}
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t size = info.st_size;
+	size_t length = (size + page - 1) / page * page + page;
+	void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	if (size > 0) {
+		if (mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fileno(file), 0) == MAP_FAILED) {
+			munmap(map, length);
+			return false;
+		}
+		madvise(map, size, MADV_SEQUENTIAL);
+	}
+	ifd->map = (char*)map;
+	ifd->map_length = length;
+	ifd->map_size = size;
+	ifd->map_offset = 0;
+	return true;
+}
+
+/* release_map tells the kernel the pages of the given input_data struct's mapping before the given offset will not be read again
+	parameters:
+		ifd: the input_data struct with the mapping
+		offset: the offset in the mapped file before which every page has been parsed
+	returns: nothing
+	notes:
+		The pages are dropped from the process's memory, so parsing a file a block at a time keeps only about a block of it resident.
+	todo:
+*/
+void release_map (input_data* ifd, size_t offset) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t end = offset / page * page;
+	if (end > 0) {
+		madvise(ifd->map, end, MADV_DONTNEED);
+	}
+}
+
 /* read_file takes an input_data struct and stores the contents of the associated file in a string
 	parameters:
 		ifd: the input_data struct to contain the file name, buffer to store the contents, size of the file, and current index
 	returns: nothing
 	notes:
-		The buffer in ifd will be sized large enough to fit the file
+		A regular file is mapped into memory and the buffer points to the mapping (see map_file), so its contents are never copied. Any other file is read into a buffer sized large enough to fit it.
 	todo:
 */
 void read_file (input_data* ifd) {
@@ -120,86 +190,480 @@ void read_file (input_data* ifd) {
 	FILE* file = fopen(ifd->filename, "r");
 	if (file == NULL) {
 		cout << term->red << "Couldn't open " << ifd->filename << "!" << term->reset << endl;
-		exit(EXIT_FILE_READ_ERROR);
+		quit(EXIT_FILE_READ_ERROR);
 	}
 	
-	// Seek to the end of the file, grab its size, and then rewind
-	fseek(file, 0, SEEK_END);
-	long size = ftell(file);
-	ifd->size = size;
-	rewind(file);
-	
-	// Allocate enough memory to contain the whole file
-	ifd->buffer = (char*)mallocate(sizeof(char) * size + 1);
-	
-	// Copy the file's contents into the buffer
-	long result = fread(ifd->buffer, 1, size, file);
-	if (result != size) {
-		cout << term->red << "Couldn't read from " << ifd->filename << term->reset << endl;
-		exit(EXIT_FILE_READ_ERROR);
+	if (map_file(ifd, file)) {
+		if (ifd->map_size > (size_t)INT_MAX) {
+			cout << term->red << "Couldn't read " << ifd->filename << ", which is larger than " << INT_MAX << " bytes!" << term->reset << endl;
+			quit(EXIT_FILE_READ_ERROR);
+		}
+		ifd->buffer = ifd->map;
+		ifd->size = ifd->map_size;
+	} else {
+		// Read the file a block at a time since its size cannot be known before reading it
+		long size = 0;
+		long capacity = PARAMS_BLOCK;
+		ifd->buffer = (char*)mallocate(sizeof(char) * capacity + 1);
+		while (true) {
+			size += fread(ifd->buffer + size, 1, capacity - size, file);
+			if (ferror(file)) {
+				cout << term->red << "Couldn't read from " << ifd->filename << term->reset << endl;
+				quit(EXIT_FILE_READ_ERROR);
+			}
+			if (size < capacity) {
+				break;
+			}
+			if (capacity > INT_MAX / 2) {
+				cout << term->red << "Couldn't read " << ifd->filename << ", which is larger than " << INT_MAX << " bytes!" << term->reset << endl;
+				quit(EXIT_FILE_READ_ERROR);
+			}
+			char* buffer = (char*)mallocate(sizeof(char) * capacity * 2 + 1);
+			memcpy(buffer, ifd->buffer, capacity);
+			mfree(ifd->buffer);
+			ifd->buffer = buffer;
+			capacity *= 2;
+		}
+		ifd->buffer[size] = '\0';
+		ifd->size = size;
 	}
-	ifd->buffer[size] = '\0';
 	
 	// Close the file
 	if (fclose(file) != 0) {
 		cout << term->red << "Couldn't close " << ifd->filename << term->reset << endl;
-		exit(EXIT_FILE_READ_ERROR);
+		quit(EXIT_FILE_READ_ERROR);
 	}
 	
 	term->done();
 }
 
-/* parse_param_line reads a line in the given parameter sets buffer and stores it in the given array of doubles
+/* open_stream opens the file of the given input_data struct to be read a block at a time with read_stream
+	parameters:
+		ifd: the input_data struct to contain the file name, the open file, and a buffer for its blocks
+	returns: nothing
+	notes:
+		Nothing is read until read_stream is called, so opening a file of any size is immediate.
+		A regular file is mapped into memory (see map_file) and closed, and each block is a window of the mapping. Any other file is kept open and each block is read into a buffer, which is only allocated then so a binary file that is read directly never needs one.
+	todo:
+*/
+void open_stream (input_data* ifd) {
+	cout << term->blue << "Streaming file " << term->reset << ifd->filename << " . . . ";
+	ifd->file = fopen(ifd->filename, "r");
+	if (ifd->file == NULL) {
+		cout << term->red << "Couldn't open " << ifd->filename << "!" << term->reset << endl;
+		quit(EXIT_FILE_READ_ERROR);
+	}
+	if (map_file(ifd, ifd->file)) {
+		fclose(ifd->file);
+		ifd->file = NULL;
+	}
+	ifd->capacity = PARAMS_BLOCK;
+	ifd->size = 0;
+	ifd->index = 0;
+	term->done();
+}
+
+/* read_stream reads the next block of whole lines from the file of the given input_data struct into its buffer
+	parameters:
+		ifd: the input_data struct opened with open_stream
+	returns: true if a block was read, false if the end of the file was reached
+	notes:
+		The buffer ends after the block's last newline, so a line is never split between blocks. The partial line read after the block is kept to start the next block.
+		If a single line does not fit in the buffer the buffer doubles until it does.
+		The last block of the file is followed by two null characters and every other block ends in a newline, so the parsers never read past the block.
+		The block of a mapped file is the window of the mapping up to the last newline within the buffer's capacity, or up to the end of the line if the line is longer. The pages before the window are released (see release_map).
+	todo:
+*/
+bool read_stream (input_data* ifd) {
+	if (ifd->map != NULL) {
+		size_t start = ifd->map_offset;
+		if (start >= ifd->map_size) {
+			return false;
+		}
+		release_map(ifd, start);
+		size_t end = ifd->map_size;
+		if (end - start > (size_t)ifd->capacity) {
+			const char* last = ifd->map + start + ifd->capacity;
+			for (; last > ifd->map + start && last[-1] != '\n'; last--);
+			if (last == ifd->map + start) { // The line is longer than the capacity, so the window takes all of it
+				last = (const char*)memchr(ifd->map + start, '\n', ifd->map_size - start);
+				last = (last == NULL) ? ifd->map + ifd->map_size : last + 1;
+			}
+			end = last - ifd->map;
+		}
+		if (end - start > (size_t)INT_MAX) {
+			cout << term->red << "Couldn't read from " << ifd->filename << ", which has a line longer than " << INT_MAX << " bytes!" << term->reset << endl;
+			quit(EXIT_FILE_READ_ERROR);
+		}
+		ifd->buffer = ifd->map + start;
+		ifd->size = end - start;
+		ifd->index = 0;
+		ifd->line_start = 0;
+		ifd->map_offset = end;
+		return true;
+	}
+	if (ifd->buffer == NULL) {
+		ifd->buffer = (char*)mallocate(sizeof(char) * ifd->capacity + 2);
+	}
+	while (true) {
+		// Start with the partial line left after the previous block, since a pipe cannot be rewound to read it again
+		long kept = ifd->left;
+		if (kept > 0) {
+			memmove(ifd->buffer, ifd->buffer + ifd->size, kept);
+		}
+		long read = kept + fread(ifd->buffer + kept, 1, ifd->capacity - kept, ifd->file);
+		if (ferror(ifd->file)) {
+			cout << term->red << "Couldn't read from " << ifd->filename << term->reset << endl;
+			quit(EXIT_FILE_READ_ERROR);
+		}
+		ifd->size = 0;
+		ifd->left = 0;
+		if (read == 0) {
+			return false;
+		}
+		
+		// Keep the block up to its last newline unless the file ended within it
+		long end = read;
+		if (read == ifd->capacity) {
+			for (end = read; end > 0 && ifd->buffer[end - 1] != '\n'; end--);
+			if (end == 0) { // The line is longer than the buffer, so grow the buffer and keep reading it
+				char* buffer = (char*)mallocate(sizeof(char) * ifd->capacity * 2 + 2);
+				memcpy(buffer, ifd->buffer, read);
+				mfree(ifd->buffer);
+				ifd->buffer = buffer;
+				ifd->capacity *= 2;
+				ifd->left = read;
+				continue;
+			}
+		}
+		ifd->left = read - end;
+		if (ifd->left == 0) { // The block ends the file (a block with a partial line after it ends in a newline instead)
+			ifd->buffer[end] = '\0';
+			ifd->buffer[end + 1] = '\0';
+		}
+		ifd->size = end;
+		ifd->index = 0;
+		ifd->line_start = 0;
+		return true;
+	}
+}
+
+/* read_bytes copies the given number of bytes from the file of the given input_data struct, opened with open_stream, to the given destination
+	parameters:
+		ifd: the input_data struct of the file
+		destination: where to copy the bytes
+		bytes: the number of bytes to copy
+	returns: the number of bytes copied, less than bytes only if the file ended
+	notes:
+		Bytes are copied from the mapping of a mapped file, releasing the pages before them (see release_map), or read from the file otherwise.
+	todo:
+*/
+size_t read_bytes (input_data* ifd, void* destination, size_t bytes) {
+	if (ifd->map == NULL) {
+		return fread(destination, 1, bytes, ifd->file);
+	}
+	bytes = MIN(bytes, ifd->map_size - ifd->map_offset);
+	memcpy(destination, ifd->map + ifd->map_offset, bytes);
+	ifd->map_offset += bytes;
+	release_map(ifd, ifd->map_offset);
+	return bytes;
+}
+
+/* skip_blanks advances the given index past any spaces, tabs, and carriage returns in the given buffer
+	parameters:
+		buffer: the buffer being parsed
+		index: the index to advance
+	returns: nothing
+	notes:
+	todo:
+*/
+void skip_blanks (const char* buffer, int& index) {
+	while (buffer[index] == ' ' || buffer[index] == '\t' || buffer[index] == '\r') {
+		index++;
+	}
+}
+
+/* end_of_content returns whether or not the given character ends the content of a line (i.e. it is the end of the line or file or starts a comment)
+	parameters:
+		c: the character to check
+	returns: true if c ends the content of a line, false otherwise
+	notes:
+	todo:
+*/
+bool end_of_content (char c) {
+	return !not_EOL(c) || c == '#';
+}
+
+/* next_line advances the given input_data struct's index to the start of the next line, skipping anything left on the current one
+	parameters:
+		data: the input_data struct being parsed
+	returns: nothing
+	notes:
+	todo:
+*/
+void next_line (input_data& data) {
+	while (data.index < data.size && not_EOL(data.buffer[data.index])) {
+		data.index++;
+	}
+	if (data.index < data.size) { // Skip the newline (or a stray null character, which would otherwise be parsed forever)
+		data.index++;
+	}
+	data.line++;
+	data.line_start = data.index;
+}
+
+/* parse_double parses the floating point number at the given index of the given buffer
+	parameters:
+		buffer: the buffer being parsed
+		index: the index of the number, advanced past it if one was found
+		value: set to the number found
+	returns: true if a number was found, false otherwise
+	notes:
+		Numbers are decimal with an optional sign, fraction, and exponent (e.g. -1.5e3) and are parsed the same no matter the program's locale.
+		A number with at most 19 significant digits and a power of ten of at most 22 either way (i.e. any number printed with %g) is exactly a product or quotient of two doubles, so it is calculated directly. Any other number is given to strtod in the C locale. Both round correctly, so every number is the same double sscanf would give.
+	todo:
+*/
+bool parse_double (const char* buffer, int& index, double& value) {
+	static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char* c = buffer + index;
+	bool negative = *c == '-';
+	if (*c == '-' || *c == '+') {
+		c++;
+	}
+	
+	// Gather the significant digits into the mantissa and track the power of ten
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int num_digits = 0; // The number of digits found
+	int num_significant = 0; // The number of digits in the mantissa after any leading zeros
+	bool direct = true; // Whether or not the number can be calculated directly
+	for (; *c >= '0' && *c <= '9'; c++, num_digits++) {
+		if (num_significant < 19) {
+			mantissa = mantissa * 10 + (*c - '0');
+			num_significant += mantissa != 0;
+		} else {
+			direct = false;
+		}
+	}
+	if (*c == '.') {
+		for (c++; *c >= '0' && *c <= '9'; c++, num_digits++) {
+			if (num_significant < 19) {
+				mantissa = mantissa * 10 + (*c - '0');
+				num_significant += mantissa != 0;
+				exponent--;
+			} else {
+				direct = false;
+			}
+		}
+	}
+	if (num_digits == 0) {
+		return false;
+	}
+	if (*c == 'e' || *c == 'E') { // The exponent is only part of the number if it has digits
+		const char* e = c + 1;
+		bool negative_exponent = *e == '-';
+		if (*e == '-' || *e == '+') {
+			e++;
+		}
+		if (*e >= '0' && *e <= '9') {
+			int given = 0;
+			for (; *e >= '0' && *e <= '9'; e++) {
+				given = MIN(given * 10 + (*e - '0'), 100000); // Any larger exponent overflows or underflows anyway
+			}
+			exponent += negative_exponent ? -given : given;
+			c = e;
+		}
+	}
+	
+	// Calculate the number
+	if (direct && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		double result = mantissa;
+		result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+		value = negative ? -result : result;
+		index = c - buffer;
+	} else {
+		static locale_t c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+		char* end;
+		value = strtod_l(buffer + index, &end, c_locale);
+		index = end - buffer;
+	}
+	return true;
+}
+
+/* parse_int parses the integer at the given index of the given buffer
+	parameters:
+		buffer: the buffer being parsed
+		index: the index of the integer, advanced past it if one was found
+		value: set to the integer found
+	returns: true if an integer was found, false otherwise
+	notes:
+		An integer too large for an int is clamped to the largest int with its sign.
+	todo:
+*/
+bool parse_int (const char* buffer, int& index, int& value) {
+	int i = index;
+	bool negative = buffer[i] == '-';
+	if (buffer[i] == '-' || buffer[i] == '+') {
+		i++;
+	}
+	if (buffer[i] < '0' || buffer[i] > '9') {
+		return false;
+	}
+	long result = 0;
+	for (; buffer[i] >= '0' && buffer[i] <= '9'; i++) {
+		result = MIN(result * 10 + (buffer[i] - '0'), (long)INT_MAX);
+	}
+	value = negative ? -result : result;
+	index = i;
+	return true;
+}
+
+/* parse_error prints where the given input_data struct could not be parsed and then exits
+	parameters:
+		data: the input_data struct being parsed, whose index is where the error is
+		message: what was expected instead
+	returns: nothing
+	notes:
+		Lines and columns are counted from 1.
+	todo:
+*/
+void parse_error (input_data& data, const char* message) {
+	cout << term->red << "Couldn't parse " << data.filename << " at line " << data.line + 1 << ", column " << data.index - data.line_start + 1 << "! " << message << term->reset << endl;
+	quit(EXIT_INPUT_ERROR);
+}
+
+/* parse_param_line parses the next parameter set in the given parameter sets buffer and stores it in the given array of doubles
 	parameters:
 		params: the array of doubles to store the parameters in
-		buffer_line: the buffer with the line to read
-		index_buffer: the index of the buffer to start from
-	returns: true if a line was found, false if the end of the file was reached without finding a valid line
+		data: the input_data struct of the buffer, whose index is advanced to the start of the line after the set
+	returns: true if a set was found, false if the end of the buffer was reached without finding one
 	notes:
 		The buffer should contain one parameter set per line, each set containing comma-separated floating point parameters.
-		Blank lines and lines starting with # will be ignored.
+		Blank lines and lines starting with # will be ignored, as will anything after a # following a set.
 		Each line must contain the correct number of parameters or the program will exit.
-		index_buffer is a reference, allowing this function to store where it finished parsing.
-	todo:
-*/
-bool parse_param_line (double* params, char* buffer_line, int& index_buffer) {
-	static const char* usage_message = "There was an error reading the given parameter sets file.";
-	int index_params = 0; // Current index in params
-	int index_digits = index_buffer; // Index of the start of the digits to read
-	int i = index_buffer; // Current index in buffer_line
-	int line_start = i; // The start of the line, used to tell whether or not a line is empty
-	for (; not_EOL(buffer_line[i]); i++) {
-		if (buffer_line[i] == '#') { // Skip any lines starting with #
-			for(; not_EOL(buffer_line[i]); i++);
+	todo:
+*/
+bool parse_param_line (double* params, input_data& data) {
+	char* buffer = data.buffer;
+	int& i = data.index;
+	while (i < data.size) {
+		skip_blanks(buffer, i);
+		if (end_of_content(buffer[i])) { // Skip blank lines and comments
+			next_line(data);
+			continue;
+		}
+		
+		// Read every comma-separated parameter, counting any beyond the set's size so the error gives how many the line has
+		int num_params = 0;
+		while (true) {
+			double param;
+			if (!parse_double(buffer, i, param)) {
+				parse_error(data, "Expected a number.");
+			}
+			if (num_params < NUM_RATES) {
+				params[num_params] = param;
+			}
+			num_params++;
+			skip_blanks(buffer, i);
+			if (buffer[i] != ',') {
+				break;
+			}
 			i++;
-		} else if (buffer_line[i] == ',') { // Indicates the end of the digits to read
-			if (sscanf(buffer_line + index_digits, "%lf", &(params[index_params++])) < 1) { // Convert the string of digits to a double when storing it in params
-				usage(usage_message);
+			skip_blanks(buffer, i);
+		}
+		if (!end_of_content(buffer[i])) {
+			parse_error(data, "Expected a comma or the end of the line.");
+		}
+		if (num_params != NUM_RATES) {
+			cout << term->red << "The given parameter sets file contains sets with an incorrect number of rates! This simulation requires " << NUM_RATES << " per set but line " << data.line + 1 << " contains " << num_params << "." << term->reset << endl;
+			quit(EXIT_INPUT_ERROR);
+		}
+		next_line(data);
+		return true;
+	}
+	return false;
+}
+
+/* read_params_header checks whether or not the file of the given stream is a binary parameter sets file and reads its header if it is
+	parameters:
+		ps: the stream of the parameter sets file, just opened
+	returns: nothing
+	notes:
+		A text file is parsed from its start, including the bytes read to check for the header.
+	todo:
+*/
+void read_params_header (params_stream& ps) {
+	input_data& data = *(ps.data);
+	params_header header;
+	memset(&header, 0, sizeof(params_header));
+	size_t read = read_bytes(&data, &header, sizeof(params_header));
+	if (read >= sizeof(uint32_t) && header.magic == PARAMS_MAGIC) {
+		if (read != sizeof(params_header) || header.num_sets < 0) {
+			cout << term->red << "Couldn't read the header of " << data.filename << "!" << term->reset << endl;
+			quit(EXIT_FILE_READ_ERROR);
+		}
+		if (header.num_rates != NUM_RATES) {
+			cout << term->red << "The given parameter sets file contains sets with an incorrect number of rates! This simulation requires " << NUM_RATES << " per set but the file's header gives " << header.num_rates << " per set." << term->reset << endl;
+			quit(EXIT_INPUT_ERROR);
+		}
+		ps.binary = true;
+		ps.sets_left = header.num_sets;
+	} else if (data.map != NULL) { // A text file is parsed from the start
+		data.map_offset = 0;
+	} else { // A pipe cannot be rewound, so the bytes read start the first block (see read_stream)
+		if (data.buffer == NULL) {
+			data.buffer = (char*)mallocate(sizeof(char) * data.capacity + 2);
+		}
+		memcpy(data.buffer, &header, read);
+		data.size = 0;
+		data.left = read;
+	}
+}
+
+/* read_params_chunk parses the next chunk of parameter sets from the given stream
+	parameters:
+		ps: the stream of the parameter sets file
+		max_sets: the most sets the chunk can take
+	returns: the number of sets in the chunk, less than max_sets only if the file ended
+	notes:
+		The chunk replaces the previous one, so every set of the previous chunk must have been taken.
+		The sets of a binary file are read straight into the chunk without parsing (see params_header).
+		The chunk's delay size is not calculated here since it depends on the simulation's rates (see take_set).
+	todo:
+*/
+int read_params_chunk (params_stream& ps, int max_sets) {
+	input_data& data = *(ps.data);
+	ps.chunk++;
+	ps.first_set += ps.num_sets;
+	ps.num_sets = 0;
+	if (ps.binary) {
+		int num_sets = MIN((int64_t)max_sets, ps.sets_left);
+		for (; ps.num_sets < num_sets; ps.num_sets++) {
+			if (read_bytes(&data, ps.sets[ps.num_sets], sizeof(double) * NUM_RATES) != sizeof(double) * NUM_RATES) {
+				cout << term->red << "Couldn't read from " << data.filename << ", which ended before its last set!" << term->reset << endl;
+				quit(EXIT_FILE_READ_ERROR);
 			}
-			index_digits = i + 1;
 		}
+		ps.sets_left -= ps.num_sets;
+		return ps.num_sets;
 	}
-	index_buffer = i + 1;
-	if (i - line_start > 0) { // This line has content
-		if (sscanf(buffer_line + index_digits, "%lf", &(params[index_params++])) < 1) {
-			usage(usage_message);
+	while (ps.num_sets < max_sets) {
+		if (data.index >= data.size) { // The block has been parsed, so read the next one
+			if (!read_stream(&data)) {
+				break;
+			}
 		}
-		if (index_params != NUM_RATES) {
-			cout << term->red << "The given parameter sets file contains sets with an incorrect number of rates! This simulation requires " << NUM_RATES << " per set but at least one line contains " << index_params << " per set." << term->reset << endl;
-			exit(EXIT_INPUT_ERROR);
+		if (parse_param_line(ps.sets[ps.num_sets], data)) { // The rest of the block may only hold blank lines and comments
+			ps.num_sets++;
 		}
-		return true;
-	} else if (buffer_line[index_buffer] != '\0') { // There are more lines to try to parse
-		return parse_param_line(params, buffer_line, index_buffer);
-	} else { // The end of the buffer was found
-		return false;
 	}
+	return ps.num_sets;
 }
 
 /* parse_ranges_file reads the given buffer and stores every range found in the given ranges array
 	parameters:
 		ranges: the array of pairs in which to store the lower and upper bounds of each range
-		buffer: the buffer with the ranges to read
+		data: the input_data struct of the ranges file
 	returns: nothing
 	notes:
 		The buffer should contain one range per line, starting the name of the parameter followed by the bracked enclosed lower and then upper bound optionally followed by comments.
@@ -208,57 +672,77 @@ bool parse_param_line (double* params, char* buffer_line, int& index_buffer) {
 		Blank lines and lines starting with # will be ignored. Anything after the upper bound is ignored.
 	todo:
 */
-void parse_ranges_file (pair <double, double> ranges[], char* buffer) {
-	int i = 0;
+void parse_ranges_file (pair <double, double> ranges[], input_data& data) {
+	char* buffer = data.buffer;
+	int& i = data.index;
 	int rate = 0;
-	for (; buffer[i] != '\0'; i++) {
-		// Ignore lines starting with #
-		while (buffer[i] == '#') {
-			while (buffer[i] != '\n' && buffer[i] != '\0') {i++;}
-			i++;			
+	while (i < data.size) {
+		skip_blanks(buffer, i);
+		if (end_of_content(buffer[i])) { // Skip blank lines and comments
+			next_line(data);
+			continue;
 		}
 		
-		// Ignore whitespace before the opening bracket
-		while (buffer[i] != '[' && buffer[i] != '\0') {i++;}
-		if (buffer[i] == '\0') {break;}
+		// Skip the name before the opening bracket
+		while (not_EOL(buffer[i]) && buffer[i] != '[') {
+			i++;
+		}
+		if (buffer[i] != '[') {
+			parse_error(data, "Expected a range in brackets, e.g. 'msh1 [30, 65]'.");
+		}
+		if (rate == NUM_RATES) {
+			parse_error(data, "There are more ranges than rates in the simulation.");
+		}
 		i++;
 		
 		// Read the bounds
-		ranges[rate].first = atof(buffer + i);
-		while (buffer[i] != ',') {i++;}
+		pair <double, double>& range = ranges[rate++];
+		skip_blanks(buffer, i);
+		if (!parse_double(buffer, i, range.first)) {
+			parse_error(data, "Expected the lower bound.");
+		}
+		skip_blanks(buffer, i);
+		if (buffer[i] != ',') {
+			parse_error(data, "Expected a comma between the bounds.");
+		}
 		i++;
-		ranges[rate].second = atof(buffer + i);
-		if (ranges[rate].first < 0 || ranges[rate].second < 0) { // If the ranges are invalid then set them to 0
-			ranges[rate].first = 0;
-			ranges[rate].second = 0;
+		skip_blanks(buffer, i);
+		if (!parse_double(buffer, i, range.second)) {
+			parse_error(data, "Expected the upper bound.");
+		}
+		skip_blanks(buffer, i);
+		if (buffer[i] != ']') {
+			parse_error(data, "Expected a closing bracket after the upper bound.");
 		}
-		rate++;
-		// Skip any comments until the end of the line
-		while (buffer[i] != '\n' && buffer[i] != '\0') {i++;}
+		if (range.first < 0 || range.second < 0) { // If the ranges are invalid then set them to 0
+			range.first = 0;
+			range.second = 0;
+		}
+		next_line(data); // Skip any comments until the end of the line
 	}
 }
 
 /* print_passed prints the parameter sets that passed all required conditions of all required mutants
 	parameters:
 		ip: the program's input parameters
-		file_passed: a pointer to the output file stream to open the file with
+		file_passed: a pointer to the output stream to print to (the passed file or a buffer for it)
 		rs: the current simulation's rates to pull the parameter sets from
 	returns: nothing
 	notes:
 		This function prints each parameter separated by a comma, one set per line.
 	todo:
 */
-void print_passed (input_params& ip, ofstream* file_passed, rates& rs) {
+void print_passed (input_params& ip, ostream* file_passed, rates& rs) {
 	if (ip.print_passed) { // Print which sets passed only if the user specified it
 		try {
 			*file_passed << rs.rates_base[0];
 			for (int i = 1; i < NUM_RATES; i++) {
 				*file_passed << "," << rs.rates_base[i];
 			}
-			*file_passed << endl;
+			*file_passed << "\n";
 		} catch (ofstream::failure) {
 			cout << term->red << "Couldn't write to " << ip.passed_file << "!" << term->reset << endl;
-			exit(EXIT_FILE_WRITE_ERROR);
+			quit(EXIT_FILE_WRITE_ERROR);
 		}
 	}
 }
@@ -273,10 +757,8 @@ void print_passed (input_params& ip, ofstream* file_passed, rates& rs) {
 		set_num: the index of the parameter set whose concentration levels are being printed
 	returns: nothing
 	notes:
-		The first line of the file is the total width then a space then the height of the simulation.
-		Each line after starts with the time step then a space then space-separated concentration levels for every cell ordered by their position relative to the active start of the PSM.
-		If binary mode is set, the file will get the extension .bcons and print raw binary values, not ASCII text.
-		The concentration printed is mutant dependent, but usually mh1.
+		The concentrations are copied to a cons_block and handed to the output writer if there is one, so the simulation can go on while they are formatted and written (see write_concentrations). Otherwise they are written before returning.
+		The concentration printed is mutant dependent, but usually mh1. Chunked files can print the levels given with -n instead.
 	todo:
 */
 void print_concentrations (input_params& ip, sim_data& sd, con_levels& cl, mutant_data& md, char* filename_cons, int set_num) {
@@ -285,63 +767,338 @@ void print_concentrations (input_params& ip, sim_data& sd, con_levels& cl, mutan
 		char* str_set_num = (char*)mallocate(sizeof(char) * (strlen_set_num + 1));
 		sprintf(str_set_num, "%d", set_num);
 		char* extension;
-		if (ip.binary_cons_output) { // Binary files get the extension .bcons
+		if (ip.chunk_steps > 0) { // Chunked files get the extension .ccons
+			extension = copy_str(".ccons");
+		} else if (ip.binary_cons_output) { // Binary files get the extension .bcons
 			extension = copy_str(".bcons");
 		} else { // ASCII files (the default option) get the extension specified by the user
 			extension = copy_str(".cons");
 		}
 		char* filename_set = (char*)mallocate(sizeof(char) * (strlen(filename_cons) + strlen("set_") + strlen_set_num + strlen(extension) + 1));
 		sprintf(filename_set, "%sset_%s%s", filename_cons, str_set_num, extension);
-		
-		cout << "    "; // Offset the open_file message to preserve horizontal spacing
-		ofstream file_cons;
-		open_file(&file_cons, filename_set, sd.section == SEC_ANT);
-		mfree(filename_set);
 		mfree(str_set_num);
 		mfree(extension);
 		
-		// If the file was just created then prepend the concentration levels with the simulation size
-		if (sd.section == SEC_POST) {
-			if (ip.binary_cons_output) {
-				file_cons.write((char*)(&sd.width_total), sizeof(int));
-				file_cons.write((char*)(&sd.height), sizeof(int));
-			} else {
-				file_cons << sd.width_total << " " << sd.height << "\n";
-			}
-		}
-		
 		// Calculate which time steps to print
 		int step_offset = (sd.section == SEC_ANT) * ((sd.steps_til_growth - sd.time_start) / sd.big_gran + 1); // If the file is being appended to then offset the time steps
 		int start = sd.time_start / sd.big_gran;
 		int end = sd.time_end / sd.big_gran;
 		
-		// Print the concentration levels of every cell at every time step
-		if (ip.binary_cons_output) {
-			for (int j = start; j < end; j++) {
-				int time_step = (j + step_offset) * sd.big_gran;
-				file_cons.write((char*)(&time_step), sizeof(int));
+		// Copy the levels to print of every cell at every time step
+		cons_block* block = new cons_block(filename_set, sd.section, sd.width_total, sd.height, sd.big_gran, start + step_offset, MAX(end - start, 0));
+		if (ip.chunk_steps > 0 && ip.num_cons_levels > 0) {
+			block->num_levels = ip.num_cons_levels;
+			memcpy(block->levels, ip.cons_levels, sizeof(int) * ip.num_cons_levels);
+		} else {
+			block->num_levels = 1;
+			block->levels[0] = md.print_con;
+		}
+		int cells = sd.width_total * sd.height;
+		bool as_floats = ip.chunk_steps > 0 || ip.binary_cons_output; // Only copy what is printed
+		if (as_floats) {
+			block->floats = new float[block->num_levels * block->num_steps * cells];
+		} else {
+			block->cons = new double[block->num_levels * block->num_steps * cells];
+		}
+		for (int l = 0; l < block->num_levels; l++) {
+			for (int t = 0; t < block->num_steps; t++) {
+				int j = start + t;
+				int row = (l * block->num_steps + t) * cells;
 				for (int i = 0; i < sd.height; i++) {
 					int num_printed = 0;
 					for (int k = cl.active_start_record[j]; num_printed < sd.width_total; k = WRAP(k - 1, sd.width_total), num_printed++) {
-						float con = cl.cons[md.print_con][j][i * sd.width_total + k];	
-						file_cons.write((char*)(&con), sizeof(float));
+						double con = cl.cons[block->levels[l]][j][i * sd.width_total + k];
+						if (as_floats) {
+							block->floats[row + i * sd.width_total + num_printed] = con;
+						} else {
+							block->cons[row + i * sd.width_total + num_printed] = con;
+						}
 					}
 				}
 			}
+		}
+		
+		if (ip.writer != NULL) {
+			push_output(*(ip.writer), NULL, block);
 		} else {
-			for (int j = start; j < end; j++) {
-				int time_step = (j + step_offset) * sd.big_gran;
-				file_cons << time_step << " ";
-				for (int i = 0; i < sd.height; i++) {
-					int num_printed = 0;
-					for (int k = cl.active_start_record[j]; num_printed < sd.width_total; k = WRAP(k - 1, sd.width_total), num_printed++) {
-						file_cons << cl.cons[md.print_con][j][i * sd.width_total + k] << " ";
-					}
+			write_concentrations(ip, *block);
+			delete block;
+		}
+	}
+}
+
+/* write_concentrations writes the given copy of a mutant's concentrations to its file
+	parameters:
+		ip: the program's input parameters
+		block: the concentrations to write
+	returns: nothing
+	notes:
+		The first line of the file is the total width then a space then the height of the simulation.
+		Each line after starts with the time step then a space then space-separated concentration levels for every cell ordered by their position relative to the active start of the PSM.
+		If binary mode is set, the file will get the extension .bcons and print raw binary values, not ASCII text.
+		If chunked mode is set, the file will get the extension .ccons and be printed by print_chunked_concentrations instead.
+		The anterior section's block is appended to the file the posterior section's block created, so the posterior block must be written first.
+	todo:
+*/
+void write_concentrations (input_params& ip, cons_block& block) {
+	if (ip.chunk_steps > 0) {
+		print_chunked_concentrations(ip, block);
+		return;
+	}
+	
+	cout << "    "; // Offset the open_file message to preserve horizontal spacing
+	ofstream file_cons;
+	open_file(&file_cons, block.filename, block.section == SEC_ANT);
+	
+	// If the file was just created then prepend the concentration levels with the simulation size
+	if (block.section == SEC_POST) {
+		if (ip.binary_cons_output) {
+			file_cons.write((char*)(&block.width), sizeof(int));
+			file_cons.write((char*)(&block.height), sizeof(int));
+		} else {
+			file_cons << block.width << " " << block.height << "\n";
+		}
+	}
+	
+	// Print the concentration levels of every cell at every time step
+	int cells = block.width * block.height;
+	if (ip.binary_cons_output) {
+		for (int t = 0; t < block.num_steps; t++) {
+			int time_step = (block.first_step + t) * block.big_gran;
+			file_cons.write((char*)(&time_step), sizeof(int));
+			file_cons.write((char*)(block.floats + t * cells), sizeof(float) * cells);
+		}
+	} else {
+		for (int t = 0; t < block.num_steps; t++) {
+			int time_step = (block.first_step + t) * block.big_gran;
+			file_cons << time_step << " ";
+			double* row = block.cons + t * cells;
+			for (int c = 0; c < cells; c++) {
+				file_cons << row[c] << " ";
+			}
+			file_cons << "\n";
+		}
+	}
+}
+
+/* print_chunked_concentrations writes the given copy of a mutant's concentrations to a chunked concentrations file
+	parameters:
+		ip: the program's input parameters
+		block: the concentrations to write
+	returns: nothing
+	notes:
+		See ccons_header for the file's layout.
+		Compiling with CHECK_CCONS defined decodes every column right after it is written and exits with an error if it does not give back the concentrations (see check_ccons_column in debug.cpp).
+		The posterior section creates the file. The anterior section writes its chunks over the posterior section's index and then writes the index of every chunk after them, so readers never see a file without an index.
+	todo:
+*/
+void print_chunked_concentrations (input_params& ip, cons_block& block) {
+	char* filename = block.filename;
+	cout << "    "; // Offset the opening message to preserve horizontal spacing
+	fstream file_cons;
+	ccons_header header;
+	ccons_chunk* old_index = NULL;
+	if (block.section == SEC_POST) { // Start a new file
+		cout << term->blue << "Creating " << term->reset << filename << " . . . ";
+		file_cons.open(filename, fstream::out | fstream::trunc | fstream::binary);
+		memset(&header, 0, sizeof(ccons_header));
+		header.version = CCONS_VERSION;
+		header.width = block.width;
+		header.height = block.height;
+		header.big_gran = block.big_gran;
+		header.chunk_steps = ip.chunk_steps;
+		header.compressed = ip.compress_cons;
+		header.num_levels = block.num_levels;
+		for (int l = 0; l < block.num_levels; l++) {
+			header.levels[l] = block.levels[l];
+		}
+		header.index_offset = sizeof(ccons_header);
+	} else { // Continue the posterior section's file, keeping its index
+		cout << term->blue << "Opening " << term->reset << filename << " . . . ";
+		file_cons.open(filename, fstream::in | fstream::out | fstream::binary);
+		file_cons.read((char*)(&header), sizeof(ccons_header));
+		if (!file_cons.fail() && header.magic == CCONS_MAGIC) {
+			old_index = new ccons_chunk[header.num_chunks + 1];
+			file_cons.seekg(header.index_offset);
+			file_cons.read((char*)old_index, sizeof(ccons_chunk) * header.num_chunks);
+		}
+		if (file_cons.fail() || header.magic != CCONS_MAGIC) {
+			cout << term->red << "Couldn't read the chunks of " << filename << "!" << term->reset << endl;
+			quit(EXIT_FILE_READ_ERROR);
+		}
+	}
+	if (file_cons.fail()) {
+		cout << term->red << "Couldn't write to " << filename << "!" << term->reset << endl;
+		quit(EXIT_FILE_WRITE_ERROR);
+	}
+	term->done();
+	
+	// Combine the previous sections' chunks with this section's
+	int num_chunks = header.num_chunks + (block.num_steps + header.chunk_steps - 1) / header.chunk_steps;
+	ccons_chunk* index = new ccons_chunk[num_chunks];
+	if (old_index != NULL) {
+		memcpy(index, old_index, sizeof(ccons_chunk) * header.num_chunks);
+		delete[] old_index;
+	}
+	
+	// Print every chunk's columns, reusing the buffers for each column
+	int cells = block.width * block.height;
+	int column_size = sizeof(uint32_t) * header.chunk_steps * cells;
+	uint32_t* column = new uint32_t[header.chunk_steps * cells];
+	unsigned char* planes = new unsigned char[column_size];
+	unsigned char* compressed = new unsigned char[LZ_BOUND(column_size)];
+	uint64_t offset = header.index_offset;
+	file_cons.seekp(offset);
+	for (int c = header.num_chunks, t = 0; c < num_chunks; c++, t += header.chunk_steps) {
+		ccons_chunk& chunk = index[c];
+		chunk.offset = offset;
+		chunk.first_step = (block.first_step + t) * block.big_gran;
+		chunk.num_steps = MIN(header.chunk_steps, block.num_steps - t);
+		memset(chunk.sizes, 0, sizeof(chunk.sizes));
+		for (int l = 0; l < header.num_levels; l++) {
+			// Gather the level's column as the floats' bits
+			memcpy(column, block.floats + (l * block.num_steps + t) * cells, sizeof(float) * chunk.num_steps * cells);
+			
+			// Print the column raw or compressed, whichever is smaller
+			int size = sizeof(uint32_t) * chunk.num_steps * cells;
+			char* data = (char*)column;
+			if (header.compressed) {
+				int compressed_size = compress_column(column, chunk.num_steps, cells, planes, compressed);
+				if (compressed_size < size) {
+					size = compressed_size;
+					data = (char*)compressed;
 				}
-				file_cons << "\n";
 			}
+			#if defined(CHECK_CCONS)
+				if (!check_ccons_column((unsigned char*)data, size, column, chunk.num_steps, cells)) {
+					cout << term->red << "Column " << l << " of chunk " << c << " of " << filename << " does not decode to the concentrations it was written from!" << term->reset << endl;
+					quit(EXIT_FILE_WRITE_ERROR);
+				}
+			#endif
+			file_cons.write(data, size);
+			chunk.sizes[l] = size;
+			offset += size;
+		}
+	}
+	delete[] column;
+	delete[] planes;
+	delete[] compressed;
+	
+	// Print the index after the chunks and then mark the file complete by filling in the header
+	file_cons.write((char*)index, sizeof(ccons_chunk) * num_chunks);
+	header.magic = CCONS_MAGIC;
+	header.num_chunks = num_chunks;
+	header.index_offset = offset;
+	file_cons.seekp(0);
+	file_cons.write((char*)(&header), sizeof(ccons_header));
+	delete[] index;
+	if (file_cons.fail()) {
+		cout << term->red << "Couldn't write to " << filename << "!" << term->reset << endl;
+		quit(EXIT_FILE_WRITE_ERROR);
+	}
+}
+
+/* compress_column delta encodes and compresses a column of a chunked concentrations file
+	parameters:
+		column: the column's values as bits, indexed by [time steps][cells] (left untouched, so it can still be printed raw)
+		num_steps: the number of time steps in the column
+		cells: the number of cells in each time step
+		planes: the buffer to split the deltas into planes of bytes in (4 * num_steps * cells bytes long)
+		compressed: the buffer to compress the planes into (LZ_BOUND(4 * num_steps * cells) bytes long)
+	returns: the size in bytes of the compressed column
+	notes:
+		Neighboring cells and time steps have close concentrations, so the deltas' high bytes are mostly the same and their planes compress well.
+		The deltas only ever exist in planes.
+	todo:
+*/
+int compress_column (const uint32_t* column, int num_steps, int cells, unsigned char* planes, unsigned char* compressed) {
+	int num_values = num_steps * cells;
+	for (int i = 0; i < num_values; i++) {
+		uint32_t delta = i < cells ? column[i] : column[i] - column[i - cells];
+		for (int b = 0; b < (int)sizeof(uint32_t); b++) {
+			planes[b * num_values + i] = (delta >> (8 * b)) & 0xff;
+		}
+	}
+	return compress_block(planes, sizeof(uint32_t) * num_values, compressed);
+}
+
+/* compress_block compresses the given bytes in the LZ4 block format
+	parameters:
+		src: the bytes to compress
+		size: the number of bytes to compress
+		dst: the buffer to compress into (LZ_BOUND(size) bytes long)
+	returns: the size in bytes of the compressed block
+	notes:
+		The block is a series of sequences, each a token byte (the number of literals in the high four bits and the match length minus LZ_MIN_MATCH in the low four, where 15 means more follows as bytes added until one is below 255), the literals, and the match's offset back as two little endian bytes. The last sequence has only literals.
+		Any LZ4 decoder can decompress the block given its original size. Matches are found greedily with a table of the latest position of each hash of four bytes, which is fast rather than thorough.
+	todo:
+*/
+int compress_block (const unsigned char* src, int size, unsigned char* dst) {
+	int table[1 << LZ_HASH_BITS];
+	for (int i = 0; i < (1 << LZ_HASH_BITS); i++) {
+		table[i] = -1;
+	}
+	unsigned char* out = dst;
+	int anchor = 0; // The start of the literals not yet written
+	for (int pos = 0; pos + LZ_MATCH_LIMIT <= size;) {
+		uint32_t sequence;
+		memcpy(&sequence, src + pos, sizeof(uint32_t));
+		int hash = (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+		int match = table[hash];
+		table[hash] = pos;
+		if (match < 0 || pos - match > LZ_MAX_OFFSET || memcmp(src + match, src + pos, LZ_MIN_MATCH) != 0) {
+			pos++;
+			continue;
+		}
+		
+		// Extend the match as far as the block allows and write its sequence
+		int length = LZ_MIN_MATCH;
+		while (pos + length < size - LZ_LAST_LITERALS && src[match + length] == src[pos + length]) {
+			length++;
+		}
+		out = write_lz_sequence(out, src + anchor, pos - anchor, pos - match, length);
+		pos += length;
+		anchor = pos;
+	}
+	out = write_lz_sequence(out, src + anchor, size - anchor, 0, 0);
+	return out - dst;
+}
+
+/* write_lz_sequence writes a sequence of literals and a match in the LZ4 block format (see compress_block)
+	parameters:
+		out: where to write the sequence
+		literals: the literals
+		num_literals: the number of literals
+		offset: how far back the match is
+		length: the length of the match, 0 if the sequence is the last and has no match
+	returns: where the sequence ends
+	notes:
+	todo:
+*/
+unsigned char* write_lz_sequence (unsigned char* out, const unsigned char* literals, int num_literals, int offset, int length) {
+	int extra_length = MAX(length - LZ_MIN_MATCH, 0);
+	*out++ = (MIN(num_literals, 15) << 4) | MIN(extra_length, 15);
+	if (num_literals >= 15) {
+		int rest = num_literals - 15;
+		for (; rest >= 255; rest -= 255) {
+			*out++ = 255;
+		}
+		*out++ = rest;
+	}
+	memcpy(out, literals, num_literals);
+	out += num_literals;
+	if (length > 0) {
+		*out++ = offset & 0xff;
+		*out++ = offset >> 8;
+		if (extra_length >= 15) {
+			int rest = extra_length - 15;
+			for (; rest >= 255; rest -= 255) {
+				*out++ = 255;
+			}
+			*out++ = rest;
 		}
 	}
+	return out;
 }
 
 /* print_cell columns prints the concentrations of a number of columns of cells given by the user to an output file for plotting from the cells birth
@@ -452,7 +1209,7 @@ void print_cell_columns (input_params& ip, sim_data& sd, con_levels &cl, char* f
 /* print_osc_features prints the oscillation features for every mutant of the given run
 	parameters:
 		ip: the program's input parameters
-		file_features: a pointer to the output file stream to open the file with
+		file_features: a pointer to the output stream to print to (the features file or a buffer for it)
 		mds: an array of the mutant_data structs for every mutant
 		set_num: the index of the parameter set whose features are being printed
 		num_passed: the number of mutants that passed the parameter set
@@ -463,7 +1220,7 @@ void print_cell_columns (input_params& ip, sim_data& sd, con_levels &cl, char* f
 	todo:
 		TODO Print anterior scores.
 */
-void print_osc_features (input_params& ip, ofstream* file_features, mutant_data mds[], int set_num, int num_passed) {
+void print_osc_features (input_params& ip, ostream* file_features, mutant_data mds[], int set_num, int num_passed) {
 	if (ip.print_features) { // Print the features only if the user specified it
 		file_features->precision(30);
 		try {
@@ -473,13 +1230,13 @@ void print_osc_features (input_params& ip, ofstream* file_features, mutant_data
 				*file_features << mds[i].feat.sync_score_ant[IMH1] << "," << mds[i].feat.period_ant[IMH1] << "," << mds[i].feat.amplitude_ant[IMH1] << "," << (mds[i].feat.period_ant[IMH1]) / (mds[MUTANT_WILDTYPE].feat.period_ant[IMH1]) << "," << (mds[i].feat.amplitude_ant[IMH1]) / (mds[MUTANT_WILDTYPE].feat.amplitude_ant[IMH1]) << ",";
 			}
 			if (num_passed == ip.num_active_mutants) {
-				*file_features << "PASSED" << endl;
+				*file_features << "PASSED" << "\n";
 			} else {
-				*file_features << "FAILED" << endl;
+				*file_features << "FAILED" << "\n";
 			}	
 		} catch (ofstream::failure) {
 			cout << term->red << "Couldn't write to " << ip.features_file << "!" << term->reset << endl;
-			exit(EXIT_FILE_WRITE_ERROR);
+			quit(EXIT_FILE_WRITE_ERROR);
 		}
 	}
 }
@@ -487,7 +1244,7 @@ void print_osc_features (input_params& ip, ofstream* file_features, mutant_data
 /* print_conditions prints which conditions each mutant of the given run passed
 	parameters:
 		ip: the program's input parameters
-		file_conditions: a pointer to the output file stream to open the file with
+		file_conditions: a pointer to the output stream to print to (the conditions file or a buffer for it)
 		mds: an array of the mutant data structs for every mutant
 		set_num: the index of the parameter set whose conditions are being printed
 	returns: nothing
@@ -495,7 +1252,7 @@ void print_osc_features (input_params& ip, ofstream* file_features, mutant_data
 		This function prints -1, 0, or 1 for each condition for each mutant, each condition separated by a comma, one set per line.
 	todo:
 */
-void print_conditions (input_params& ip, ofstream* file_conditions, mutant_data mds[], int set_num) {
+void print_conditions (input_params& ip, ostream* file_conditions, mutant_data mds[], int set_num) {
 	if (ip.print_conditions) { // Print the conditions only if the user specified it
 		try {
 			*file_conditions << set_num << ",";
@@ -511,10 +1268,10 @@ void print_conditions (input_params& ip, ofstream* file_conditions, mutant_data
 					}
 				}
 			}
-			*file_conditions << endl;
+			*file_conditions << "\n";
 		} catch (ofstream::failure) {
 			cout << term->red << "Couldn't write to " << ip.conditions_file << "!" << term->reset << endl;
-			exit(EXIT_FILE_WRITE_ERROR);
+			quit(EXIT_FILE_WRITE_ERROR);
 		}
 	}
 }
@@ -522,7 +1279,7 @@ void print_conditions (input_params& ip, ofstream* file_conditions, mutant_data
 /* print_scores prints the scores of each mutant run for the given set
 	parameters:
 		ip: the program's input parameters
-		file_scores: a pointer to the output file stream to open the file with
+		file_scores: a pointer to the output stream to print to (the scores file or a buffer for it)
 		set_num: the index of the parameter set whose conditions are being printed
 		scores: the array of scores to print
 		total_score: the sum of all the scores
@@ -531,18 +1288,130 @@ void print_conditions (input_params& ip, ofstream* file_conditions, mutant_data
 		This function prints the set index then score for each mutant then the total score, all separated by commas, one set per line.
 	todo:
 */
-void print_scores (input_params& ip, ofstream* file_scores, int set_num, double scores[], double total_score) {
+void print_scores (input_params& ip, ostream* file_scores, int set_num, double scores[], double total_score) {
 	if (ip.print_scores) {
 		try {
 			*file_scores << set_num << ",";
 			for (int i = 0; i < NUM_SECTIONS * ip.num_active_mutants; i++) {
 				*file_scores << scores[i] << ",";
 			}
-			*file_scores << total_score << endl;
+			*file_scores << total_score << "\n";
 		} catch (ofstream::failure) {
 			cout << term->red << "Couldn't write to " << ip.scores_file << "!" << term->reset << endl;
-			exit(EXIT_FILE_WRITE_ERROR);
+			quit(EXIT_FILE_WRITE_ERROR);
+		}
+	}
+}
+
+/* print_profile prints the time spent in each phase of the simulations to the profile file
+	parameters:
+		ip: the program's input parameters
+		sd: the simulation data created in main, whose profile every worker's has been added to (see delete_contexts)
+		mds: the array of all mutant data
+	returns: nothing
+	notes:
+		This function prints one line per phase, section, and mutant that was timed at least once, giving the number of times the phase was timed, its total seconds, and its mean microseconds, all separated by commas. The first line after the header gives the seconds the whole run took.
+		The seconds of phases timed by several workers add up, so they can total more than the run took.
+	todo:
+*/
+void print_profile (input_params& ip, sim_data& sd, mutant_data mds[]) {
+	if (!ip.print_profile || sd.prof == NULL) {
+		return;
+	}
+	profile& prof = *(sd.prof);
+	double seconds = prof.clock.elapsed();
+	double ticks_per_second = prof.clock.ticks_per_second();
+	
+	ofstream file_profile;
+	open_file(&file_profile, ip.profile_file, false);
+	try {
+		file_profile << "phase,section,mutant,calls,seconds,mean microseconds\n";
+		file_profile << "run,none,none,1," << seconds << "," << seconds * 1e6 << "\n";
+		for (int i = 0; i < NUM_PHASES; i++) {
+			for (int j = 0; j <= NUM_SECTIONS; j++) {
+				for (int k = 0; k <= NUM_MUTANTS; k++) {
+					uint64_t calls = prof.calls[i][j][k];
+					if (calls == 0) {
+						continue;
+					}
+					double phase_seconds = prof.ticks[i][j][k] / ticks_per_second;
+					file_profile << phase_names[i] << "," << section_names[j] << "," << (k < sd.num_active_mutants ? mds[k].print_name : "none") << "," << calls << "," << phase_seconds << "," << phase_seconds * 1e6 / calls << "\n";
+				}
+			}
+		}
+		file_profile.close();
+	} catch (const ofstream::failure&) {
+		cout << term->red << "Couldn't write to " << ip.profile_file << "!" << term->reset << endl;
+		quit(EXIT_FILE_WRITE_ERROR);
+	}
+}
+
+/* print_trace prints every worker's timeline to the trace file in Chrome's Trace Event JSON format
+	parameters:
+		ip: the program's input parameters
+		mds: the array of all mutant data
+	returns: nothing
+	notes:
+		Each span is printed as a complete event on its worker's thread, so chrome://tracing and Perfetto show one lane per worker with each set's sections, mutants, and phases nested within it. Times are in microseconds from when the trace was created.
+		A worker that recorded more than TRACE_EVENTS spans only has its latest ones, and the number it lost is given in the trace's metadata.
+	todo:
+*/
+void print_trace (input_params& ip, mutant_data mds[]) {
+	static const char* kind_names[TRACE_PHASE] = {"set", "ensemble", "section", "mutant"};
+	if (!ip.print_trace || ip.tracer == NULL) {
+		return;
+	}
+	trace_recorder& tracer = *(ip.tracer);
+	double ticks_per_us = tracer.clock.ticks_per_second() / 1e6;
+	
+	ofstream file_trace;
+	open_file(&file_trace, ip.trace_file, false);
+	try {
+		file_trace << fixed << setprecision(3); // Microseconds to the nanosecond
+		file_trace << "{\"traceEvents\":[\n";
+		file_trace << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"segmentation clock\"}}";
+		uint64_t dropped = 0;
+		for (int i = 0; i < tracer.num_buffers; i++) {
+			trace_buffer& buffer = tracer.buffers[i];
+			file_trace << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":\"worker " << i << "\"}}";
+			
+			// Print the spans still in the ring, oldest first
+			uint64_t first = (buffer.count > TRACE_EVENTS) ? buffer.count - TRACE_EVENTS : 0;
+			dropped += first;
+			for (uint64_t j = first; j < buffer.count; j++) {
+				trace_event& event = buffer.events[j & (TRACE_EVENTS - 1)];
+				file_trace << ",\n{\"name\":\"";
+				if (event.kind >= TRACE_PHASE) {
+					file_trace << phase_names[event.kind - TRACE_PHASE] << "\",\"cat\":\"phase";
+				} else if (event.kind == TRACE_SET) {
+					file_trace << "set " << event.set << "\",\"cat\":\"set";
+				} else if (event.kind == TRACE_ENSEMBLE) {
+					file_trace << "ensemble from set " << event.set << "\",\"cat\":\"set";
+				} else if (event.kind == TRACE_SECTION) {
+					file_trace << section_names[event.section] << "\",\"cat\":\"section";
+				} else {
+					file_trace << mds[event.mutant].print_name << "\",\"cat\":\"mutant";
+				}
+				file_trace << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << i;
+				file_trace << ",\"ts\":" << (event.start - tracer.clock.start_ticks) / ticks_per_us << ",\"dur\":" << (event.end - event.start) / ticks_per_us;
+				if (event.kind < TRACE_PHASE) {
+					file_trace << ",\"args\":{\"kind\":\"" << kind_names[event.kind] << "\",\"set\":" << event.set;
+					if (event.section != -1) {
+						file_trace << ",\"section\":\"" << section_names[event.section] << "\"";
+					}
+					if (event.mutant != -1) {
+						file_trace << ",\"mutant\":\"" << mds[event.mutant].print_name << "\"";
+					}
+					file_trace << "}";
+				}
+				file_trace << "}";
+			}
 		}
+		file_trace << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+		file_trace.close();
+	} catch (const ofstream::failure&) {
+		cout << term->red << "Couldn't write to " << ip.trace_file << "!" << term->reset << endl;
+		quit(EXIT_FILE_WRITE_ERROR);
 	}
 }
 
@@ -559,33 +1428,262 @@ void close_if_open (ofstream* file) {
 	}
 }
 
+/* start_output_writer starts the background thread that writes the result files and concentrations while the workers simulate
+	parameters:
+		ip: the program's input parameters (ip.writer is set to the new writer)
+		file_passed: a pointer to the output file stream of the passed file
+		file_scores: a pointer to the output file stream of the scores file
+		file_features: a pointer to the output file stream of the features file
+		file_conditions: a pointer to the output file stream of the conditions file
+	returns: nothing
+	notes:
+		No writer is started if nothing is printed to files.
+	todo:
+*/
+void start_output_writer (input_params& ip, ofstream* file_passed, ofstream* file_scores, ofstream* file_features, ofstream* file_conditions) {
+	if (ip.print_passed || ip.print_scores || ip.print_features || ip.print_conditions || ip.print_cons) {
+		output_writer* writer = new output_writer(&ip, file_passed, file_scores, file_features, file_conditions);
+		if (pthread_create(&(writer->thread), NULL, write_output, writer) != 0) {
+			delete writer;
+			cout << term->red << "Couldn't create the output writer thread!" << term->reset << endl;
+			quit(EXIT_MEMORY_ERROR);
+		}
+		ip.writer = writer;
+		running_writer = writer;
+	}
+}
+
+/* stop_output_writer waits for the output writer to write every record handed to it and then stops it
+	parameters:
+		ip: the program's input parameters (ip.writer is set to NULL)
+	returns: nothing
+	notes:
+		Every output file is flushed before the writer stops.
+	todo:
+*/
+void stop_output_writer (input_params& ip) {
+	if (ip.writer != NULL) {
+		push_output(*(ip.writer), NULL, NULL);
+		pthread_join(ip.writer->thread, NULL);
+		running_writer = NULL;
+		delete ip.writer;
+		ip.writer = NULL;
+	}
+}
+
+/* finish_output_writer writes every record handed to the output writer and flushes the output files before the program exits early
+	parameters:
+	returns: nothing
+	notes:
+		quit calls this before exiting so an error partway through a run does not lose the records still queued or the files' unflushed buffers. Records pushed after this is called are not written.
+		If the writer's own thread is exiting (e.g. it could not write a file), nothing else will pop the queue, so only the files are flushed.
+		The writer is left running and allocated since the program is about to exit.
+	todo:
+*/
+void finish_output_writer () {
+	output_writer* writer = __atomic_exchange_n(&running_writer, (output_writer*)NULL, __ATOMIC_ACQ_REL); // Only the first thread to exit finishes the writer
+	if (writer == NULL) {
+		return;
+	}
+	if (pthread_equal(pthread_self(), writer->thread)) {
+		flush_output(*writer);
+	} else {
+		push_output(*writer, NULL, NULL);
+		pthread_join(writer->thread, NULL);
+	}
+}
+
+/* push_output hands a record to the output writer
+	parameters:
+		writer: the output writer
+		results: a set's results to write to the result files (freed by the writer), NULL if not a results record
+		block: concentrations to write (freed by the writer), NULL if not a concentrations record
+	returns: nothing
+	notes:
+		A record with neither results nor concentrations tells the writer to stop once every earlier record is written.
+		This function only waits if the queue is full, or if a block of concentrations would take the bytes of concentrations waiting past OUTPUT_QUEUE_BYTES.
+	todo:
+*/
+void push_output (output_writer& writer, set_results* results, cons_block* block) {
+	int spins = 0;
+	if (block != NULL) { // Reserve the block's bytes, letting it in regardless of its size if no other block is waiting
+		uint64_t size = block->size();
+		uint64_t waiting = __atomic_load_n(&(writer.block_bytes), __ATOMIC_RELAXED);
+		while (true) {
+			if (waiting == 0 || waiting + size <= OUTPUT_QUEUE_BYTES) {
+				if (__atomic_compare_exchange_n(&(writer.block_bytes), &waiting, waiting + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					break;
+				}
+			} else {
+				if (++spins >= OUTPUT_SPINS) {
+					sched_yield();
+					spins = 0;
+				}
+				waiting = __atomic_load_n(&(writer.block_bytes), __ATOMIC_RELAXED);
+			}
+		}
+		spins = 0;
+	}
+	
+	uint64_t position = __atomic_load_n(&(writer.head), __ATOMIC_RELAXED);
+	output_slot* slot;
+	while (true) {
+		slot = &(writer.slots[RING(position, OUTPUT_QUEUE_SIZE - 1)]);
+		int64_t state = (int64_t)(__atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE) - position);
+		if (state == 0) { // The slot is free, so try to claim its position
+			if (__atomic_compare_exchange_n(&(writer.head), &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (state < 0) { // The queue is full, so wait for the writer to free the slot
+			if (++spins >= OUTPUT_SPINS) {
+				sched_yield();
+				spins = 0;
+			}
+			position = __atomic_load_n(&(writer.head), __ATOMIC_RELAXED);
+		} else { // Another worker claimed the position first
+			position = __atomic_load_n(&(writer.head), __ATOMIC_RELAXED);
+		}
+	}
+	slot->results = results;
+	slot->block = block;
+	__atomic_store_n(&(slot->sequence), position + 1, __ATOMIC_RELEASE);
+	sem_post(&(writer.ready));
+}
+
+/* pop_output takes the next record from the output writer's queue, waiting for one if there are none
+	parameters:
+		writer: the output writer
+		results: set to the record's results
+		block: set to the record's concentrations
+	returns: false if the record tells the writer to stop, true otherwise
+	notes:
+		Before sleeping while there are no records, every output file is flushed, so the files are written in batches while the workers are busy and caught up whenever the writer is idle.
+	todo:
+*/
+bool pop_output (output_writer& writer, set_results*& results, cons_block*& block) {
+	if (sem_trywait(&(writer.ready)) != 0) {
+		flush_output(writer);
+		while (sem_wait(&(writer.ready)) != 0) {} // Retry if interrupted by a signal
+	}
+	output_slot* slot = &(writer.slots[RING(writer.tail, OUTPUT_QUEUE_SIZE - 1)]);
+	while (__atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE) != writer.tail + 1) { // The worker that claimed the slot may still be filling it in
+		sched_yield();
+	}
+	results = slot->results;
+	block = slot->block;
+	__atomic_store_n(&(slot->sequence), writer.tail + OUTPUT_QUEUE_SIZE, __ATOMIC_RELEASE);
+	writer.tail++;
+	return results != NULL || block != NULL;
+}
+
+/* write_output writes every record handed to the output writer until told to stop
+	parameters:
+		arg: a pointer to the output writer
+	returns: NULL
+	notes:
+		This function is the entry point of the writer thread (hence the void pointers).
+		Results arrive in set order since give_results pushes them while holding the queue's lock.
+	todo:
+*/
+void* write_output (void* arg) {
+	output_writer& writer = *((output_writer*)arg);
+	input_params& ip = *(writer.ip);
+	set_results* results;
+	cons_block* block;
+	while (pop_output(writer, results, block)) {
+		if (results != NULL) {
+			if (ip.print_passed) {
+				*(writer.file_passed) << results->passed.str();
+			}
+			if (ip.print_features) {
+				*(writer.file_features) << results->features.str();
+			}
+			if (ip.print_conditions) {
+				*(writer.file_conditions) << results->conditions.str();
+			}
+			if (ip.print_scores) {
+				*(writer.file_scores) << results->scores.str();
+			}
+			delete results;
+		} else {
+			write_concentrations(ip, *block);
+			__atomic_sub_fetch(&(writer.block_bytes), block->size(), __ATOMIC_RELAXED);
+			delete block;
+		}
+	}
+	flush_output(writer);
+	return NULL;
+}
+
+/* flush_output flushes every result file the output writer writes to
+	parameters:
+		writer: the output writer
+	returns: nothing
+	notes:
+	todo:
+*/
+void flush_output (output_writer& writer) {
+	input_params& ip = *(writer.ip);
+	if (ip.print_passed) {
+		writer.file_passed->flush();
+	}
+	if (ip.print_features) {
+		writer.file_features->flush();
+	}
+	if (ip.print_conditions) {
+		writer.file_conditions->flush();
+	}
+	if (ip.print_scores) {
+		writer.file_scores->flush();
+	}
+}
+
 /* read_pipe reads parameter sets from a pipe created by a program interacting with this one
 	parameters:
-		sets: the array of parameter sets in which to store any received sets
+		sets: the array of parameter sets in which to store the sets read from the pipe
 		ip: the program's input parameters
 	returns: nothing
 	notes:
 		The first information piped in must be an integer specifying the number of rates (i.e. parameters) per set that will be piped in. If this number differs from what is expected, the program will exit.
-		The next information piped in must be an integer specifying the number of parameter sets that will be piped in.
-		Each set to be piped in should be sent as a stream of doubles, with each set boundary determined by the previously sent number of rates per set.
-		This function does not create a pipe; it must be created by an external program interfacing with this one.
+		The rest is a batch of sets as read_pipe_batch expects. In daemon mode more batches follow, each answered by write_pipe before the next is read.
+		This function does not create a pipe; it must be created by an external program interfacing with this one. The same goes for the shared memory region used instead of pipes with ip.shm_name (see open_shm).
 	todo:
 */
 void read_pipe (double**& sets, input_params& ip) {
 	// Read how many rates per set will be piped in
 	int num_pars = 0;
-	read_pipe_int(ip.pipe_in, &num_pars);
+	read_pipe_int(ip, &num_pars);
 	if (num_pars != NUM_RATES) {
 		cout << term->red << "An incorrect number of rates will be piped in! This simulation requires " << NUM_RATES << " rates per set but the sampler is sending " << num_pars << " per set." << term->reset << endl;
-		exit(EXIT_INPUT_ERROR);
+		quit(EXIT_INPUT_ERROR);
 	}
 	
+	// Read the first batch of sets
+	if (!read_pipe_batch(sets, ip)) {
+		cout << term->red << "No parameter sets were piped in! The sampler must send at least one set." << term->reset << endl;
+		quit(EXIT_INPUT_ERROR);
+	}
+}
+
+/* read_pipe_batch reads a batch of parameter sets from a pipe created by a program interacting with this one
+	parameters:
+		sets: the array of parameter sets in which to store the sets read from the pipe
+		ip: the program's input parameters
+	returns: true if a batch was read, false if the sampler sent a batch of 0 sets or closed the pipe instead
+	notes:
+		A batch is an integer specifying the number of parameter sets that will be piped in followed by each set as a stream of doubles, with each set boundary determined by the number of rates per set.
+		A batch of 0 sets or a closed pipe ends a daemon's session, leaving sets untouched.
+	todo:
+*/
+bool read_pipe_batch (double**& sets, input_params& ip) {
 	// Read how many sets will be piped in
 	int num_sets = 0;
-	read_pipe_int(ip.pipe_in, &num_sets);
-	if (num_sets <= 0) {
+	if (!read_pipe_bytes(ip, &num_sets, sizeof(int)) || num_sets == 0) {
+		return false;
+	}
+	if (num_sets < 0) {
 		cout << term->red << "An invalid number of parameter sets will be piped in! The number of sets must be a positive integer but the sampler is sending " << num_sets << "." << term->reset << endl;
-		exit(EXIT_INPUT_ERROR);
+		quit(EXIT_INPUT_ERROR);
 	}
 	ip.num_sets = num_sets;
 	
@@ -593,39 +1691,75 @@ void read_pipe (double**& sets, input_params& ip) {
 	sets = new double*[num_sets];
 	for (int i = 0; i < num_sets; i++) {
 		sets[i] = new double[NUM_RATES];
-		read_pipe_set(ip.pipe_in, sets[i]);
+		read_pipe_set(ip, sets[i]);
+	}
+	return true;
+}
+
+/* read_pipe_bytes reads the given number of bytes from the pipe in and stores them in the given address
+	parameters:
+		ip: the program's input parameters
+		address: the address to store the bytes read from the pipe
+		size: the number of bytes to read
+	returns: true if every byte was read, false if the pipe was closed before any byte was
+	notes:
+		A pipe can hand over fewer bytes than asked for at once, so this function keeps reading until every byte arrives.
+		With a shared memory region the bytes are taken from its ring in instead (see read_shm_bytes).
+		This function assumes that ip.pipe_in identifies a valid pipe end and will exit with an error if it does not or if the pipe is closed partway through.
+	todo:
+*/
+bool read_pipe_bytes (input_params& ip, void* address, size_t size) {
+	if (ip.shm != NULL) {
+		return read_shm_bytes(ip, ip.shm->in, ip.shm->in_data(), address, size);
+	}
+	char* bytes = (char*)address;
+	size_t done = 0;
+	while (done < size) {
+		ssize_t got = read(ip.pipe_in, bytes + done, size - done);
+		if (got == -1 && errno == EINTR) {
+			continue;
+		}
+		if (got == 0 && done == 0) {
+			return false;
+		}
+		if (got <= 0) {
+			term->failed_pipe_read();
+			quit(EXIT_PIPE_READ_ERROR);
+		}
+		done += got;
 	}
+	return true;
 }
 
-/* read_pipe_int reads an integer from the given pipe and stores it in the given address
+/* read_pipe_int reads an integer from the pipe in and stores it in the given address
 	parameters:
-		fd: the file descriptor identifying the pipe
+		ip: the program's input parameters
 		address: the address to store the integer read from the pipe
 	returns: nothing
 	notes:
-		This function assumes that fd identifies a valid pipe end and will exit with an error if it does not.
+		This function assumes that ip.pipe_in identifies a valid pipe end and will exit with an error if it does not.
 	todo:
 */
-void read_pipe_int (int fd, int* address) {
-	if (read(fd, address, sizeof(int)) == -1) {
+void read_pipe_int (input_params& ip, int* address) {
+	if (!read_pipe_bytes(ip, address, sizeof(int))) {
 		term->failed_pipe_read();
-		exit(EXIT_PIPE_READ_ERROR);
+		quit(EXIT_PIPE_READ_ERROR);
 	}
 }
 
-/* read_pipe_set reads a parameter set from the given pipe and stores it in the given address
+/* read_pipe_set reads a parameter set from the pipe in and stores it in the given address
 	parameters:
-		fd: the file descriptor identifying the pipe
+		ip: the program's input parameters
 		pars: the array in which to store the set read from the pipe
 	returns: nothing
 	notes:
-		This function assumes that fd identifies a valid pipe end and will exit with an error if it does not.
+		This function assumes that ip.pipe_in identifies a valid pipe end and will exit with an error if it does not.
 	todo:
 */
-void read_pipe_set (int fd, double pars[]) {
-	if (read(fd, pars, sizeof(double) * NUM_RATES) == -1) {
+void read_pipe_set (input_params& ip, double pars[]) {
+	if (!read_pipe_bytes(ip, pars, sizeof(double) * NUM_RATES)) {
 		term->failed_pipe_read();
-		exit(EXIT_PIPE_READ_ERROR);
+		quit(EXIT_PIPE_READ_ERROR);
 	}
 }
 
@@ -636,38 +1770,301 @@ void read_pipe_set (int fd, double pars[]) {
 		sd: the current simulation's data
 	returns: nothing
 	notes:
-		This function assumes that fd points to a valid pipe and will exit with an error if it does not.
+		The reply to every batch is the maximum score followed by the score of each set in the batch, in set order.
+		The pipe is left open (for the next batch in daemon mode) and closed with close_pipe once every batch has been answered.
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
 	todo:
 */
 void write_pipe (double score[], input_params& ip, sim_data& sd) {
 	// Write the maximum possible score an single run can achieve to the pipe
-	write_pipe_double(ip.pipe_out, (sd.no_growth ? sd.max_scores[SEC_POST] : sd.max_score_all));
+	write_pipe_double(ip, (sd.no_growth ? sd.max_scores[SEC_POST] : sd.max_score_all));
 	
 	// Write the scores to the pipe
-	for (int i = 0; i < ip.num_sets; i++) {
-		write_pipe_double(ip.pipe_out, score[i]);
+	write_pipe_bytes(ip, score, sizeof(double) * ip.num_sets);
+}
+
+/* write_pipe_records_header writes what the sampler needs to read a batch's score records to a pipe created by a program interacting with this one
+	parameters:
+		ip: the program's input parameters
+		sd: the current simulation's data
+	returns: nothing
+	notes:
+		With ip.pipe_records the reply to every batch is the maximum score and the number of mutant scores per record, written before any set is simulated, followed by one record per set (see write_pipe_record).
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
+	todo:
+*/
+void write_pipe_records_header (input_params& ip, sim_data& sd) {
+	write_pipe_double(ip, (sd.no_growth ? sd.max_scores[SEC_POST] : sd.max_score_all));
+	write_pipe_int(ip, NUM_SECTIONS * ip.num_active_mutants);
+}
+
+/* write_pipe_record writes a finished set's score record to a pipe created by a program interacting with this one
+	parameters:
+		ip: the program's input parameters
+		set_num: the index of the set within its batch
+		score: the set's cumulative score
+		scores: the score of every mutant in every section, where mutant i of section s is at s * ip.num_active_mutants + i
+	returns: nothing
+	notes:
+		A record is the set's index (an integer), its score, and then NUM_SECTIONS * ip.num_active_mutants mutant scores (doubles). Records arrive in the order sets finish, not in set order.
+		Each record is written at once so records from different workers never interleave. The caller must hold the queue's lock.
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
+	todo:
+*/
+void write_pipe_record (input_params& ip, int set_num, double score, double scores[]) {
+	char record[sizeof(int) + sizeof(double) * (1 + NUM_SECTIONS * NUM_MUTANTS)];
+	int num_scores = NUM_SECTIONS * ip.num_active_mutants;
+	memcpy(record, &set_num, sizeof(int));
+	memcpy(record + sizeof(int), &score, sizeof(double));
+	memcpy(record + sizeof(int) + sizeof(double), scores, sizeof(double) * num_scores);
+	write_pipe_bytes(ip, record, sizeof(int) + sizeof(double) * (1 + num_scores));
+}
+
+/* write_pipe_bytes writes the given number of bytes to the pipe out
+	parameters:
+		ip: the program's input parameters
+		address: the address of the bytes to write
+		size: the number of bytes to write
+	returns: nothing
+	notes:
+		A pipe can take fewer bytes than given at once, so this function keeps writing until every byte is taken.
+		With a shared memory region the bytes are put in its ring out instead (see write_shm_bytes).
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
+	todo:
+*/
+void write_pipe_bytes (input_params& ip, const void* address, size_t size) {
+	if (ip.shm != NULL) {
+		write_shm_bytes(ip, ip.shm->out, ip.shm->out_data(), address, size);
+		return;
 	}
-	
-	// Close the pipe
-	if (close(ip.pipe_out) == -1) {
+	const char* bytes = (const char*)address;
+	size_t done = 0;
+	while (done < size) {
+		ssize_t put = write(ip.pipe_out, bytes + done, size - done);
+		if (put == -1 && errno == EINTR) {
+			continue;
+		}
+		if (put <= 0) {
+			term->failed_pipe_write();
+			quit(EXIT_PIPE_WRITE_ERROR);
+		}
+		done += put;
+	}
+}
+
+/* close_pipe closes the pipe out, telling the program on the other end that no more data will be sent
+	parameters:
+		ip: the program's input parameters
+	returns: nothing
+	notes:
+		With a shared memory region its ring out is marked closed and the region is unmapped instead.
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
+	todo:
+*/
+void close_pipe (input_params& ip) {
+	if (ip.shm != NULL) {
+		close_shm(ip);
+	} else if (close(ip.pipe_out) == -1) {
 		term->failed_pipe_write();
-		exit(EXIT_PIPE_WRITE_ERROR);
+		quit(EXIT_PIPE_WRITE_ERROR);
 	}
 }
 
-/* write_pipe_int writes the given integer to the given pipe
+/* write_pipe_int writes the given integer to the pipe out
 	parameters:
-		fd: the file descriptor identifying the pipe
+		ip: the program's input parameters
 		value: the integer to write to the pipe
 	returns: nothing
 	notes:
-		This function assumes that fd points to a valid pipe and will exit with an error if it does not.
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
 	todo:
 */
-void write_pipe_double (int fd, double value) {
-	if (write(fd, &value, sizeof(double)) == -1) {
-		term->failed_pipe_write();
-		exit(EXIT_PIPE_WRITE_ERROR);
+void write_pipe_int (input_params& ip, int value) {
+	write_pipe_bytes(ip, &value, sizeof(int));
+}
+
+/* write_pipe_double writes the given double to the pipe out
+	parameters:
+		ip: the program's input parameters
+		value: the double to write to the pipe
+	returns: nothing
+	notes:
+		This function assumes that ip.pipe_out points to a valid pipe and will exit with an error if it does not.
+	todo:
+*/
+void write_pipe_double (input_params& ip, double value) {
+	write_pipe_bytes(ip, &value, sizeof(double));
+}
+
+/* open_shm maps the shared memory region named by ip.shm_name so data is exchanged through its rings instead of pipes
+	parameters:
+		ip: the program's input parameters
+	returns: nothing
+	notes:
+		The region must already have been created and its header filled in by the sampler (see shm_region). Its rings carry exactly the bytes the pipes would.
+		This function exits with an error if the region does not exist or its header is not valid.
+	todo:
+*/
+void open_shm (input_params& ip) {
+	int fd = shm_open(ip.shm_name, O_RDWR, 0);
+	struct stat info;
+	if (fd == -1 || fstat(fd, &info) == -1) {
+		cout << term->red << "Couldn't open the shared memory region " << ip.shm_name << "!" << term->reset << endl;
+		quit(EXIT_PIPE_READ_ERROR);
+	}
+	ip.shm_size = info.st_size;
+	void* region = ip.shm_size < SHM_HEADER_SIZE ? MAP_FAILED : mmap(NULL, ip.shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); // The mapping stays valid without the descriptor
+	if (region == MAP_FAILED) {
+		cout << term->red << "Couldn't map the shared memory region " << ip.shm_name << "!" << term->reset << endl;
+		quit(EXIT_PIPE_READ_ERROR);
+	}
+	ip.shm = (shm_region*)region;
+	
+	// Check that the sampler laid the region out as expected
+	shm_region& shm = *(ip.shm);
+	uint64_t in_capacity = shm.in.capacity;
+	uint64_t out_capacity = shm.out.capacity;
+	if (__atomic_load_n(&(shm.magic), __ATOMIC_ACQUIRE) != SHM_MAGIC || shm.version != SHM_VERSION || in_capacity == 0 || out_capacity == 0 || (in_capacity & (in_capacity - 1)) != 0 || (out_capacity & (out_capacity - 1)) != 0 || SHM_HEADER_SIZE + in_capacity + out_capacity > ip.shm_size) {
+		cout << term->red << "The shared memory region " << ip.shm_name << " does not have a valid header! The sampler must fill in both rings' capacities (powers of two that fit in the region) and then the magic number." << term->reset << endl;
+		quit(EXIT_INPUT_ERROR);
+	}
+	ip.shm_parent = getppid();
+}
+
+/* close_shm marks the shared memory region's ring out closed and unmaps the region
+	parameters:
+		ip: the program's input parameters
+	returns: nothing
+	notes:
+		The region itself is left for the sampler to remove.
+	todo:
+*/
+void close_shm (input_params& ip) {
+	__atomic_store_n(&(ip.shm->out.closed), 1, __ATOMIC_RELEASE);
+	munmap(ip.shm, ip.shm_size);
+	ip.shm = NULL;
+}
+
+/* read_shm_bytes reads the given number of bytes from the given shared memory ring and stores them in the given address
+	parameters:
+		ip: the program's input parameters
+		ring: the ring to read from
+		data: the ring's data
+		address: the address to store the bytes read from the ring
+		size: the number of bytes to read
+	returns: true if every byte was read, false if the ring was closed before any byte was
+	notes:
+		This function waits for the producer until every byte arrives, like reading a pipe does, and exits with an error if the ring is closed partway through or the sampler dies before sending them.
+		The bytes are copied out and their space handed back to the producer as they are read, so the ring is a copying transport (see shm_ring).
+	todo:
+*/
+bool read_shm_bytes (input_params& ip, shm_ring& ring, char* data, void* address, size_t size) {
+	char* bytes = (char*)address;
+	uint64_t mask = ring.capacity - 1;
+	uint64_t tail = ring.tail; // Only this side writes the tail
+	size_t done = 0;
+	int spins = 0;
+	while (done < size) {
+		uint64_t head = __atomic_load_n(&(ring.head), __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (__atomic_load_n(&(ring.closed), __ATOMIC_ACQUIRE) && head == __atomic_load_n(&(ring.head), __ATOMIC_ACQUIRE)) {
+				if (done == 0) {
+					return false;
+				}
+				term->failed_pipe_read();
+				quit(EXIT_PIPE_READ_ERROR);
+			}
+			if (!wait_shm(ip, spins) && head == __atomic_load_n(&(ring.head), __ATOMIC_ACQUIRE)) {
+				term->failed_pipe_read();
+				quit(EXIT_PIPE_READ_ERROR);
+			}
+			continue;
+		}
+		
+		// Copy as many of the waiting bytes as needed, in up to two pieces if they wrap around the end of the ring
+		size_t count = MIN(head - tail, size - done);
+		size_t start = RING(tail, mask);
+		size_t first = MIN(count, ring.capacity - start);
+		memcpy(bytes + done, data + start, first);
+		memcpy(bytes + done + first, data, count - first);
+		tail += count;
+		done += count;
+		__atomic_store_n(&(ring.tail), tail, __ATOMIC_RELEASE);
+		spins = 0;
+	}
+	return true;
+}
+
+/* write_shm_bytes writes the given number of bytes to the given shared memory ring
+	parameters:
+		ip: the program's input parameters
+		ring: the ring to write to
+		data: the ring's data
+		address: the address of the bytes to write
+		size: the number of bytes to write
+	returns: nothing
+	notes:
+		This function waits for the consumer to make room until every byte is written, like writing a full pipe does, and exits with an error if the sampler dies before making room.
+		The bytes are copied into the ring, so the caller can reuse its buffer as soon as this returns.
+	todo:
+*/
+void write_shm_bytes (input_params& ip, shm_ring& ring, char* data, const void* address, size_t size) {
+	const char* bytes = (const char*)address;
+	uint64_t mask = ring.capacity - 1;
+	uint64_t head = ring.head; // Only this side writes the head
+	size_t done = 0;
+	int spins = 0;
+	while (done < size) {
+		uint64_t tail = __atomic_load_n(&(ring.tail), __ATOMIC_ACQUIRE);
+		uint64_t room = ring.capacity - (head - tail);
+		if (room == 0) {
+			if (!wait_shm(ip, spins) && tail == __atomic_load_n(&(ring.tail), __ATOMIC_ACQUIRE)) {
+				term->failed_pipe_write();
+				quit(EXIT_PIPE_WRITE_ERROR);
+			}
+			continue;
+		}
+		
+		// Copy as many bytes as fit, in up to two pieces if they wrap around the end of the ring
+		size_t count = MIN(room, size - done);
+		size_t start = RING(head, mask);
+		size_t first = MIN(count, ring.capacity - start);
+		memcpy(data + start, bytes + done, first);
+		memcpy(data, bytes + done + first, count - first);
+		head += count;
+		done += count;
+		__atomic_store_n(&(ring.head), head, __ATOMIC_RELEASE);
+		spins = 0;
 	}
 }
 
+/* wait_shm waits a moment for the other side of a shared memory ring
+	parameters:
+		ip: the program's input parameters
+		spins: the number of times the ring has been checked since it last changed
+	returns: true if the sampler is still running, false if it has died
+	notes:
+		The first SHM_SPINS checks return immediately, so a quick reply costs no system call. After that each check sleeps, starting at SHM_MIN_SLEEP nanoseconds and doubling up to SHM_MAX_SLEEP, so an idle sampler leaves the processor idle too.
+		A sampler that dies cannot close its ring, so every sleeping check also looks for it: the process with the region's sampler_pid if it gave one, otherwise the parent the simulation had when the region was mapped (see shm_region).
+	todo:
+*/
+bool wait_shm (input_params& ip, int& spins) {
+	if (spins <= SHM_SPINS) {
+		spins++;
+		return true;
+	}
+	int doublings = MIN(spins - SHM_SPINS - 1, 10);
+	long sleep_ns = MIN((long)SHM_MIN_SLEEP << doublings, (long)SHM_MAX_SLEEP);
+	if (sleep_ns < SHM_MAX_SLEEP) {
+		spins++;
+	}
+	struct timespec pause = {0, sleep_ns};
+	nanosleep(&pause, NULL);
+	
+	int sampler = ip.shm->sampler_pid;
+	if (sampler != 0) {
+		return kill(sampler, 0) == 0 || errno != ESRCH;
+	}
+	return getppid() == ip.shm_parent;
+}
@@ -31,21 +31,60 @@ bool not_EOL(char);
 void store_filename(char**, const char*);
 void create_dir(char*);
 void open_file(ofstream*, char*, bool);
+bool map_file(input_data*, FILE*);
+void release_map(input_data*, size_t);
 void read_file(input_data*);
-bool parse_param_line(double*, char*, int&);
-void parse_ranges_file (pair <double, double>[], char*);
-void print_passed(input_params&, ofstream*, rates&);
+void open_stream(input_data*);
+bool read_stream(input_data*);
+size_t read_bytes(input_data*, void*, size_t);
+void skip_blanks(const char*, int&);
+bool end_of_content(char);
+void next_line(input_data&);
+bool parse_double(const char*, int&, double&);
+bool parse_int(const char*, int&, int&);
+void parse_error(input_data&, const char*);
+bool parse_param_line(double*, input_data&);
+void read_params_header(params_stream&);
+int read_params_chunk(params_stream&, int);
+void parse_ranges_file (pair <double, double>[], input_data&);
+void print_passed(input_params&, ostream*, rates&);
 void print_concentrations(input_params&, sim_data&, con_levels&, mutant_data&, char*, int);
+void write_concentrations(input_params&, cons_block&);
+void print_chunked_concentrations(input_params&, cons_block&);
+int compress_column(const uint32_t*, int, int, unsigned char*, unsigned char*);
+int compress_block(const unsigned char*, int, unsigned char*);
+unsigned char* write_lz_sequence(unsigned char*, const unsigned char*, int, int, int);
 void print_cell_columns(input_params&, sim_data&, con_levels&, char*, int);
-void print_osc_features(input_params&, ofstream*, mutant_data[], int, int);
-void print_conditions (input_params&, ofstream*, mutant_data[], int);
-void print_scores(input_params&, ofstream*, int, double[], double);
+void print_osc_features(input_params&, ostream*, mutant_data[], int, int);
+void print_conditions (input_params&, ostream*, mutant_data[], int);
+void print_scores(input_params&, ostream*, int, double[], double);
+void print_profile(input_params&, sim_data&, mutant_data[]);
+void print_trace(input_params&, mutant_data[]);
 void close_if_open(ofstream*);
+void start_output_writer(input_params&, ofstream*, ofstream*, ofstream*, ofstream*);
+void stop_output_writer(input_params&);
+void finish_output_writer();
+void push_output(output_writer&, set_results*, cons_block*);
+bool pop_output(output_writer&, set_results*&, cons_block*&);
+void* write_output(void*);
+void flush_output(output_writer&);
 void read_pipe(double**&, input_params&);
-void read_pipe_int(int, int*);
-void read_pipe_set(int, double[]);
+bool read_pipe_batch(double**&, input_params&);
+bool read_pipe_bytes(input_params&, void*, size_t);
+void read_pipe_int(input_params&, int*);
+void read_pipe_set(input_params&, double[]);
 void write_pipe(double[], input_params&, sim_data&);
-void write_pipe_double(int, double);
+void write_pipe_records_header(input_params&, sim_data&);
+void write_pipe_record(input_params&, int, double, double[]);
+void write_pipe_bytes(input_params&, const void*, size_t);
+void close_pipe(input_params&);
+void write_pipe_int(input_params&, int);
+void write_pipe_double(input_params&, double);
+void open_shm(input_params&);
+void close_shm(input_params&);
+bool read_shm_bytes(input_params&, shm_ring&, char*, void*, size_t);
+void write_shm_bytes(input_params&, shm_ring&, char*, const void*, size_t);
+bool wait_shm(input_params&, int&);
 
 #endif
 
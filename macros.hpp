@@ -44,8 +44,7 @@ macros.hpp contains every constant and macro function used in the program.
 
 /// Named shortcuts for each concentration level of mRNA, protein, and dimer
 /// used to look up concentration level of the mRNA, protein and dimer in cl structs
-// The time point at which the cell was born
-#define BIRTH		0
+/// (index 0 used to hold each cell's birth and is not stored, see lineage for births and parents)
 
 // mRNA levels
 #define CMH1		1	//mRNA Her1
@@ -78,13 +77,10 @@ macros.hpp contains every constant and macro function used in the program.
 
 #define CPH13H13  21
 
-// The index of the cell's parent
-#define PARENT		22
-
-#define NUM_CON_LEVELS	23 // How big an array holding concentration levels must be
-#define NUM_CON_STORE	7 // How many concentration levels to store in the bigger struct (for analyzing oscillation features)
-#define MIN_CON_LEVEL	1 // The smallest index of a concetration level not including BIRTH or PARENT
-#define MAX_CON_LEVEL	21 // The largest index of a concentration level not including BIRTH or PARENT
+#define NUM_CON_LEVELS	22 // One more than the largest index of a concentration level
+#define NUM_CON_STORE	7 // One more than the largest index of the concentration levels to store in the bigger struct (for analyzing oscillation features)
+#define MIN_CON_LEVEL	1 // The smallest index of a concetration level
+#define MAX_CON_LEVEL	21 // The largest index of a concentration level
 
 /// Named shortcuts for each rate of mRNA, protein, and dimer
 
@@ -239,9 +235,101 @@ macros.hpp contains every constant and macro function used in the program.
 #define SEC_WAVE		2
 #define NUM_SECTIONS	3
 
+// Random number streams
+#define RNG_PERTURB		0 // Perturbations of each cell's rates
+#define RNG_SPLIT		1 // Parent assignments when cells split
+#define RNG_PARAMS		2 // Parameter sets generated from a ranges file
+
+// Batched step inputs (the delayed and neighbor-averaged values each cell reads, gathered before the batched kernels run)
+#define SI_MRNA			0 // mRNA concentrations at the start of each protein's delay (+ protein index)
+#define SI_H1H1			6 // Her1 homodimer concentrations at the start of each mRNA's delay (+ mRNA index)
+#define SI_H7H13		12 // Her7-Her13 heterodimer concentrations at the start of each mRNA's delay (+ mRNA index)
+#define SI_DELTA		18 // Neighbor-averaged Delta protein concentrations at the start of each mRNA's delay (+ mRNA index, up to NUM_DD_INDICES)
+#define NUM_STEP_INPUTS	22
+
 // Oscillation features
 #define NUM_FEATS	2
 
+// Streamed posterior oscillation features (see feature_stream)
+#define NUM_STREAM_CONS	3 // The number of concentration levels followed (mh1, mh7, and mdelta, like osc_features_post)
+#define STREAM_ROWS		4 // The number of latest rows kept: the row being given and the three the latest peak or trough test reads
+#define STREAM_POINTS	16 // The number of peaks and of troughs each series has room for at first
+
+// Oscillation feature demands (see feature_demand)
+#define FD_PERIOD_ANT			0 // period_ant (also needed for the wild type's Giudicelli test of mh1)
+#define FD_AMPLITUDE_ANT		1 // amplitude_ant
+#define FD_AMPLITUDE_POST		2 // The anterior simulation's share of amplitude_post
+#define FD_SYNC_ANT				3 // sync_score_ant
+#define FD_COMP					4 // comp_score_ant_mespa (for mespa) and comp_score_ant_mespb (for mespb)
+#define FD_PERIOD_TIME			5 // period_post_time and period_ant_time
+#define FD_AMPLITUDE_POST_TIME	6 // amplitude_post_time
+#define FD_AMPLITUDE_ANT_TIME	7 // amplitude_ant_time
+#define FD_SYNC_TIME			8 // sync_time
+#define NUM_FD					9
+
+// Early-fail prediction (see fail_watchdog)
+#define WATCH_PERIOD	30 // The expected period in minutes of the wild type's posterior oscillations (the middle of test_wildtype_ant's range)
+#define WATCH_MIN_RATIO	1.2 // The smallest peak to trough ratio of a clear peak (test_wildtype_post needs 1.5 at the middle and end)
+
+// Shared memory transport (see shm_region)
+#define SHM_MAGIC		0x53434b31 // "SCK1", written by the sampler once the region's header is filled in
+#define SHM_VERSION		1
+#define SHM_LINE		64 // The size in bytes every part of the region's header is padded to
+#define SHM_HEADER_SIZE	(7 * SHM_LINE) // The size in bytes of the region's header: a line for the magic number and version and three for each ring
+#define SHM_SPINS		1024 // The number of times to check a ring before sleeping while waiting for it
+#define SHM_MIN_SLEEP	1000 // The first sleep in nanoseconds once SHM_SPINS checks are spent, doubled on every further check
+#define SHM_MAX_SLEEP	1000000 // The longest sleep in nanoseconds between checks of a ring
+
+// Chunked concentrations output (see ccons_header)
+#define CCONS_MAGIC			0x53434331 // "SCC1"
+#define CCONS_VERSION		1
+#define CCONS_MAX_LEVELS	(NUM_CON_STORE - MIN_CON_LEVEL) // The number of concentration levels that can be printed (every stored level)
+
+// Concentration column compression (see compress_block)
+#define LZ_HASH_BITS		12 // The number of bits in a hash of four bytes, which indexes the table of their latest positions
+#define LZ_MIN_MATCH		4 // The length of the shortest match worth encoding
+#define LZ_MAX_OFFSET		65535 // The furthest back a match can be
+#define LZ_LAST_LITERALS	5 // The number of bytes at the end of a block that must be literals
+#define LZ_MATCH_LIMIT		12 // The number of bytes at the end of a block in which no match can start
+#define LZ_BOUND(x)			((x) + (x) / 255 + 16) // The largest size a block of x bytes can be compressed to
+
+// Streamed parameter sets (see params_stream)
+#define PARAMS_CHUNK		256 // The number of parameter sets parsed at a time from a parameter sets file
+#define PARAMS_BLOCK		(1 << 20) // The number of bytes first read at a time from a parameter sets file (a block grows if a line does not fit in it)
+#define PARAMS_MAGIC		0x53435031 // "SCP1", which starts a binary parameter sets file (see params_header)
+
+// Output writer (see output_writer)
+#define OUTPUT_QUEUE_SIZE	64 // The number of records that can wait to be written before workers must wait for the writer, a power of two
+#define OUTPUT_SPINS		64 // The number of times to check a slot before yielding the processor while waiting for it
+#define OUTPUT_QUEUE_BYTES	(64 << 20) // The number of bytes of concentrations that can wait to be written before workers must wait for the writer
+
+// Profiled phases of a simulation (see profile)
+#define PHASE_MODEL				0 // The time step loop of model or ensemble_model
+#define PHASE_UPDATE_RATES		1 // update_rates and update_rates_split
+#define PHASE_DELAY_INDICES		2 // calculate_delay_indices
+#define PHASE_SPLIT				3 // split
+#define PHASE_FEATURES_POST		4 // osc_features_post
+#define PHASE_FEATURES_ANT		5 // osc_features_ant
+#define PHASE_FEATURES_STREAM	6 // osc_features_stream
+#define PHASE_TESTS				7 // Each mutant's test of its section
+#define PHASE_WAVE_TESTS		8 // wave_testing and wave_testing_her1
+#define PHASE_PRINT_CONS		9 // print_concentrations
+#define PHASE_PRINT_CELLS		10 // print_cell_columns
+#define PHASE_PRINT_PASSED		11 // print_passed
+#define PHASE_PRINT_FEATURES	12 // print_osc_features
+#define PHASE_PRINT_CONDITIONS	13 // print_conditions
+#define PHASE_PRINT_SCORES		14 // print_scores
+#define NUM_PHASES				15
+#define PHASE_TRACED(phase)		((phase) == PHASE_MODEL || (phase) >= PHASE_FEATURES_POST) // Whether or not a phase is recorded in the trace (the others run once per time step or cell)
+
+// Spans of the trace (see trace_event)
+#define TRACE_SET				0 // A parameter set
+#define TRACE_ENSEMBLE			1 // The parameter sets of an ensemble, simulated together
+#define TRACE_SECTION			2 // A section of a parameter set
+#define TRACE_MUTANT			3 // A mutant of a section
+#define TRACE_PHASE				4 // A phase of a mutant (plus one of the PHASE_ macros)
+#define TRACE_EVENTS			(1 << 16) // The number of spans each worker's trace keeps, a power of two
+
 // Condition weights
 #define CW_A	5 // Weight for A class conditions
 #define CW_B	0 // Weight for B class conditions
@@ -262,6 +350,9 @@ macros.hpp contains every constant and macro function used in the program.
 #define NUM_DATA_POINTS 10 // The number of data points required for synchronization plotting
 #define INTERVAL 		60 // The length of the overlapping intervals for synchronization plotting
 
+// Memory layout
+#define CON_ALIGNMENT	64 // The alignment in bytes of every row of cells in a con_levels struct (the width of an AVX-512 vector and a cache line)
+
 // Exit statuses
 #define EXIT_SUCCESS			0
 #define EXIT_MEMORY_ERROR		1
@@ -279,6 +370,7 @@ macros.hpp contains every constant and macro function used in the program.
 #define MAX(x, y) ((x) < (y) ? (y) : (x))
 #define ZERO_IF_NAN(x) (is_nan(x) ? 0 : (x))
 #define WRAP(x, y) ((x) + (y)) % (y)
+#define RING(x, mask) ((x) & (mask)) // Wraps x into a ring buffer whose size is a power of two (mask is the size - 1), also for negative x
 #define INT_STRLEN(x) (log10((x) > 0 ? (x) : 1) + 1)
 
 #endif
@@ -23,13 +23,16 @@ Avoid putting functions in main.cpp that could be put in a more specific file.
 
 #include "main.hpp" // Function declarations
 #include "init.hpp"
+#include "io.hpp"
 #include "sim.hpp"
 #include "debug.hpp"
 
 using namespace std;
 
 extern terminal* term; // Declared in init.cpp
+bool embedded = false; // Whether or not the program is running as a library inside another program (see segclock.cpp)
 
+#if !defined(LIBRARY) // Compiling with LIBRARY defined leaves main out so the rest of the program can be linked into libsegclock (see segclock.hpp)
 /* main is called when the program is run and performs all program functionality
 	parameters:
 		argc: the number of command-line arguments
@@ -62,10 +65,11 @@ int main(int argc, char** argv) {
 	// Initialize simulation data, rates (and their perturbations and gradients), and mutant data
 	sim_data sd(ip);
 	rates* rs = new rates(sd.width_total, sd.cells_total);// rates can be restructured for optimization
-	fill_perturbations(*rs, perturb_data.buffer);
-	fill_gradients(*rs, gradients_data.buffer);
+	fill_perturbations(*rs, perturb_data);
+	fill_gradients(*rs, gradients_data);
 	calc_max_delay_size(ip, sd, *rs, sets);
 	mutant_data* mds = create_mutant_data(sd, ip);
+	declare_feature_demands(ip, sd, mds);
 	sd.initialize_conditions_data(mds);
 	
 	// Create the specified output files
@@ -77,6 +81,8 @@ int main(int argc, char** argv) {
 	
 	// Perform the actual simulations
 	simulate_all_params(ip, *rs, sd, sets, mds, file_passed, file_scores, filenames_dirs, file_features, file_conditions);
+	print_profile(ip, sd, mds);
+	print_trace(ip, mds);
 	
 	// Free used memory, close files, etc.
 	delete_mutant_data(mds);
@@ -87,6 +93,7 @@ int main(int argc, char** argv) {
 	delete_file(file_passed);
 	delete_file(file_scores);
 	delete_sets(sets, ip);
+	delete_trace(ip);
 	#if defined(MEMTRACK)
 		print_heap_usage();
 	#endif
@@ -94,6 +101,7 @@ int main(int argc, char** argv) {
 	reset_cout(ip);
 	return EXIT_SUCCESS;
 }
+#endif
 
 /* usage prints the usage information and, optionally, an error message and then exits
 	parameters:
@@ -101,6 +109,7 @@ int main(int argc, char** argv) {
 	returns: nothing
 	notes:
 		This function exits after printing the usage information.
+		When running as a library only the error message is printed, since the library's caller has no command line.
 		Note that accept_input_params in init.cpp handles actual command-line input and that this information should be updated according to that function.
 	todo:
 		TODO somehow free memory even with the abrupt exit
@@ -110,15 +119,21 @@ void usage (const char* message) {
 	bool error = message != NULL && message[0] != '\0';
 	if (error) {
 		cout << term->red << message << term->reset << endl << endl;
+		if (embedded) {
+			quit(EXIT_INPUT_ERROR);
+		}
 	}
 	cout << "Usage: [-option [value]]. . . [--option [value]]. . ." << endl;
-	cout << "-i, --params-file        [filename]   : the relative filename of the parameter sets input file, default=none" << endl;
+	cout << "-i, --params-file        [filename]   : the relative filename of the parameter sets input file (comma-separated text or binary with a params_header), default=none" << endl;
 	cout << "-R, --ranges-file        [filename]   : the relative filename of the parameter ranges input file, default=none" << endl;
 	cout << "-u, --perturb-file       [filename]   : the relative filename of the perturbations input file, default=none" << endl;
 	cout << "-r, --gradients-file     [filename]   : the relative filename of the gradients input file, default=none" << endl;
 	cout << "-o, --print-passed       [filename]   : the relative filename of the passed sets output file, default=none" << endl;
 	cout << "-t, --print-cons         [N/A]        : print concentration values to the specified output directory, default=unused" << endl;
 	cout << "-B, --binary-cons-output [N/A]        : print concentration values as binary numbers rather than ASCII, default=unused" << endl;
+	cout << "-J, --chunked-cons       [int]        : print concentration values in chunked, columnar binary files (.ccons) with the given number of time steps per chunk, min=1, default=0 (unused)" << endl;
+	cout << "-z, --compress-cons      [N/A]        : delta encode and compress the columns of the chunked concentrations files, default=unused" << endl;
+	cout << "-n, --cons-levels        [list]       : the comma-separated concentration levels to print in the chunked concentrations files (1=mh1, 2=mh7, 3=mmespa, 4=mmespb, 5=mh13, 6=mdelta), default=each mutant's usual level" << endl;
 	cout << "-f, --print-osc-features [filename]   : the relative filename of the file summarizing all the oscillation features, default=none" << endl;
 	cout << "-V, --her1-induction     [int]        : the induction point for her1 overexpression" << endl;
 	cout << "-Y, --her7-induction     [int]        : the induction point for her7 overexpression" << endl;
@@ -130,6 +145,8 @@ void usage (const char* message) {
 	cout << "-P, --posterior-feats    [N/A]        : print in depth oscillation features for the posterior cells over time, default=unused" << endl;
 	cout << "-W, --print-conditions   [filename]   : the relative filename of the passed and failed conditions file, default=none" << endl;
 	cout << "-E, --print-scores       [filename]   : the relative filename of the mutant scores file, default=none" << endl;
+	cout << "-pf, --print-profile     [filename]   : the relative filename of the profile of the time spent in each phase of the simulations per section and mutant, default=none" << endl;
+	cout << "-tf, --print-trace       [filename]   : the relative filename of the trace of every worker's timeline of sets, sections, mutants, and phases in Chrome's Trace Event JSON format, default=none" << endl;
 	cout << "-L, --print-cells        [int]        : the number of columns of cells to print for plotting of single cells on top of each other, min=0, default=0" << endl;
 	cout << "-b, --big-granularity    [int]        : the granularity in time steps with which to store data, min=1, default=1" << endl;
 	cout << "-g, --small-granularity  [int]        : the granularity in time steps with which to simulate data, min=1, default=1" << endl;
@@ -147,9 +164,15 @@ void usage (const char* message) {
 	cout << "-e, --print-seeds        [filename]   : the relative filename of the seed output file, default=none" << endl;
 	cout << "-a, --max-con-threshold  [float]      : the concentration threshold at which to fail the simulation, min=1, default=infinity" << endl;
 	cout << "-C, --short-circuit      [N/A]        : stop simulating a parameter set after a mutant fails, default=unused" << endl;
+	cout << "-F, --predict-fail       [int]        : the number of expected periods without clear wild type mh1 oscillations after which to abandon a parameter set as failed, min=0, default=0 (unused)" << endl;
 	cout << "-M, --mutants            [int]        : the number of mutants to run for each parameter set, min=1, max=" << NUM_MUTANTS << ", default=" << NUM_MUTANTS << endl;
+	cout << "-j, --threads            [int]        : the number of worker threads to simulate parameter sets with, min=1, default=1" << endl;
+	cout << "-k, --ensemble           [int]        : the number of parameter sets each worker simulates at once in SIMD lanes (posterior-only runs, i.e. -G equal to -m), min=1, default=1" << endl;
 	cout << "-I, --pipe-in            [file desc.] : the file descriptor to pipe data from (usually passed by the sampler), default=none" << endl;
 	cout << "-O, --pipe-out           [file desc.] : the file descriptor to pipe data into (usually passed by the sampler), default=none" << endl;
+	cout << "-H, --shm-ring           [name]       : the name of a POSIX shared memory region created by the sampler to exchange data through instead of pipes, default=none" << endl;
+	cout << "-N, --daemon             [N/A]        : keep answering batches of parameter sets piped in until the sampler sends an empty batch or closes the pipe, default=unused" << endl;
+	cout << "-U, --pipe-records       [N/A]        : pipe each set's index, score, and mutant scores as soon as it finishes rather than every score once all sets finish, default=unused" << endl;
 	cout << "-c, --no-color           [N/A]        : disable coloring the terminal output, default=unused" << endl;
 	cout << "-v, --verbose            [N/A]        : print detailed messages about the program and simulation state, default=unused" << endl;
 	cout << "-q, --quiet              [N/A]        : hide the terminal output, default=unused" << endl;
@@ -157,9 +180,9 @@ void usage (const char* message) {
 	cout << "-h, --help               [N/A]        : view usage information (i.e. this)" << endl;
 	cout << endl << term->blue << "Example: ./simulation -i parameters.csv --parameters 10 -m 2000 --no-color" << term->reset << endl << endl;
 	if (error) {
-		exit(EXIT_INPUT_ERROR);
+		quit(EXIT_INPUT_ERROR);
 	} else {
-		exit(EXIT_SUCCESS);
+		quit(EXIT_SUCCESS);
 	}
 }
 
@@ -177,6 +200,27 @@ void licensing () {
 	cout << "This is free software, and you are welcome to redistribute it under certain conditions;" << endl;
 	cout << "You can use this code and modify it as you wish under the condition that you refer to the article: \"Short-lived Her proteins drive robust synchronized oscillations in the zebrafish segmentation clock\" (Development 2013 140:3244-3253; doi:10.1242/dev.093278)" << endl;
 	cout << endl;
-	exit(EXIT_SUCCESS);
+	quit(EXIT_SUCCESS);
 }
 
+/* quit exits the program with the given status
+	parameters:
+		status: the exit status (one of the EXIT_ codes in macros.hpp)
+	returns: never, since it always exits or throws (hence [[noreturn]] in main.hpp)
+	notes:
+		Every exit in the program should go through this function. When running as a library an early_exit is thrown instead, which the library's entry points catch and report to their caller without ending its process.
+		The error message printed just before is kept before throwing, since other workers may print more lines before the failure is reported.
+		Otherwise the output writer is finished first (see finish_output_writer), since exiting would lose the records still queued for it.
+	todo:
+*/
+void quit (int status) {
+	if (embedded) {
+		line_buffer* output = dynamic_cast<line_buffer*>(cout.rdbuf());
+		if (output != NULL) {
+			output->keep_error();
+		}
+		throw early_exit(status);
+	}
+	finish_output_writer(); // Write what the workers have already handed over
+	exit(status);
+}
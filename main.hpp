@@ -25,6 +25,7 @@ main.hpp contains function declarations for main.cpp.
 
 void usage(const char*);
 void licensing();
+[[noreturn]] void quit(int);
 
 #endif
 
@@ -23,6 +23,7 @@ Many features and functions are enabled only when scons-compiling with 'memtrack
 
 #include "memory.hpp" // Function declarations
 
+#include "main.hpp"
 #include "structs.hpp"
 
 extern terminal* term; // Declared in init.cpp
@@ -55,11 +56,11 @@ void* mallocate (size_t size) {
 		#endif
 		if (block == NULL) {
 			term->no_memory();
-			exit(EXIT_MEMORY_ERROR);
+			quit(EXIT_MEMORY_ERROR);
 		}
 		#if defined(MEMTRACK)
-			heap_current += size;
-			heap_total += size;
+			__sync_add_and_fetch(&heap_current, size); // Worker threads allocate concurrently so the counters must be updated atomically
+			__sync_add_and_fetch(&heap_total, size);
 			size_t* sizeblock = (size_t*)block;
 			*sizeblock = size;
 			return (void*)(sizeblock + 1);
@@ -68,7 +69,7 @@ void* mallocate (size_t size) {
 		#endif
 	} else {
 		cout << term->red << "The specified amount of memory to allocate (" << size << " B) must be a positive integer!" << term->reset << endl;
-		exit(EXIT_MEMORY_ERROR);
+		quit(EXIT_MEMORY_ERROR);
 	}
 }
 
@@ -85,7 +86,7 @@ void mfree (void* mem) {
 	#if defined(MEMTRACK)
 		if (mem != NULL) {
 			size_t* memblock = (size_t*)mem - 1;
-			heap_current -= *memblock;
+			__sync_sub_and_fetch(&heap_current, *memblock);
 			free(memblock);
 		}
 	#else
@@ -93,6 +94,64 @@ void mfree (void* mem) {
 	#endif
 }
 
+/* mallocate_aligned allocates a block of memory with the given size whose address is a multiple of the given alignment
+	parameters:
+		size: the number of bytes to allocate
+		alignment: the alignment in bytes, which must be a power of two and a multiple of sizeof(void*)
+	returns: a pointer to the block of memory allocated
+	notes:
+		This function is a thin wrapper for posix_memalign with the same error handling as mallocate.
+		If memory tracking is enabled, an extra alignment's worth of bytes is allocated to store the size of the request in front of the returned block.
+		Memory allocated with mallocate_aligned must be freed with mfree_aligned and the same alignment, not mfree or free.
+	todo:
+*/
+void* mallocate_aligned (size_t size, size_t alignment) {
+	if (size > 0) {
+		void* block;
+		#if defined(MEMTRACK)
+			int error = posix_memalign(&block, alignment, alignment + size);
+		#else
+			int error = posix_memalign(&block, alignment, size);
+		#endif
+		if (error != 0) {
+			term->no_memory();
+			quit(EXIT_MEMORY_ERROR);
+		}
+		#if defined(MEMTRACK)
+			__sync_add_and_fetch(&heap_current, size);
+			__sync_add_and_fetch(&heap_total, size);
+			char* aligned = (char*)block + alignment;
+			*((size_t*)aligned - 1) = size;
+			return (void*)aligned;
+		#else
+			return block;
+		#endif
+	} else {
+		cout << term->red << "The specified amount of memory to allocate (" << size << " B) must be a positive integer!" << term->reset << endl;
+		quit(EXIT_MEMORY_ERROR);
+	}
+}
+
+/* mfree_aligned frees the given block of memory allocated with mallocate_aligned
+	parameters:
+		mem: a pointer to the block of memory to free
+		alignment: the alignment the block was allocated with
+	returns: nothing
+	notes:
+	todo:
+*/
+void mfree_aligned (void* mem, size_t alignment) {
+	#if defined(MEMTRACK)
+		if (mem != NULL) {
+			__sync_sub_and_fetch(&heap_current, *((size_t*)mem - 1));
+			free((char*)mem - alignment);
+		}
+	#else
+		(void)alignment;
+		free(mem);
+	#endif
+}
+
 /* new overloads the usual new with mallocate instead of malloc
 	parameters:
 		size: the number of bytes to allocate [ this parameter is not inputted directly due to the syntax of new; new int(x) translates conceptually to new(sizeof(int)) ]
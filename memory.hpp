@@ -29,6 +29,8 @@ using namespace std;
 
 void* mallocate(size_t);
 void mfree(void*);
+void* mallocate_aligned(size_t, size_t);
+void mfree_aligned(void*, size_t);
 #if defined(MEMTRACK)
 	void print_heap_usage();
 #endif
@@ -0,0 +1,464 @@
+/*
+Simulation for zebrafish segmentation
+Copyright (C) 2013 Ahmet Ay, Jack Holland, Adriana Sperlea, Sebastian Sangervasi
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+segclock.cpp contains the functions of libsegclock, the library interface for evaluating parameter sets inside another program (see segclock.hpp).
+Every function here catches the early_exit the rest of the program throws instead of exiting when embedded, so failures reach the caller as statuses and messages.
+*/
+
+#include <cstring> // Needed for memcpy
+#include <iomanip> // Needed for setprecision
+#include <new> // Needed for bad_alloc
+#include <string> // Needed for string
+#include <vector> // Needed for vector
+
+#include "segclock.hpp" // Function declarations
+
+#include "init.hpp"
+#include "io.hpp"
+#include "main.hpp"
+#include "sim.hpp"
+#include "structs.hpp"
+
+using namespace std;
+
+extern terminal* term; // Declared in init.cpp
+extern bool embedded; // Declared in main.cpp
+
+typedef char segclock_num_rates_check[SEGCLOCK_NUM_RATES == NUM_RATES ? 1 : -1]; // Fails to compile if segclock.hpp's number of rates is out of date
+
+// Helpers shared by the library's functions, which are not part of its interface
+void begin_segclock_call(segclock*);
+void end_segclock_call(segclock*);
+void fail_segclock(segclock*, int);
+set_results* find_segclock_results(segclock*, int);
+void add_segclock_arg(vector<string>&, const char*, double);
+
+null_buffer segclock_null_stream; // The buffer the terminal's verbose stream is redirected to while embedded
+
+/* segclock_default_config fills the given configuration with the default value of every setting
+	parameters:
+		config: the configuration to fill
+	returns: nothing
+	notes:
+		The defaults are taken from input_params so they always match the command-line defaults. The inductions have no command-line default and are set to 0.
+	todo:
+*/
+void segclock_default_config (segclock_config* config) {
+	input_params ip;
+	config->width_total = ip.width_total;
+	config->width_initial = ip.width_initial;
+	config->height = ip.height;
+	config->step_size = ip.step_size;
+	config->time_total = ip.time_total;
+	config->time_split = ip.time_split;
+	config->time_til_growth = ip.time_til_growth;
+	config->big_gran = ip.big_gran;
+	config->small_gran = ip.small_gran;
+	config->seed = ip.seed;
+	config->reset_seed = ip.reset_seed;
+	config->max_con_thresh = ip.max_con_thresh;
+	config->short_circuit = ip.short_circuit;
+	config->predict_fail = ip.predict_fail;
+	config->num_mutants = ip.num_active_mutants;
+	config->num_threads = ip.num_threads;
+	config->num_lanes = ip.num_lanes;
+	config->her1_induction = 0;
+	config->her7_induction = 0;
+	config->DAPT_induction = 0;
+	config->mespa_induction = 0;
+	config->mespb_induction = 0;
+	config->perturb_file = NULL;
+	config->gradients_file = NULL;
+	config->features = false;
+	config->conditions = false;
+	config->profile_file = NULL;
+	config->trace_file = NULL;
+}
+
+/* segclock_create creates a library context with the given configuration
+	parameters:
+		config: the context's configuration
+	returns: the context, which must be freed with segclock_destroy even if creating it failed
+	notes:
+		The configuration is translated to command-line arguments and accepted and checked exactly as the program's would be, so an invalid setting is reported with the same message.
+		The perturbations and gradients files are read here, once; every batch reuses them.
+		Check segclock_status before evaluating sets with the context.
+	todo:
+*/
+segclock* segclock_create (const segclock_config* config) {
+	segclock* sc = new segclock();
+	begin_segclock_call(sc);
+	try {
+		// Translate the configuration to the program's command-line arguments
+		vector<string> args;
+		args.push_back("segclock");
+		add_segclock_arg(args, "-x", config->width_total);
+		add_segclock_arg(args, "-w", config->width_initial);
+		add_segclock_arg(args, "-y", config->height);
+		add_segclock_arg(args, "-S", config->step_size);
+		add_segclock_arg(args, "-m", config->time_total);
+		add_segclock_arg(args, "-T", config->time_split);
+		add_segclock_arg(args, "-G", config->time_til_growth);
+		add_segclock_arg(args, "-b", config->big_gran);
+		add_segclock_arg(args, "-g", config->small_gran);
+		if (config->seed != 0) {
+			add_segclock_arg(args, "-s", config->seed);
+		}
+		if (config->reset_seed) {
+			args.push_back("-X");
+		}
+		add_segclock_arg(args, "-a", config->max_con_thresh);
+		if (config->short_circuit) {
+			args.push_back("-C");
+		}
+		add_segclock_arg(args, "-F", config->predict_fail);
+		add_segclock_arg(args, "-M", config->num_mutants);
+		add_segclock_arg(args, "-j", config->num_threads);
+		add_segclock_arg(args, "-k", config->num_lanes);
+		add_segclock_arg(args, "-V", config->her1_induction);
+		add_segclock_arg(args, "-Y", config->her7_induction);
+		add_segclock_arg(args, "-Z", config->DAPT_induction);
+		add_segclock_arg(args, "-Q", config->mespa_induction);
+		add_segclock_arg(args, "-K", config->mespb_induction);
+		if (config->perturb_file != NULL) {
+			args.push_back("-u");
+			args.push_back(config->perturb_file);
+		}
+		if (config->gradients_file != NULL) {
+			args.push_back("-r");
+			args.push_back(config->gradients_file);
+		}
+		if (config->profile_file != NULL) {
+			args.push_back("-pf");
+			args.push_back(config->profile_file);
+		}
+		if (config->trace_file != NULL) {
+			args.push_back("-tf");
+			args.push_back(config->trace_file);
+		}
+		vector<char*> argv;
+		for (size_t i = 0; i < args.size(); i++) {
+			argv.push_back(&(args[i][0]));
+		}
+		
+		// Accept and check the arguments, keeping the features and conditions in each set's results if asked to
+		input_params& ip = sc->ip;
+		accept_input_params(argv.size(), &argv[0], ip);
+		ip.print_features = config->features;
+		ip.print_conditions = config->conditions;
+		check_input_params(ip);
+		
+		// Read the perturbations and gradients and initialize the simulation data and rates
+		input_data perturb_data(ip.perturb_file);
+		input_data gradients_data(ip.gradients_file);
+		read_perturb_params(ip, perturb_data);
+		read_gradients_params(ip, gradients_data);
+		sc->sd = new sim_data(ip);
+		sc->rs = new rates(sc->sd->width_total, sc->sd->cells_total);
+		fill_perturbations(*(sc->rs), perturb_data);
+		fill_gradients(*(sc->rs), gradients_data);
+	} catch (early_exit& e) {
+		fail_segclock(sc, e.status);
+	} catch (bad_alloc& e) {
+		fail_segclock(sc, EXIT_MEMORY_ERROR);
+	}
+	end_segclock_call(sc);
+	return sc;
+}
+
+/* segclock_evaluate simulates a batch of parameter sets and gives back their scores
+	parameters:
+		sc: the library context
+		sets: the batch's parameter sets, SEGCLOCK_NUM_RATES rates per set one set after another
+		num_sets: the number of sets in the batch
+		scores: the array to store each set's score in (num_sets long)
+	returns: the context's status (0 if the batch was evaluated)
+	notes:
+		The mutant data, queue, and workers are created by the first batch and kept for the rest, like in daemon mode; a batch with longer delays than any before it makes them grow. Set numbers start from 0 in every batch.
+		Every set's mutant scores, features, and conditions can be read until the next batch is evaluated.
+	todo:
+*/
+int segclock_evaluate (segclock* sc, const double* sets, int num_sets, double* scores) {
+	if (sc->status != EXIT_SUCCESS) {
+		return sc->status;
+	}
+	begin_segclock_call(sc);
+	try {
+		input_params& ip = sc->ip;
+		if (num_sets <= 0) {
+			usage("The number of parameter sets to evaluate must be a positive integer.");
+		}
+		
+		// Copy the batch's sets, replacing the previous batch's
+		if (sc->sets != NULL) {
+			delete_sets(sc->sets, ip);
+		}
+		sc->sets = new double*[num_sets];
+		for (int i = 0; i < num_sets; i++) {
+			sc->sets[i] = new double[NUM_RATES];
+			memcpy(sc->sets[i], sets + i * NUM_RATES, sizeof(double) * NUM_RATES);
+		}
+		ip.num_sets = num_sets;
+		
+		// Create everything sized by the delays with the first batch, otherwise make sure it is big enough for this one
+		if (sc->mds == NULL) {
+			calc_max_delay_size(ip, *(sc->sd), *(sc->rs), sc->sets);
+			sc->mds = create_mutant_data(*(sc->sd), ip);
+			declare_feature_demands(ip, *(sc->sd), sc->mds);
+			sc->sd->initialize_conditions_data(sc->mds);
+			sc->dirnames_cons = create_dirs(ip, *(sc->sd), sc->mds);
+			sc->queue = new set_queue(sc->sets, num_sets);
+			sc->queue->keep_results = true;
+			sc->contexts = create_contexts(ip, *(sc->sd), *(sc->rs), sc->mds, sc->queue, sc->dirnames_cons);
+			if (ip.num_lanes > 1) {
+				sc->ensembles = create_ensembles(ip, *(sc->sd), sc->contexts);
+			}
+		} else {
+			fit_contexts(ip, *(sc->rs), *(sc->sd), sc->sets, sc->mds, sc->queue, sc->dirnames_cons, sc->contexts, sc->ensembles);
+			sc->queue->begin(sc->sets, num_sets);
+		}
+		
+		// Simulate every set and give back the scores
+		simulate_queue(ip, sc->contexts, sc->ensembles);
+		memcpy(scores, sc->queue->scores, sizeof(double) * num_sets);
+	} catch (early_exit& e) {
+		fail_segclock(sc, e.status);
+	} catch (bad_alloc& e) {
+		fail_segclock(sc, EXIT_MEMORY_ERROR);
+	}
+	end_segclock_call(sc);
+	return sc->status;
+}
+
+/* segclock_max_score returns the score a set gets if it passes every condition
+	parameters:
+		sc: the library context
+	returns: the maximum score, or 0 before the first batch has been evaluated
+	notes:
+	todo:
+*/
+double segclock_max_score (segclock* sc) {
+	if (sc->mds == NULL) {
+		return 0;
+	}
+	return sc->sd->no_growth ? sc->sd->max_scores[SEC_POST] : sc->sd->max_score_all;
+}
+
+/* segclock_mutant_scores gives back the score of every mutant in every section for the given set of the latest batch
+	parameters:
+		sc: the library context
+		set_num: the index of the set within the batch
+		scores: the array to store the scores in (3 * config.num_mutants long), where mutant i of section s (posterior, anterior, wave) is at s * config.num_mutants + i
+	returns: the number of scores stored, or -1 if there is no such set
+	notes:
+	todo:
+*/
+int segclock_mutant_scores (segclock* sc, int set_num, double* scores) {
+	set_results* results = find_segclock_results(sc, set_num);
+	if (results == NULL) {
+		return -1;
+	}
+	int num_scores = NUM_SECTIONS * sc->ip.num_active_mutants;
+	memcpy(scores, results->mutant_scores, sizeof(double) * num_scores);
+	return num_scores;
+}
+
+/* segclock_features gives back the oscillation features of the given set of the latest batch
+	parameters:
+		sc: the library context
+		set_num: the index of the set within the batch
+	returns: the set's lines of the features file (see print_osc_features), empty if config.features was not set, or NULL if there is no such set
+	notes:
+		The text stays valid until the next call with the same context.
+	todo:
+*/
+const char* segclock_features (segclock* sc, int set_num) {
+	set_results* results = find_segclock_results(sc, set_num);
+	if (results == NULL) {
+		return NULL;
+	}
+	sc->text = results->features.str();
+	return sc->text.c_str();
+}
+
+/* segclock_conditions gives back which conditions the given set of the latest batch passed and failed
+	parameters:
+		sc: the library context
+		set_num: the index of the set within the batch
+	returns: the set's lines of the conditions file (see print_conditions), empty if config.conditions was not set, or NULL if there is no such set
+	notes:
+		The text stays valid until the next call with the same context.
+	todo:
+*/
+const char* segclock_conditions (segclock* sc, int set_num) {
+	set_results* results = find_segclock_results(sc, set_num);
+	if (results == NULL) {
+		return NULL;
+	}
+	sc->text = results->conditions.str();
+	return sc->text.c_str();
+}
+
+/* segclock_status returns whether or not the given context can be used
+	parameters:
+		sc: the library context
+	returns: 0 if the context can be used, otherwise the status of the failure that broke it (one of the EXIT_ codes in macros.hpp)
+	notes:
+	todo:
+*/
+int segclock_status (segclock* sc) {
+	return sc->status;
+}
+
+/* segclock_error returns the message of the failure that broke the given context
+	parameters:
+		sc: the library context
+	returns: the message, empty if the context has not failed
+	notes:
+	todo:
+*/
+const char* segclock_error (segclock* sc) {
+	return sc->error.c_str();
+}
+
+/* segclock_destroy frees the given context from memory
+	parameters:
+		sc: the library context
+	returns: nothing
+	notes:
+		This frees everything the context created, in the same order main frees the program's data.
+		The profile and trace are printed first if configured, covering every batch the context evaluated.
+	todo:
+*/
+void segclock_destroy (segclock* sc) {
+	if (sc->ensembles != NULL) {
+		delete_ensembles(sc->ensembles);
+	}
+	if (sc->contexts != NULL) {
+		delete_contexts(sc->contexts, sc->ip);
+	}
+	if ((sc->ip.print_profile || sc->ip.print_trace) && sc->mds != NULL) { // Every evaluation has finished, so print the profile and trace of them all
+		begin_segclock_call(sc);
+		try {
+			print_profile(sc->ip, *(sc->sd), sc->mds);
+			print_trace(sc->ip, sc->mds);
+		} catch (early_exit& e) { // The context is freed anyway, so a profile or trace that couldn't be written is dropped
+		}
+		end_segclock_call(sc);
+	}
+	delete sc->queue;
+	if (sc->mds != NULL) {
+		delete_mutant_data(sc->mds);
+	}
+	delete sc->rs;
+	delete_dirs(sc->ip, sc->dirnames_cons);
+	if (sc->sets != NULL) {
+		delete_sets(sc->sets, sc->ip);
+	}
+	delete_trace(sc->ip);
+	delete sc->sd;
+	delete sc;
+}
+
+/* begin_segclock_call prepares the program to run inside its caller for the duration of a library call
+	parameters:
+		sc: the library context
+	returns: nothing
+	notes:
+		Everything the program prints is caught by the context's line buffer instead of reaching the caller's standard output, and quit throws instead of exiting.
+		The terminal is created by the first call and kept without colors and verbose output for every later one.
+	todo:
+*/
+void begin_segclock_call (segclock* sc) {
+	embedded = true;
+	if (term == NULL) {
+		init_terminal();
+		mfree(term->blue);
+		mfree(term->red);
+		mfree(term->reset);
+		term->blue = copy_str("");
+		term->red = copy_str("");
+		term->reset = copy_str("");
+		term->set_verbose_streambuf(&segclock_null_stream);
+	}
+	sc->output.clear();
+	sc->ip.cout_orig = cout.rdbuf(&(sc->output));
+}
+
+/* end_segclock_call restores the caller's standard output after a library call
+	parameters:
+		sc: the library context
+	returns: nothing
+	notes:
+	todo:
+*/
+void end_segclock_call (segclock* sc) {
+	cout.rdbuf(sc->ip.cout_orig);
+}
+
+/* fail_segclock marks the given context as broken by a failure
+	parameters:
+		sc: the library context
+		status: the status the program would have exited with
+	returns: nothing
+	notes:
+		The last line the program printed before failing is its error message (kept by quit, otherwise the last line printed at all).
+	todo:
+*/
+void fail_segclock (segclock* sc, int status) {
+	sc->status = status;
+	string& message = sc->output.error_line.empty() ? sc->output.last_line : sc->output.error_line;
+	if (status == EXIT_MEMORY_ERROR && message.empty()) {
+		sc->error = "Not enough memory!";
+	} else {
+		sc->error = message;
+	}
+}
+
+/* find_segclock_results finds the results of the given set of the latest batch
+	parameters:
+		sc: the library context
+		set_num: the index of the set within the batch
+	returns: the set's results, or NULL if there is no such set or the context has failed
+	notes:
+	todo:
+*/
+set_results* find_segclock_results (segclock* sc, int set_num) {
+	if (sc->status != EXIT_SUCCESS || sc->queue == NULL || set_num < 0 || set_num >= sc->queue->num_sets) {
+		return NULL;
+	}
+	return sc->queue->pending[set_num];
+}
+
+/* add_segclock_arg adds an option and its value to the given command-line arguments
+	parameters:
+		args: the arguments to add to
+		option: the option's short form
+		value: the option's value
+	returns: nothing
+	notes:
+		Real values are written with enough digits to be read back exactly.
+	todo:
+*/
+void add_segclock_arg (vector<string>& args, const char* option, double value) {
+	ostringstream text;
+	text << setprecision(17) << value;
+	args.push_back(option);
+	args.push_back(text.str());
+}
@@ -0,0 +1,100 @@
+/*
+Simulation for zebrafish segmentation
+Copyright (C) 2013 Ahmet Ay, Jack Holland, Adriana Sperlea, Sebastian Sangervasi
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+segclock.hpp contains the interface of libsegclock, which lets other programs (e.g. optimizers written in C, C++, or Python through ctypes) evaluate parameter sets without running this program.
+The library is every source file compiled with LIBRARY defined, which leaves main out. Its functions never exit the calling program or print to its standard output.
+Typical use:
+	segclock_config config;
+	segclock_default_config(&config);
+	config.width_total = 2; . . .
+	segclock* sc = segclock_create(&config);
+	if (segclock_status(sc) == 0) {
+		segclock_evaluate(sc, sets, num_sets, scores); // As many times as needed
+	} else {
+		segclock_error(sc); // Why the context could not be created
+	}
+	segclock_destroy(sc);
+Every function that takes a context returns a nonzero status (one of the EXIT_ codes in macros.hpp) once the context has failed, after which only segclock_status, segclock_error, and segclock_destroy are useful.
+Calls are not thread-safe: only one call may run at a time in the whole calling program, since the program's terminal output is shared. A context simulates with config.num_threads worker threads of its own.
+*/
+
+#ifndef SEGCLOCK_HPP
+#define SEGCLOCK_HPP
+
+#define SEGCLOCK_NUM_RATES	71 // The number of rates in every parameter set (NUM_RATES in macros.hpp)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct segclock segclock; // A library context (see structs.hpp), opaque to the caller
+
+/* segclock_config contains the settings of a library context, matching the command-line options of the same names (see usage in main.cpp)
+	notes:
+		Fill it in with segclock_default_config before changing any field, so fields added later keep their defaults.
+	todo:
+*/
+typedef struct segclock_config {
+	int width_total; // -x
+	int width_initial; // -w
+	int height; // -y
+	double step_size; // -S
+	int time_total; // -m
+	int time_split; // -T
+	int time_til_growth; // -G
+	int big_gran; // -b
+	int small_gran; // -g
+	int seed; // -s (0 generates one)
+	int reset_seed; // -X
+	double max_con_thresh; // -a
+	int short_circuit; // -C
+	int predict_fail; // -F
+	int num_mutants; // -M
+	int num_threads; // -j
+	int num_lanes; // -k
+	int her1_induction; // -V
+	int her7_induction; // -Y
+	int DAPT_induction; // -Z
+	int mespa_induction; // -Q
+	int mespb_induction; // -K
+	const char* perturb_file; // -u (NULL for none), read once when the context is created
+	const char* gradients_file; // -r (NULL for none), read once when the context is created
+	int features; // Whether or not to keep every set's oscillation features for segclock_features (like -f)
+	int conditions; // Whether or not to keep every set's passed and failed conditions for segclock_conditions (like -W)
+	const char* profile_file; // -pf (NULL for none), printed when the context is destroyed
+	const char* trace_file; // -tf (NULL for none), printed when the context is destroyed
+} segclock_config;
+
+void segclock_default_config(segclock_config*);
+segclock* segclock_create(const segclock_config*);
+int segclock_evaluate(segclock*, const double*, int, double*);
+double segclock_max_score(segclock*);
+int segclock_mutant_scores(segclock*, int, double*);
+const char* segclock_features(segclock*, int);
+const char* segclock_conditions(segclock*, int);
+int segclock_status(segclock*);
+const char* segclock_error(segclock*);
+void segclock_destroy(segclock*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
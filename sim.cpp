@@ -22,6 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "feats.hpp"
 #include "init.hpp"
 #include "io.hpp"
+#include "main.hpp"
+#include "simd.hpp"
 
 using namespace std;
 
@@ -32,7 +34,7 @@ extern terminal* term; // Declared in init.cpp
 		ip: the program's input parameters
 		rs: the current simulation's rates
 		sd: the current simulation's data
-		sets: the array of parameter sets
+		sets: the array of parameter sets (replaced by every batch in daemon mode)
 		mds: the array of all mutant data
 		file_passed: a pointer to the output file stream of the passed file
 		file_scores: a pointer to the output file stream of the scores file
@@ -41,40 +43,322 @@ extern terminal* term; // Declared in init.cpp
 		file_conditions: a pointer to the output file stream of the conditions file
 	returns: nothing
 	notes:
+		The sets are divided among ip.num_threads workers, each with its own context. With one thread the only worker runs on the main thread.
+		In ensemble mode each worker takes ip.num_lanes sets at a time and simulates them together (see simulate_ensembles).
+		A parameter sets file is streamed: the workers parse it a chunk at a time as they take sets (see take_set), so simulating starts as soon as the first chunk is parsed.
+		Each set's results are written in set order no matter which worker finishes first, so the output matches a single-threaded run.
+		The output files are written by a background writer thread (see output_writer), which is stopped once every file has been written and flushed.
+		In daemon mode the contexts, ensembles, and mutant data are kept between batches, so each batch is answered without reading the input files or allocating the simulation's memory again. Only a batch with longer delays than any before it makes them be created again with larger sizes. Set numbers start from 0 in every batch, so each reply matches what a separate run of the batch would send.
 	todo:
 		TODO consolidate ofstream parameters.
 */
-void simulate_all_params (input_params& ip, rates& rs, sim_data& sd, double** sets, mutant_data mds[], ofstream* file_passed, ofstream* file_scores, char** dirnames_cons, ofstream* file_features, ofstream* file_conditions) {
-	// Initialize score data
-	int sets_passed = 0; // number of sets that passed. 20160519: Do I really need this?
-	double score[ip.num_sets];
-	
-	// Initialize the concentration levels structs
-	int max_cl_size = MAX(sd.steps_til_growth, sd.max_delay_size + sd.steps_total - sd.steps_til_growth) / sd.big_gran + 1;
-	con_levels cl(NUM_CON_STORE, max_cl_size, sd.cells_total, sd.active_start); // Concentration levels for analysis and storage
-	con_levels baby_cl(NUM_CON_LEVELS, sd.max_delay_size, sd.cells_total, sd.active_start); // Concentration levels for simulating (time in this cl is treated cyclically)
-	
-	// Simulate every parameter set
-	for (int i = 0; i < ip.num_sets; i++) {
-		memcpy(rs.rates_base, sets[i], sizeof(double) * NUM_RATES); // Copy the set's rates to the current simulation's rates
-		score[i] = simulate_param_set(i, ip, sd, rs, cl, baby_cl, mds, file_passed, file_scores, dirnames_cons, file_features, file_conditions);
-		sets_passed += determine_set_passed(sd, i, score[i]); // Calculate the maximum score and whether the set passed
+void simulate_all_params (input_params& ip, rates& rs, sim_data& sd, double**& sets, mutant_data mds[], ofstream* file_passed, ofstream* file_scores, char** dirnames_cons, ofstream* file_features, ofstream* file_conditions) {
+	// Initialize the queue of sets and a context for every worker (or every lane of every worker in ensemble mode)
+	set_queue queue(sets, ip.num_sets);
+	queue.stream = ip.pstream;
+	start_output_writer(ip, file_passed, file_scores, file_features, file_conditions);
+	sim_context* contexts = create_contexts(ip, sd, rs, mds, &queue, dirnames_cons);
+	ensemble* ensembles = NULL;
+	if (ip.num_lanes > 1) {
+		ensembles = create_ensembles(ip, sd, contexts);
 	}
 	
-	cl.clear();
-	baby_cl.clear();
-	
-	// Pipe the scores if piping specified by the user
+	while (true) {
+		// Simulate every parameter set, piping each set's score record as it finishes if specified by the user
+		if (ip.pipe_records) {
+			write_pipe_records_header(ip, sd);
+		}
+		simulate_queue(ip, contexts, ensembles);
+		ip.num_sets = queue.num_sets; // A streamed parameter sets file may have ended before the most sets were read
+		
+		// Pipe the scores if piping specified by the user (and not already piped as records)
+		if (ip.piping && !ip.pipe_records) {
+			write_pipe(queue.scores, ip, sd);
+		}
+		
+		cout << endl << term->blue << "Done: " << term->reset << queue.sets_passed << "/" << ip.num_sets << " parameter sets passed all conditions" << endl;
+		
+		// In daemon mode wait for the sampler's next batch, stopping once it ends the session
+		if (!ip.daemon) {
+			break;
+		}
+		delete_sets(sets, ip);
+		sets = NULL;
+		ip.num_sets = 0;
+		if (!read_pipe_batch(sets, ip)) {
+			break;
+		}
+		fit_contexts(ip, rs, sd, sets, mds, &queue, dirnames_cons, contexts, ensembles);
+		queue.begin(sets, ip.num_sets);
+	}
+	if (ensembles != NULL) {
+		delete_ensembles(ensembles);
+	}
+	delete_contexts(contexts, ip);
+	stop_output_writer(ip);
 	if (ip.piping) {
-		write_pipe(score, ip, sd);
+		close_pipe(ip);
+	}
+}
+
+/* fit_contexts makes the workers' contexts and ensembles big enough for a new batch of parameter sets
+	parameters:
+		ip: the program's input parameters
+		rs: the current simulation's rates
+		sd: the current simulation's data
+		sets: the array of the batch's parameter sets
+		mds: the array of all mutant data
+		queue: the queue every worker takes parameter sets from
+		dirnames_cons: the array of mutant directory paths
+		contexts: the array of every worker's contexts, replaced if they must grow
+		ensembles: the array of every worker's ensembles (NULL if not in ensemble mode), replaced if they must grow
+	returns: nothing
+	notes:
+		Only a batch with longer delays than any before it makes the contexts and ensembles be created again; otherwise they are kept as they are.
+	todo:
+*/
+void fit_contexts (input_params& ip, rates& rs, sim_data& sd, double** sets, mutant_data mds[], set_queue* queue, char** dirnames_cons, sim_context*& contexts, ensemble*& ensembles) {
+	if (calc_max_delay_size(ip, sd, rs, sets)) { // The batch's delays are longer than any before, so everything sized by them must grow
+		if (ensembles != NULL) {
+			delete_ensembles(ensembles);
+		}
+		delete_contexts(contexts, ip);
+		resize_mutant_data(sd, mds);
+		contexts = create_contexts(ip, sd, rs, mds, queue, dirnames_cons);
+		if (ip.num_lanes > 1) {
+			ensembles = create_ensembles(ip, sd, contexts);
+		}
+	}
+}
+
+/* simulate_queue simulates every parameter set in the workers' queue
+	parameters:
+		ip: the program's input parameters
+		contexts: the array of every worker's contexts
+		ensembles: the array of every worker's ensembles, NULL if not in ensemble mode
+	returns: nothing
+	notes:
+		This function returns once every set has been simulated and its results given to the queue.
+	todo:
+*/
+void simulate_queue (input_params& ip, sim_context contexts[], ensemble ensembles[]) {
+	if (ip.num_threads == 1) {
+		if (ensembles != NULL) {
+			simulate_ensembles(&ensembles[0]);
+		} else {
+			simulate_sets(&contexts[0]);
+		}
+	} else {
+		for (int i = 0; i < ip.num_threads; i++) {
+			int created;
+			if (ensembles != NULL) {
+				created = pthread_create(&(ensembles[i].thread), NULL, simulate_ensembles, &ensembles[i]);
+			} else {
+				created = pthread_create(&(contexts[i].thread), NULL, simulate_sets, &contexts[i]);
+			}
+			if (created != 0) {
+				cout << term->red << "Couldn't create worker thread " << i << "!" << term->reset << endl;
+				quit(EXIT_MEMORY_ERROR);
+			}
+		}
+		for (int i = 0; i < ip.num_threads; i++) {
+			pthread_join(ensembles != NULL ? ensembles[i].thread : contexts[i].thread, NULL);
+		}
 	}
 	
-	cout << endl << term->blue << "Done: " << term->reset << sets_passed << "/" << ip.num_sets << " parameter sets passed all conditions" << endl;
+	// Report a worker's failure now that no worker is running
+	if (contexts[0].queue->status != EXIT_SUCCESS) {
+		quit(contexts[0].queue->status);
+	}
 }
 
-/* simulate_param_set simulates the given parameter set with every specified mutant
+/* simulate_sets takes parameter sets from the queue and simulates them until none are left
+	parameters:
+		arg: a pointer to the worker's sim_context
+	returns: NULL
+	notes:
+		This function is the entry point of every worker thread (hence the void pointers) and is also called directly when only one thread is used.
+		An early_exit must not escape a thread's entry point, so a worker that fails while running as a library records its status in the queue and stops (see simulate_queue).
+	todo:
+*/
+void* simulate_sets (void* arg) {
+	sim_context& ctx = *((sim_context*)arg);
+	set_results* results = NULL;
+	try {
+		int set_num;
+		while ((set_num = take_set(ctx, -1)) != -1) {
+			results = new set_results();
+			results->score = simulate_param_set(set_num, *(ctx.ip), *(ctx.sd), *(ctx.rs), ctx.cl, ctx.baby_cl, ctx.mds, results->mutant_scores, &(results->passed), &(results->scores), ctx.dirnames_cons, &(results->features), &(results->conditions));
+			set_results* finished = results;
+			results = NULL; // The queue owns the results once they are given
+			give_results(ctx, set_num, finished);
+		}
+	} catch (early_exit& e) {
+		ctx.queue->fail(e.status);
+	} catch (bad_alloc& e) {
+		ctx.queue->fail(EXIT_MEMORY_ERROR);
+	}
+	delete results; // The results of a set that failed were never given to the queue
+	return NULL;
+}
+
+/* simulate_ensembles takes parameter sets from the queue a batch at a time and simulates each batch together until none are left
+	parameters:
+		arg: a pointer to the worker's ensemble
+	returns: NULL
+	notes:
+		This function is the entry point of every worker thread in ensemble mode and is also called directly when only one thread is used.
+		Failures are recorded in the queue like in simulate_sets.
+	todo:
+*/
+void* simulate_ensembles (void* arg) {
+	ensemble& ens = *((ensemble*)arg);
+	for (int l = 0; l < ens.lanes; l++) {
+		ens.results[l] = NULL;
+	}
+	try {
+		int num_taken;
+		while ((num_taken = take_sets(ens)) > 0) {
+			for (int l = 0; l < num_taken; l++) {
+				ens.results[l] = new set_results();
+			}
+			simulate_ensemble(ens);
+			for (int l = 0; l < num_taken; l++) {
+				set_results* finished = ens.results[l];
+				ens.results[l] = NULL; // The queue owns the results once they are given
+				give_results(ens.ctxs[l], ens.set_nums[l], finished);
+			}
+		}
+	} catch (early_exit& e) {
+		ens.ctxs[0].queue->fail(e.status);
+	} catch (bad_alloc& e) {
+		ens.ctxs[0].queue->fail(EXIT_MEMORY_ERROR);
+	}
+	for (int l = 0; l < ens.lanes; l++) { // The results of sets that failed were never given to the queue
+		delete ens.results[l];
+		ens.results[l] = NULL;
+	}
+	return NULL;
+}
+
+/* take_set takes the next parameter set to simulate from the queue and prepares the worker's seed, rates, and sizes for it
+	parameters:
+		ctx: the worker's context
+		chunk: the chunk of the streamed parameter sets file the set must come from, -1 if it can come from any
+	returns: the index of the set to simulate, -1 if every set has been taken (or the next set is not in the given chunk)
+	notes:
+		Seeds are generated while holding the queue's lock so the seeds file is printed in set order.
+		The set's rates are copied to the worker's rates while holding the lock, so a streamed set is never read after its chunk is replaced.
+		When every set of the current chunk has been taken, the worker taking the next set parses the next chunk and calculates its delay size while holding the lock. If the file ends, the queue's number of sets becomes the number of sets in the file.
+		The worker is then sized for the set's chunk (see fit_context) after the lock is released.
+		No set is taken once a worker has failed (see set_queue).
+	todo:
+*/
+int take_set (sim_context& ctx, int chunk) {
+	set_queue& queue = *(ctx.queue);
+	input_params& ip = *(ctx.ip);
+	int set_num = -1;
+	int delay_size = ctx.sd->max_delay_size;
+	{
+		held_lock held(queue.lock);
+		params_stream* ps = queue.stream;
+		if (queue.status != EXIT_SUCCESS) {
+			return -1;
+		}
+		if (ps != NULL && chunk == -1 && queue.next_set == ps->first_set + ps->num_sets && queue.next_set < queue.num_sets) { // The chunk has been used up, so parse the next one
+			int max_sets = MIN(PARAMS_CHUNK, queue.num_sets - queue.next_set);
+			if (read_params_chunk(*ps, max_sets) < max_sets) {
+				queue.num_sets = ps->first_set + ps->num_sets;
+			}
+			ps->delay_size = calc_delay_size(*(ctx.sd), *(ctx.rs), ps->sets, ps->num_sets);
+		}
+		bool in_chunk = ps == NULL || (queue.next_set < ps->first_set + ps->num_sets && (chunk == -1 || chunk == ps->chunk));
+		if (queue.next_set < queue.num_sets && in_chunk) {
+			set_num = queue.next_set++;
+			if (!ip.reset_seed) { // Reset the seed for each set if specified by the user
+				init_seeds(ip, set_num, set_num > 0, true);
+			}
+			ctx.sd->seed = ip.seed;
+			if (ps != NULL) {
+				memcpy(ctx.rs->rates_base, ps->sets[set_num - ps->first_set], sizeof(double) * NUM_RATES);
+				ctx.chunk = ps->chunk;
+				delay_size = ps->delay_size;
+			} else {
+				memcpy(ctx.rs->rates_base, queue.sets[set_num], sizeof(double) * NUM_RATES);
+			}
+		}
+	}
+	if (set_num != -1) {
+		fit_context(ctx, delay_size);
+	}
+	return set_num;
+}
+
+/* take_sets takes up to one parameter set per lane of the given ensemble from the queue
+	parameters:
+		ens: the worker's ensemble
+	returns: the number of sets taken, which fill the first lanes (the set of every other lane is set to -1)
+	notes:
+		Every lane's set comes from the first lane's chunk so the lanes share the same sizes, and the interleaved concentration levels are sized for them.
+	todo:
+*/
+int take_sets (ensemble& ens) {
+	int num_taken = 0;
+	for (int l = 0; l < ens.lanes; l++) {
+		ens.set_nums[l] = num_taken == l ? take_set(ens.ctxs[l], l == 0 ? -1 : ens.ctxs[0].chunk) : -1;
+		num_taken += ens.set_nums[l] != -1;
+	}
+	sim_data& sd = *(ens.ctxs[0].sd);
+	if (num_taken > 0 && ens.baby_cl.time_steps < sd.history_size) { // The chunk's delays are longer than the interleaved concentration levels fit
+		ens.baby_cl.initialize(MIN_CON_LEVEL, NUM_CON_LEVELS, sd.history_size, ens.baby_cl.cells, sd.active_start);
+	}
+	return num_taken;
+}
+
+/* give_results hands a finished set's results to the queue and passes every result that is now next in set order to the output writer
+	parameters:
+		ctx: the worker's context
+		set_num: the index of the finished set
+		results: the set's results (freed once written)
+	returns: nothing
+	notes:
+		Results are held until every earlier set has been handed on so the output files are always in set order. The files themselves are written on the output writer's thread, so the lock is never held for file I/O.
+		Score records are the exception: with ip.pipe_records each set's record is piped as soon as the set is given, in whatever order the workers finish.
+		The queue owns the results as soon as this is called, even if it exits partway through.
+	todo:
+*/
+void give_results (sim_context& ctx, int set_num, set_results* results) {
+	set_queue& queue = *(ctx.queue);
+	input_params& ip = *(ctx.ip);
+	held_lock held(queue.lock);
+	queue.pending[set_num] = results;
+	if (queue.status != EXIT_SUCCESS) { // A worker failed, so the batch is abandoned and nothing more is printed after the failure's message
+		return;
+	}
+	if (ip.pipe_records) {
+		write_pipe_record(ip, set_num, results->score, results->mutant_scores);
+	}
+	while (queue.next_write < queue.num_sets && queue.pending[queue.next_write] != NULL) {
+		int i = queue.next_write;
+		set_results* ready = queue.pending[i];
+		queue.scores[i] = ready->score;
+		queue.sets_passed += determine_set_passed(*(ctx.sd), i, ready->score); // Calculate the maximum score and whether the set passed
+		if (!queue.keep_results) { // Hand the results to the output writer, which writes and frees them
+			if (ip.writer != NULL) {
+				push_output(*(ip.writer), ready, NULL);
+			} else {
+				delete ready;
+			}
+			queue.pending[i] = NULL;
+		}
+		queue.next_write++;
+	}
+}
+
+/* determine_set_passed prints the given set's score and determines whether or not it passed
 	parameters:
 		sd: the current simulation's data
+		set_num: the index of the set
 		score: the set's received score
 	returns: whether or not the set passed
 	notes:
@@ -102,26 +386,24 @@ bool determine_set_passed (sim_data& sd, int set_num, double score) {
 		cl: the concentration levels used for analysis and storage
 		baby_cl: the concentration levels used for simulating
 		mds: the array of all mutant data
-		file_passed: a pointer to the output file stream of the passed file
-		file_scores: a pointer to the output file stream of the scores file
+		scores: the array to fill with the score of every mutant in every section (NUM_SECTIONS * NUM_MUTANTS long)
+		file_passed: a pointer to the output stream of the passed file (or a buffer for it)
+		file_scores: a pointer to the output stream of the scores file (or a buffer for it)
 		dirnames_cons: the array of mutant directory paths
-		file_features: a pointer to the output file stream of the features file
-		file_conditions: a pointer to the output file stream of the conditions file
+		file_features: a pointer to the output stream of the features file (or a buffer for it)
+		file_conditions: a pointer to the output stream of the conditions file (or a buffer for it)
 	returns: the cumulative score of every mutant
 	notes:
+		sd.seed must already be set to the seed for this set (see take_set).
 	todo:
 */
-double simulate_param_set (int set_num, input_params& ip, sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data mds[], ofstream* file_passed, ofstream* file_scores, char** dirnames_cons, ofstream* file_features, ofstream* file_conditions) {
+double simulate_param_set (int set_num, input_params& ip, sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data mds[], double scores[], ostream* file_passed, ostream* file_scores, char** dirnames_cons, ostream* file_features, ostream* file_conditions) {
+	trace_span span(sd.trace, TRACE_SET, set_num, -1, -1);
+	
 	// Prepare for the simulations
-	cout << term->blue << "Simulating set " << term->reset << set_num << " . . ." << endl;
 	int num_passed = 0;
-	double scores[NUM_SECTIONS * NUM_MUTANTS] = {0};
-	if (!ip.reset_seed) { // Reset the seed for each set if specified by the user
-		init_seeds(ip, set_num, set_num > 0, true);
-	}
-	cl.reset(); // Reset the concentration levels for each set. The concentration of different genes in different cells in different timesteps are all 0
-	baby_cl.reset();
-	(*mds).feat.reset(); // reset all the interested values in feature of the mutant data wildtype to be 0
+	memset(scores, 0, sizeof(double) * NUM_SECTIONS * NUM_MUTANTS);
+	begin_param_set(set_num, cl, baby_cl, mds);
 	
 	// Simulate every mutant in the posterior before moving on to the anterior. 
 	// Most of the time, I think sd.no_growth is 0 (the PSM will grow), which means that we will calcuate for both posterior and anterior
@@ -131,6 +413,44 @@ double simulate_param_set (int set_num, input_params& ip, sim_data& sd, rates& r
 		num_passed += simulate_section(set_num, ip, sd, rs, cl, baby_cl, mds, dirnames_cons, scores);
 	}
 	
+	return end_param_set(set_num, ip, sd, rs, mds, scores, num_passed, file_passed, file_scores, file_features, file_conditions);
+}
+
+/* begin_param_set prepares the given parameter set's simulations
+	parameters:
+		set_num: the index of the parameter set to simulate
+		cl: the concentration levels used for analysis and storage
+		baby_cl: the concentration levels used for simulating
+		mds: the array of all mutant data
+	returns: nothing
+	notes:
+	todo:
+*/
+void begin_param_set (int set_num, con_levels& cl, con_levels& baby_cl, mutant_data mds[]) {
+	cout << term->blue << "Simulating set " << term->reset << set_num << " . . ." << endl;
+	cl.reset(); // Reset the concentration levels for each set. The concentration of different genes in different cells in different timesteps are all 0
+	baby_cl.reset();
+	(*mds).feat.reset(); // reset all the interested values in feature of the mutant data wildtype to be 0
+}
+
+/* end_param_set totals and prints the given parameter set's results
+	parameters:
+		set_num: the index of the parameter set simulated
+		ip: the program's input parameters
+		sd: the current simulation's data
+		rs: the current simulation's rates
+		mds: the array of all mutant data
+		scores: the score of every mutant in every section
+		num_passed: the number of mutants that passed
+		file_passed: a pointer to the output stream of the passed file (or a buffer for it)
+		file_scores: a pointer to the output stream of the scores file (or a buffer for it)
+		file_features: a pointer to the output stream of the features file (or a buffer for it)
+		file_conditions: a pointer to the output stream of the conditions file (or a buffer for it)
+	returns: the cumulative score of every mutant
+	notes:
+	todo:
+*/
+double end_param_set (int set_num, input_params& ip, sim_data& sd, rates& rs, mutant_data mds[], double scores[], int num_passed, ostream* file_passed, ostream* file_scores, ostream* file_features, ostream* file_conditions) {
 	// Calculate the total score
 	double total_score = 0;
 	for (int i = 0; i < NUM_SECTIONS * ip.num_active_mutants; i++) {
@@ -139,11 +459,21 @@ double simulate_param_set (int set_num, input_params& ip, sim_data& sd, rates& r
 	
 	// Print the mutant's results (if not short circuiting)
 	if (total_score == sd.max_scores[SEC_POST] + sd.max_scores[SEC_WAVE] + sd.max_scores[SEC_ANT]) {
+		phase_timer timer(sd, PHASE_PRINT_PASSED);
 		print_passed(ip, file_passed, rs);
 	}
-	print_osc_features(ip, file_features, mds, set_num, num_passed);
-	print_conditions(ip, file_conditions, mds, set_num);
-	print_scores(ip, file_scores, set_num, scores, total_score);
+	{
+		phase_timer timer(sd, PHASE_PRINT_FEATURES);
+		print_osc_features(ip, file_features, mds, set_num, num_passed);
+	}
+	{
+		phase_timer timer(sd, PHASE_PRINT_CONDITIONS);
+		print_conditions(ip, file_conditions, mds, set_num);
+	}
+	{
+		phase_timer timer(sd, PHASE_PRINT_SCORES);
+		print_scores(ip, file_scores, set_num, scores, total_score);
+	}
 	
 	return total_score;
 }
@@ -164,11 +494,14 @@ double simulate_param_set (int set_num, input_params& ip, sim_data& sd, rates& r
 	todo:
 */
 int simulate_section (int set_num, input_params& ip, sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data mds[], char** dirnames_cons, double scores[]) {
+	trace_span span(sd.trace, TRACE_SECTION, set_num, sd.section, -1);
+	
 	// Prepare for this section's simulations
 	int num_passed = 0;
 	double temp_rates[2]; // Array of knockout rates so knockouts can be quickly applied and reverted
 	determine_start_end(sd);
 	reset_mutant_scores(ip, mds);
+	plan_checkpoint(ip, sd, rs, mds, sd.cp);
 	
 	// Simulate each mutant
 	for (int i = 0; i < ip.num_active_mutants; i++) {
@@ -187,7 +520,7 @@ int simulate_section (int set_num, input_params& ip, sim_data& sd, rates& rs, co
 		
 		if (current_score == mds[i].max_cond_scores[sd.section]) { // If the mutant passed, increment the passed counter
 			++num_passed;
-		} else if (ip.short_circuit) { // Exit both loops if the mutant failed and short circuiting is active
+		} else if (ip.short_circuit || sd.watch.predicted_fail) { // Exit both loops if the mutant failed and short circuiting is active or the set was predicted to fail
 			return num_passed;
 		}
 	}
@@ -195,6 +528,84 @@ int simulate_section (int set_num, input_params& ip, sim_data& sd, rates& rs, co
 	return num_passed;
 }
 
+/* simulate_ensemble simulates the parameter sets in the lanes of the given ensemble with every specified mutant
+	parameters:
+		ens: the worker's ensemble, whose lanes' rates have been set to the sets to simulate
+	returns: nothing
+	notes:
+		This mirrors simulate_param_set and simulate_section for posterior-only simulations, except that each mutant is simulated for every lane at once by ensemble_model.
+		Each lane's results are stored in the lane's set_results.
+	todo:
+*/
+void simulate_ensemble (ensemble& ens) {
+	input_params& ip = *(ens.ctxs[0].ip);
+	trace_buffer* trace = ens.ctxs[0].sd->trace; // Every lane records into the worker's timeline
+	trace_span span(trace, TRACE_ENSEMBLE, ens.set_nums[0], SEC_POST, -1);
+	double scores[ens.lanes][NUM_SECTIONS * NUM_MUTANTS];
+	int num_passed[ens.lanes];
+	
+	// Prepare for the simulations
+	for (int l = 0; l < ens.lanes; l++) {
+		ens.active[l] = ens.set_nums[l] != -1;
+		if (ens.active[l]) {
+			sim_context& ctx = ens.ctxs[l];
+			memset(scores[l], 0, sizeof(scores[l]));
+			num_passed[l] = 0;
+			begin_param_set(ens.set_nums[l], ctx.cl, ctx.baby_cl, ctx.mds);
+			ctx.sd->section = SEC_POST;
+			determine_start_end(*(ctx.sd));
+			reset_mutant_scores(ip, ctx.mds);
+		}
+	}
+	for (int l = 0; l < ens.lanes; l++) { // Every lane shares the same times and mutants, so any lane with a set can plan the checkpoint
+		if (ens.active[l]) {
+			plan_checkpoint(ip, *(ens.ctxs[l].sd), *(ens.ctxs[l].rs), ens.ctxs[l].mds, ens.cp);
+			break;
+		}
+	}
+	
+	// Simulate each mutant in every lane that has not been short circuited
+	for (int i = 0; i < ip.num_active_mutants; i++) {
+		trace_span span(trace, TRACE_MUTANT, ens.set_nums[0], SEC_POST, i);
+		for (int l = 0; l < ens.lanes; l++) {
+			if (ens.active[l]) {
+				sim_context& ctx = ens.ctxs[l];
+				mutant_sim_message(ctx.mds[i], SEC_POST);
+				store_original_rates(*(ctx.rs), ctx.mds[i], ens.temp_rates + 2 * l);
+				knockout(*(ctx.rs), ctx.mds[i], 0);
+				begin_mutant(ens.set_nums[l], *(ctx.sd), *(ctx.rs), ctx.cl, ctx.baby_cl, ctx.mds[i]);
+			}
+		}
+		
+		ensemble_model(ens, i);
+		
+		for (int l = 0; l < ens.lanes; l++) {
+			if (ens.active[l]) {
+				sim_context& ctx = ens.ctxs[l];
+				double current_score = end_mutant(ens.set_nums[l], ip, *(ctx.sd), ctx.cl, ctx.baby_cl, ctx.mds[i], ctx.mds[MUTANT_WILDTYPE].feat, ctx.dirnames_cons[i], ens.passed[l]);
+				scores[l][i] = current_score;
+				revert_knockout(*(ctx.rs), ctx.mds[i], ens.temp_rates + 2 * l);
+				
+				if (current_score == ctx.mds[i].max_cond_scores[SEC_POST]) { // If the mutant passed, increment the passed counter
+					++num_passed[l];
+				} else if (ip.short_circuit || ctx.sd->watch.predicted_fail) { // Stop simulating this lane if the mutant failed and short circuiting is active or the set was predicted to fail
+					ens.active[l] = false;
+				}
+			}
+		}
+	}
+	
+	// Total and print each lane's results
+	for (int l = 0; l < ens.lanes; l++) {
+		if (ens.set_nums[l] != -1) {
+			sim_context& ctx = ens.ctxs[l];
+			set_results* results = ens.results[l];
+			results->score = end_param_set(ens.set_nums[l], ip, *(ctx.sd), *(ctx.rs), ctx.mds, scores[l], num_passed[l], &(results->passed), &(results->scores), &(results->features), &(results->conditions));
+			memcpy(results->mutant_scores, scores[l], sizeof(scores[l]));
+		}
+	}
+}
+
 /* determine_start_end determines the start and end points for the current simulation based on the current section
 	parameters:
 		sd: the current simulation's data
@@ -212,6 +623,57 @@ void determine_start_end (sim_data& sd) {
 	}
 }
 
+/* plan_checkpoint determines which mutants simulate exactly like one another until the earliest of their inductions and so can share a checkpoint there
+	parameters:
+		ip: the program's input parameters
+		sd: the current simulation's data, whose section times have been determined
+		rs: the current simulation's rates
+		mds: the array of all mutant data
+		cp: the checkpoint to plan
+	returns: nothing
+	notes:
+		Until its induction a mutant differs from the others only by the knockouts applied before the simulation starts, so every mutant whose knockouts all wait for its induction (the overexpression and DAPT mutants) starts out the same. The wild type joins them when its induction changes nothing, i.e. when no rates are perturbed.
+		Only posterior simulations share checkpoints since every anterior simulation continues from its own mutant's posterior.
+	todo:
+*/
+void plan_checkpoint (input_params& ip, sim_data& sd, rates& rs, mutant_data mds[], checkpoint& cp) {
+	cp.time = sd.time_end;
+	cp.taken = false;
+	int num_sharing = 0;
+	for (int i = 0; i < ip.num_active_mutants; i++) {
+		int time_induction = induction_time(sd, rs, mds[i]);
+		cp.shares[i] = sd.section == SEC_POST && (mds[i].num_knockouts == 0 || mds[i].index == MUTANT_DAPT) && time_induction > sd.time_start;
+		if (cp.shares[i]) {
+			cp.time = MIN(cp.time, time_induction);
+			num_sharing++;
+		}
+	}
+	if (num_sharing < 2 || cp.time >= sd.time_end) { // A checkpoint is only worth storing if at least one mutant can continue from it
+		cp.time = 0;
+	}
+}
+
+/* induction_time calculates the first time step at which the given mutant's simulation differs from a simulation without any knockouts or overexpression
+	parameters:
+		sd: the current simulation's data
+		rs: the current simulation's rates
+		md: the mutant to check
+	returns: the time step model applies the mutant's induction at, or the end time if the induction changes nothing
+	notes:
+		This must match the induction test in model.
+	todo:
+*/
+int induction_time (sim_data& sd, rates& rs, mutant_data& md) {
+	bool perturbed = false;
+	for (int i = 0; i < NUM_RATES; i++) {
+		perturbed |= rs.factors_perturb[i] != 0;
+	}
+	if (md.num_knockouts == 0 && md.overexpression_rate == -1 && !perturbed) {
+		return sd.time_end;
+	}
+	return MIN(MAX(anterior_time(sd, md.induction) + 1, sd.time_start), sd.time_end);
+}
+
 /* reset_mutant_scores resets each mutant's condition scores
 	parameters:
 		ip: the program's input parameters
@@ -319,19 +781,43 @@ inline void revert_knockout (rates& rs, mutant_data& md, double orig_rates[]) {
 	returns: the score of the mutant
 	notes:
 	todo:
-		TODO Break up this enormous function.
 */
 double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data& md, features& wtfeat, char* dirname_cons, double temp_rates[2]) {
-	reset_seed(ip, sd); // Reset the seed for each mutant
+	trace_span span(sd.trace, TRACE_MUTANT, set_num, sd.section, md.index);
+	begin_mutant(set_num, sd, rs, cl, baby_cl, md);
+	
+	// Simulate the mutant, let the model run until the end of time, or until it fails
+	bool passed = model(sd, rs, cl, baby_cl, md, temp_rates);
+	
+	return end_mutant(set_num, ip, sd, cl, baby_cl, md, wtfeat, dirname_cons, passed);
+}
+
+/* begin_mutant prepares the given mutant's simulation
+	parameters:
+		set_num: the index of the parameter set to simulate
+		sd: the current simulation's data
+		rs: the current simulation's rates
+		cl: the concentration levels used for analysis and storage
+		baby_cl: the concentration levels used for simulating
+		md: the mutant to simulate
+	returns: nothing
+	notes:
+	todo:
+*/
+void begin_mutant (int set_num, sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data& md) {
+	reset_seed(sd, set_num); // Reset the seed for each mutant
 	cl.reset();
 	baby_cl.reset(); // Reset the concentrations levels used for simulating
-	perturb_rates_all(rs); // Perturb the rates of all starting cells
+	perturb_rates_all(sd, rs); // Perturb the rates of all starting cells
+	sd.lin.reset();
+	sd.stream.begin(sd.stream_features && sd.section == SEC_POST, sd.time_start / sd.big_gran, sd.time_end / sd.big_gran);
 	
 	// Initialize active record data and neighbor calculations
 	sd.initialize_active_data();// whether sd.section is POS or ANT, the width_current, active_start and active_end at the beginning of POS and ANT are the same: width_current= width_initial, active_start= width_initial - 1, active_end = 0
 	if (sd.height > 1) {
 		calc_neighbors_2d(sd);
 	}
+	sd.watch.begin(sd.stream.active && sd.predict_fail > 0 && md.index == MUTANT_WILDTYPE, sd.time_start / sd.big_gran, WATCH_PERIOD / (sd.step_size * sd.big_gran), sd.predict_fail, sd.height, sd.width_total, sd.width_current);
 	cl.active_start_record[0] = sd.active_start;//20160519: questionable
 	baby_cl.active_start_record[0] = sd.active_start;//20160519: questionable
 	
@@ -340,14 +826,37 @@ double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs,
 		copy_mutant_to_cl(sd, baby_cl, md);
 	}
 	
-	// Simulate the mutant, let the model run until the end of time, or until it fails
-	bool passed = model(sd, rs, cl, baby_cl, md, temp_rates);
-	
+	if (sd.prof != NULL) { // Count the mutant's phases towards it until end_mutant finishes
+		sd.prof->begin(sd.section, md.index);
+	}
+}
+
+/* end_mutant analyzes, prints, and scores the given mutant's simulation
+	parameters:
+		set_num: the index of the parameter set simulated
+		ip: the program's input parameters
+		sd: the current simulation's data
+		cl: the concentration levels used for analysis and storage
+		baby_cl: the concentration levels used for simulating
+		md: the mutant simulated
+		wtfeat: the oscillation features the wild type produced (or will if the mutant is the wild type)
+		dirname_cons: the directory path of the mutant
+		passed: whether or not the simulation ran until the end of time
+	returns: the score of the mutant
+	notes:
+	todo:
+		TODO Break up this enormous function.
+*/
+double end_mutant (int set_num, input_params& ip, sim_data& sd, con_levels& cl, con_levels& baby_cl, mutant_data& md, features& wtfeat, char* dirname_cons, bool passed) {
 	// Analyze the simulation's oscillation features
 	term->verbose() << term->blue << "    Analyzing " << term->reset << "oscillation features . . . ";
 	
 	if (sd.section == SEC_POST) { // Posterior analysis
-		osc_features_post(sd, ip, cl, md.feat, wtfeat, dirname_cons, sd.time_start / sd.big_gran, sd.time_end / sd.big_gran, set_num);
+		if (sd.stream.active) { // The features have been followed while simulating
+			osc_features_stream(sd, md.feat);
+		} else {
+			osc_features_post(sd, ip, cl, md.feat, wtfeat, dirname_cons, sd.time_start / sd.big_gran, sd.time_end / sd.big_gran, set_num);
+		}
 		term->verbose() << term->blue << "Done" << endl;
 	} else { // Anterior analysis
 		if (ip.ant_features) {
@@ -362,8 +871,12 @@ double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs,
 	}
 	
 	// Copy and print the appropriate data
-	print_concentrations(ip, sd, cl, md, dirname_cons, set_num);
+	{
+		phase_timer timer(sd, PHASE_PRINT_CONS);
+		print_concentrations(ip, sd, cl, md, dirname_cons, set_num);
+	}
 	if (sd.section == SEC_ANT) { // Print concentrations of columns of cells from posterior to anterior to a file if the user specified it
+		phase_timer timer(sd, PHASE_PRINT_CELLS);
 		print_cell_columns(ip, sd, cl, dirname_cons, set_num);
 	}
 	if (!sd.no_growth && sd.section == SEC_POST && !ip.short_circuit) { // Copy the concentration levels to the mutant data (if not short circuiting)
@@ -377,12 +890,16 @@ double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs,
 	term->verbose() << "  " << term->blue << "Done: " << term->reset << md.print_name << " scored ";
 	if (passed) {
 		md.secs_passed[sd.section] = true; // Mark that this mutant has passed this simulation. This is just general check to make sure that the parameter set we passed in gives us a simulation that is potentially valid (no centrations <0 or > max threshold)
-		score += md.tests[sd.section](md, wtfeat);//the test functions are previously specified when md was initialized in create_mutant_data in init.cpp
+		{
+			phase_timer timer(sd, PHASE_TESTS);
+			score += md.tests[sd.section](md, wtfeat);//the test functions are previously specified when md was initialized in create_mutant_data in init.cpp
+		}
 		double max_score = md.max_cond_scores[sd.section];
 		if (sd.section == SEC_ANT && (md.index == MUTANT_WILDTYPE)) { // The max score has to be adjusted for mutants which have a wave section
 			max_score += md.max_cond_scores[SEC_WAVE];
 			int time_full = anterior_time(sd, sd.steps_til_growth + (sd.width_total - sd.width_initial - 1) * sd.steps_split);
 			int wave_score=0;
+			phase_timer timer(sd, PHASE_WAVE_TESTS);
 			for (int time = time_full; time < sd.time_end; time += (sd.time_end - 1 - time_full) / 4) {
 				if (md.index == MUTANT_WILDTYPE){
 					wave_score = wave_testing(sd, cl, md, time, CMH1, sd.active_start);
@@ -403,11 +920,16 @@ double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs,
 			term->verbose() << term->red;
 		}
 		term->verbose() << score << " / " << max_score;
+	} else if (sd.watch.predicted_fail) {
+		term->verbose() << term->red << "0, predicted to fail without clear oscillations";
 	} else {
 		term->verbose() << term->red << "failed to complete the simulation";
 	}
 	
 	term->verbose() << term->reset << endl;
+	if (sd.prof != NULL) {
+		sd.prof->end();
+	}
 	return score;
 }
 
@@ -420,19 +942,35 @@ double simulate_mutant (int set_num, input_params& ip, sim_data& sd, rates& rs,
 		md: the mutant to simulate
 	returns: the score of the mutant
 	notes:
+		The simulation also stops early if the watchdog (see fail_watchdog) predicts the wild type to fail.
 	todo:
 */
 bool model (sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant_data& md, double temp_rates[2]) {
+	phase_timer timer(sd, PHASE_MODEL);
 	int steps_elapsed = 0; // Used to determine when to split a column of cells
-	update_rates(rs, sd.active_start); // Update the active rates based on the base rates, perturbations, and gradients. 
+	{
+		phase_timer timer(sd, PHASE_UPDATE_RATES);
+		update_rates(rs, sd.active_start); // Update the active rates based on the base rates, perturbations, and gradients. 
+	}
 	
 	// Iterate through each time step
 	bool passed = true;
-	int j; // Absolute time used by cl
-	int baby_j; // Cyclical time used by baby_cl
+	int j = sd.time_start; // Absolute time used by cl
+	int baby_j = 0; // Cyclical time used by baby_cl
 	bool past_induction = false; // Whether we've passed the point of induction of knockouts or overexpression
 	bool past_recovery = false; // Whether we've recovered from the knockouts or overexpression
-	for (j = sd.time_start, baby_j = 0; j < sd.time_end; j++, baby_j = WRAP(baby_j + 1, sd.max_delay_size)) {
+	
+	// Mutants that simulate like the one that stored the checkpoint continue from it, the first of them to get there stores it
+	bool shares_checkpoint = sd.cp.time > 0 && sd.cp.shares[md.index];
+	if (shares_checkpoint && sd.cp.taken) {
+		resume_checkpoint(sd, baby_cl, cl);
+		j = sd.cp.time;
+		baby_j = sd.cp.baby_time;
+	}
+	for (; j < sd.time_end; j++, baby_j = RING(baby_j + 1, sd.history_mask)) {
+		if (shares_checkpoint && !sd.cp.taken && j == sd.cp.time) {
+			take_checkpoint(sd, baby_cl, cl, baby_j);
+		}
 		
 		/* Any knockouts that are not time sensitive have been taken into account in rates.
 		 * The following part is used for time-sensitive knockouts.
@@ -440,7 +978,7 @@ bool model (sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant
 		 */
 		if (!past_induction && !past_recovery && (j  > anterior_time(sd,md.induction))) {
 			knockout(rs, md, 1); //knock down rates after the induction point. Induction is set 1 to be different from 0
-			perturb_rates_all(rs); //This is used for knockout the rate in the existing cells, may need modification
+			perturb_rates_all(sd, rs); //This is used for knockout the rate in the existing cells, may need modification
 			past_induction = true;
 		}
 		if (past_induction && (j + sd.steps_til_growth > md.recovery)) {
@@ -448,33 +986,40 @@ bool model (sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant
 			past_recovery = true;
 		}            
 
-		int time_prev = WRAP(baby_j - 1, sd.max_delay_size); // Time is cyclical, so time_prev may not be baby_j - 1
-		copy_records(sd, baby_cl, baby_j, time_prev); // Copy each cell's birth and parent so the records are accessible at every time step. Because each cell's birth and parent are the same througthout its lifetime
-		// This function actually loops through every cell, which is rather ineffient if we consider integrating this function into the below loop 20160519
+		int time_prev = RING(baby_j - 1, sd.history_mask); // Time is cyclical, so time_prev may not be baby_j - 1
 		
-		// Iterate through each extant cell: calculate the concentration of protein, mRNA and dimers in the each cell, put info into baby_cl
-		for (int k = 0; k < sd.cells_total; k++) {
-			if (sd.width_current == sd.width_total || k % sd.width_total <= sd.active_start) { // Compute only existing (i.e. already grown) cells 20160519: Is this really working for Posterior? I highly doubt it because active start at posterior is 1
-				// Calculate the cell indices at the start of each mRNA and protein's delay
-				int old_cells_mrna[NUM_INDICES];//6
-				int old_cells_protein[NUM_INDICES];
-				
-				//when in posterior, we only have to look at the cell itself if want to find which cell does this cell get the concentration from. 
-				calculate_delay_indices(sd, baby_cl, baby_j, j, k, rs.rates_active, old_cells_mrna, old_cells_protein);
+		// Posterior cells do not split, so every cell's concentrations can be calculated in batches
+		if (sd.section == SEC_POST) {
+			passed = step_cells(sd, rs.rates_active, baby_cl, sd.step_inputs, 1, &passed, time_prev, baby_j, md, past_induction, past_recovery);
+			if (!passed) {
+				return false;
+			}
+		} else { // Anterior cells split, so each cell is calculated on its own
+			sd.lin.record(j);
+			
+			// Calculate the cell indices at the start of each mRNA and protein's delay for every extant cell
+			calculate_delay_indices(sd, j, rs.rates_active);
+			
+			// Iterate through each extant cell: calculate the concentration of protein, mRNA and dimers in the each cell, put info into baby_cl
+			for (int k = 0; k < sd.cells_total; k++) {
+				if (sd.width_current == sd.width_total || k % sd.width_total <= sd.active_start) { // Compute only existing (i.e. already grown) cells 20160519: Is this really working for Posterior? I highly doubt it because active start at posterior is 1
+					int* old_cells_mrna = sd.delay_indices + k * 2 * NUM_INDICES;
+					int* old_cells_protein = old_cells_mrna + NUM_INDICES;
 				
-				// Perform biological calculations
-				st_context stc(time_prev, baby_j, k);
-				passed = protein_synthesis(sd, rs.rates_active, baby_cl, stc, old_cells_protein);
-				if (!passed){
-					return false;
-				}
-				passed = dimer_proteins(sd, rs.rates_active, baby_cl, stc);
-				if (!passed){
-					return false;
-				}
-				passed = mRNA_synthesis(sd, rs.rates_active, baby_cl, stc, old_cells_mrna, md, past_induction, past_recovery);
-				if (!passed){
-					return false;
+					// Perform biological calculations
+					st_context stc(time_prev, baby_j, k);
+					passed = protein_synthesis(sd, rs.rates_active, baby_cl, stc, old_cells_protein);
+					if (!passed){
+						return false;
+					}
+					passed = dimer_proteins(sd, rs.rates_active, baby_cl, stc);
+					if (!passed){
+						return false;
+					}
+					passed = mRNA_synthesis(sd, rs.rates_active, baby_cl, stc, old_cells_mrna, md, past_induction, past_recovery);
+					if (!passed){
+						return false;
+					}
 				}
 			}
 		}
@@ -487,7 +1032,8 @@ bool model (sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant
 		// Split cells periodically in anterior simulations
 		if (sd.section == SEC_ANT && (steps_elapsed % sd.steps_split) == 0) {
 			split(sd, rs, baby_cl, baby_j, j);
-			update_rates(rs, sd.active_start);//since split changes the rates of a column of cells that have just been born, we have to update rs.active_rates to take into account the gradients and knockouts
+			phase_timer timer(sd, PHASE_UPDATE_RATES);
+			update_rates_split(rs, sd.active_start, sd.active_start);//since split changes the rates of a column of cells that have just been born, we have to update rs.active_rates to take into account the gradients and knockouts
 			steps_elapsed = 0;
 		}
 		
@@ -498,41 +1044,241 @@ bool model (sim_data& sd, rates& rs, con_levels& cl, con_levels& baby_cl, mutant
 		
 		// Copy from the simulating cl to the analysis cl if it is the time to copy
 		if (j % sd.big_gran == 0) {
-			baby_to_cl(baby_cl, cl, baby_j, j / sd.big_gran);
+			baby_to_cl(sd, baby_cl, cl, baby_j, j / sd.big_gran);
+			if (sd.watch.check(sd.stream, j / sd.big_gran)) { // The wild type has stopped oscillating clearly, so it would fail anyway
+				return false;
+			}
 		}
 	}
 	
 	// Copy the last time step from the simulating cl to the analysis cl and mark where the simulating cl left off time-wise
-	baby_to_cl(baby_cl, cl, WRAP(baby_j - 1, sd.max_delay_size), (j - 1) / sd.big_gran);//20160519: why baby_j-1 and why j-1?
-	//sd.time_baby = baby_j;// 20160519: what is this doing--> seems like nothing--> 20160519: commented out
+	baby_to_cl(sd, baby_cl, cl, RING(baby_j - 1, sd.history_mask), (j - 1) / sd.big_gran);//20160519: why baby_j-1 and why j-1?
+	sd.time_baby = baby_j; // The next position in the ring, i.e. its oldest time step, which copy_cl_to_mutant unrolls from
 	
 	return true;
 }
 
-/* calculate_delay_indices calculates where the given cell was at the start of all mRNA and protein delays
+/* ensemble_model performs the biological functions of a posterior simulation for every active lane of the given ensemble at once
 	parameters:
-		sd: the current simulation's data
+		ens: the worker's ensemble, whose lanes have been prepared by begin_mutant
+		mutant: the index of the mutant to simulate
+	returns: nothing, but sets ens.passed for every lane to whether or not its simulation ran until the end of time
+	notes:
+		This mirrors model for posterior simulations. The lanes share every time, size, and mutant property, so the first lane's are used for all of them.
+		A lane that leaves the concentration bounds is masked off: its values are no longer copied to its analysis cl, exactly as if model had returned at that time step, while the remaining lanes continue.
+	todo:
+*/
+void ensemble_model (ensemble& ens, int mutant) {
+	sim_data& sd = *(ens.ctxs[0].sd);
+	mutant_data& md = ens.ctxs[0].mds[mutant];
+	con_levels& baby_cl = ens.baby_cl;
+	baby_cl.reset();
+	baby_cl.active_start_record[0] = sd.active_start;
+	
+	// Time the model with the simulation data of the first lane still simulating, whose profile begin_mutant has prepared for this mutant
+	sim_data* timed_sd = &sd;
+	for (int l = 0; l < ens.lanes; l++) {
+		if (ens.active[l]) {
+			timed_sd = ens.ctxs[l].sd;
+			break;
+		}
+	}
+	phase_timer timer(*timed_sd, PHASE_MODEL);
+	
+	// Interleave the active rates of every lane still simulating
+	int lanes_running = 0;
+	for (int l = 0; l < ens.lanes; l++) {
+		ens.passed[l] = ens.active[l];
+		if (ens.passed[l]) {
+			phase_timer timer(*timed_sd, PHASE_UPDATE_RATES);
+			update_rates(*(ens.ctxs[l].rs), sd.active_start);
+			lanes_running++;
+		}
+	}
+	interleave_rates(ens);
+	
+	// Iterate through each time step
+	int j = sd.time_start; // Absolute time used by cl
+	int baby_j = 0; // Cyclical time used by baby_cl
+	bool past_induction = false; // Whether we've passed the point of induction of knockouts or overexpression
+	bool past_recovery = false; // Whether we've recovered from the knockouts or overexpression
+	
+	// Continue from the checkpoint if it was stored by a mutant this one simulates like, with every lane that had failed by then still failed
+	bool shares_checkpoint = ens.cp.time > 0 && ens.cp.shares[mutant];
+	int checkpoint_steps = (ens.cp.time - 1) / sd.big_gran + 1; // The number of time steps of each lane's analysis cl before the checkpoint
+	if (shares_checkpoint && ens.cp.taken) {
+		copy_time_steps(ens.cp.baby_cl, baby_cl, baby_cl.time_steps);
+		lanes_running = 0;
+		for (int l = 0; l < ens.lanes; l++) {
+			if (ens.passed[l]) {
+				sim_data& lane_sd = *(ens.ctxs[l].sd);
+				if (lane_sd.stream.active) {
+					lane_sd.stream.copy_from(lane_sd.cp.stream);
+				} else {
+					copy_time_steps(lane_sd.cp.cl, ens.ctxs[l].cl, checkpoint_steps);
+				}
+				ens.passed[l] = ens.passed_checkpoint[l];
+				lanes_running += ens.passed[l];
+			}
+		}
+		j = ens.cp.time;
+		baby_j = ens.cp.baby_time;
+	}
+	for (; j < sd.time_end && lanes_running > 0; j++, baby_j = RING(baby_j + 1, sd.history_mask)) {
+		if (shares_checkpoint && !ens.cp.taken && j == ens.cp.time) {
+			copy_time_steps(baby_cl, ens.cp.baby_cl, baby_cl.time_steps);
+			for (int l = 0; l < ens.lanes; l++) {
+				ens.passed_checkpoint[l] = ens.passed[l];
+				if (ens.active[l]) { // Lanes that have failed still store the time steps they simulated
+					sim_data& lane_sd = *(ens.ctxs[l].sd);
+					if (lane_sd.stream.active) {
+						lane_sd.cp.stream.copy_from(lane_sd.stream);
+					} else {
+						copy_time_steps(ens.ctxs[l].cl, lane_sd.cp.cl, checkpoint_steps);
+					}
+				}
+			}
+			ens.cp.baby_time = baby_j;
+			ens.cp.taken = true;
+		}
+		if (!past_induction && !past_recovery && (j > anterior_time(sd, md.induction))) {
+			for (int l = 0; l < ens.lanes; l++) {
+				if (ens.passed[l]) {
+					knockout(*(ens.ctxs[l].rs), ens.ctxs[l].mds[mutant], 1);
+					perturb_rates_all(*(ens.ctxs[l].sd), *(ens.ctxs[l].rs));
+				}
+			}
+			past_induction = true;
+		}
+		if (past_induction && (j + sd.steps_til_growth > md.recovery)) {
+			for (int l = 0; l < ens.lanes; l++) {
+				if (ens.passed[l]) {
+					revert_knockout(*(ens.ctxs[l].rs), ens.ctxs[l].mds[mutant], ens.temp_rates + 2 * l);
+				}
+			}
+			past_recovery = true;
+		}
+		
+		int time_prev = RING(baby_j - 1, sd.history_mask);
+		step_cells(sd, ens.rs, baby_cl, ens.step_inputs, ens.lanes, ens.passed, time_prev, baby_j, md, past_induction, past_recovery);
+		baby_cl.active_start_record[baby_j] = sd.active_start;
+		baby_cl.active_end_record[baby_j] = sd.active_end;
+		
+		// Copy from the simulating cl to each lane's analysis cl if it is the time to copy
+		lanes_running = 0;
+		for (int l = 0; l < ens.lanes; l++) {
+			if (ens.passed[l]) {
+				lanes_running++;
+				if (j % sd.big_gran == 0) {
+					ensemble_to_cl(ens, l, baby_j, j / sd.big_gran);
+					if (ens.ctxs[l].sd->watch.check(ens.ctxs[l].sd->stream, j / sd.big_gran)) { // Masked off like a lane that left the concentration bounds
+						ens.passed[l] = false;
+					}
+				}
+			}
+		}
+	}
+	
+	// Copy the last time step to the analysis cl of each lane that ran until the end of time
+	for (int l = 0; l < ens.lanes; l++) {
+		if (ens.passed[l]) {
+			ensemble_to_cl(ens, l, RING(baby_j - 1, sd.history_mask), (j - 1) / sd.big_gran);
+			ens.ctxs[l].sd->time_baby = baby_j;
+		}
+	}
+}
+
+/* take_checkpoint stores the state of a simulation at the time step of the given simulation's checkpoint
+	parameters:
+		sd: the current simulation's data, whose checkpoint to store
+		baby_cl: the concentration levels used for simulating
+		cl: the concentration levels used for analysis and storage
+		baby_time: the cyclical time step the checkpoint is taken before
+	returns: nothing
+	notes:
+		If the simulation's features are streamed the stream is stored instead of cl's time steps.
+	todo:
+*/
+void take_checkpoint (sim_data& sd, con_levels& baby_cl, con_levels& cl, int baby_time) {
+	checkpoint& cp = sd.cp;
+	copy_time_steps(baby_cl, cp.baby_cl, baby_cl.time_steps);
+	if (sd.stream.active) {
+		cp.stream.copy_from(sd.stream);
+	} else {
+		copy_time_steps(cl, cp.cl, (cp.time - 1) / sd.big_gran + 1);
+	}
+	cp.baby_time = baby_time;
+	cp.taken = true;
+}
+
+/* resume_checkpoint restores the state of a simulation stored in the given simulation's checkpoint
+	parameters:
+		sd: the current simulation's data, whose checkpoint to restore
+		baby_cl: the concentration levels used for simulating
 		cl: the concentration levels used for analysis and storage
-		baby_time: the cyclical time used by baby_cl, the cl for simulating baby_j from model
+	returns: nothing
+	notes:
+		The simulation should continue at the checkpoint's time and cyclical time.
+	todo:
+*/
+void resume_checkpoint (sim_data& sd, con_levels& baby_cl, con_levels& cl) {
+	checkpoint& cp = sd.cp;
+	copy_time_steps(cp.baby_cl, baby_cl, baby_cl.time_steps);
+	if (sd.stream.active) {
+		sd.stream.copy_from(cp.stream);
+	} else {
+		copy_time_steps(cp.cl, cl, (cp.time - 1) / sd.big_gran + 1);
+	}
+}
+
+/* copy_time_steps copies the first time steps of every concentration level and active record from one con_levels struct to another
+	parameters:
+		from: the concentration levels to copy from
+		to: the concentration levels to copy to, initialized to fit the copy if necessary
+		time_steps: the number of time steps to copy
+	returns: nothing
+	notes:
+		Both structs must store the same number of cells. The rest of the destination is left as it was.
+	todo:
+*/
+void copy_time_steps (con_levels& from, con_levels& to, int time_steps) {
+	if (!to.initialized || to.first_level != from.first_level || to.num_con_levels < from.num_con_levels || to.time_steps < time_steps) {
+		to.initialize(from.first_level, from.num_con_levels, time_steps, from.cells, 0);
+	}
+	for (int i = from.first_level; i < from.num_con_levels; i++) { // The time steps of each concentration level are contiguous
+		memcpy(to.cons[i][0], from.cons[i][0], sizeof(double) * from.cons.row_size * time_steps);
+	}
+	memcpy(to.active_start_record, from.active_start_record, sizeof(int) * time_steps);
+	memcpy(to.active_end_record, from.active_end_record, sizeof(int) * time_steps);
+}
+
+/* calculate_delay_indices calculates where every extant cell was at the start of all mRNA and protein delays
+	parameters:
+		sd: the current simulation's data (the indices are stored in sd.delay_indices)
 		time: the absolute time used by cl, the cl for analysis j from model
-		cell_index: the current cell index k from model
 		active_rates: the active rates
-		old_cells_mrna: the indices of the cell's old positions for mRNA delays
-		old_cells_protein: the indices of the cell's old positions for protein delays
 	returns: nothing
 	notes:
+		Every cell's indices are calculated in one pass before any cell is simulated, so profiling times this phase once per time step rather than once per cell. The indices only depend on the lineage, which does not change while the cells are simulated.
 	todo:
 */
-void calculate_delay_indices (sim_data& sd, con_levels& cl, int baby_time, int time, int cell_index, double* active_rates[], int old_cells_mrna[], int old_cells_protein[]) {
-	if (sd.section == SEC_POST) { // Cells in posterior simulations do not split so the indices never change
-		for (int l = 0; l < NUM_INDICES; l++) {
-			old_cells_mrna[IMH1 + l] = cell_index;
-			old_cells_protein[IPH1 + l] = cell_index;
-		}
-	} else { // Cells in anterior simulations split so with long enough delays the cell must look to its parent for values, causing its effective index to change over time
-		for (int l = 0; l < NUM_INDICES; l++) {
-			old_cells_mrna[IMH1 + l] = index_with_splits(sd, cl, baby_time, time, cell_index, active_rates[RDELAYMH1 + l][cell_index]);
-			old_cells_protein[IPH1 + l] = index_with_splits(sd, cl, baby_time, time, cell_index, active_rates[RDELAYPH1 + l][cell_index]);
+void calculate_delay_indices (sim_data& sd, int time, double* active_rates[]) {
+	phase_timer timer(sd, PHASE_DELAY_INDICES);
+	for (int k = 0; k < sd.cells_total; k++) {
+		if (sd.width_current == sd.width_total || k % sd.width_total <= sd.active_start) { // Only existing cells are simulated (see model)
+			int* old_cells_mrna = sd.delay_indices + k * 2 * NUM_INDICES;
+			int* old_cells_protein = old_cells_mrna + NUM_INDICES;
+			if (sd.section == SEC_POST) { // Cells in posterior simulations do not split so the indices never change
+				for (int l = 0; l < NUM_INDICES; l++) {
+					old_cells_mrna[IMH1 + l] = k;
+					old_cells_protein[IPH1 + l] = k;
+				}
+			} else { // Cells in anterior simulations split so with long enough delays the cell must look to its parent for values, causing its effective index to change over time
+				for (int l = 0; l < NUM_INDICES; l++) {
+					old_cells_mrna[IMH1 + l] = index_with_splits(sd, time, k, active_rates[RDELAYMH1 + l][k]);
+					old_cells_protein[IPH1 + l] = index_with_splits(sd, time, k, active_rates[RDELAYPH1 + l][k]);
+				}
+			}
 		}
 	}
 }
@@ -540,21 +1286,20 @@ void calculate_delay_indices (sim_data& sd, con_levels& cl, int baby_time, int t
 /* index_with_splits calculates where the given cell was at the start of the given delay
 	parameters:
 		sd: the current simulation's data
-		cl: the concentration levels used for analysis and storage
-		baby_time: the cyclical time used by baby_cl, the cl for simulating
 		time: the absolute time used by cl, the cl for analysis
 		cell_index: the current cell index
 		delay: the amount of time (in minutes) the delay takes
 	returns: the index of the cell at the start of the delay
 	notes:
+		The cell's lineage table answers this directly however many splits the delay spans (see lineage).
 	todo:
 */
-inline int index_with_splits (sim_data& sd, con_levels& cl, int baby_time, int time, int cell_index, double delay) {
+inline int index_with_splits (sim_data& sd, int time, int cell_index, double delay) {
 	int delay_steps = delay / sd.step_size;
-	if (time - delay_steps < 0 || time - delay_steps >= cl.cons[BIRTH][baby_time][cell_index]) { // If the delay is longer than the simulation has run or shorter than the cell's age then return the cell's index
+	if (time - delay_steps < 0) { // If the delay is longer than the simulation has run then return the cell's index
 		return cell_index;
-	} else { // If the delay is not longer than the simulation has run but longer than the cell's age then move to the cell's parent and check again
-		return index_with_splits(sd, cl, baby_time, time, cl.cons[PARENT][baby_time][cell_index], delay);
+	} else { // Otherwise return the ancestor that held the cell's lineage at the start of the delay (the cell itself if the delay is shorter than the cell's age)
+		return sd.lin.ancestor(cell_index, time - delay_steps);
 	}
 }
 
@@ -618,6 +1363,7 @@ inline bool check_concentration_bound (con_levels& cl, int time, double max_con_
 	todo:
 */
 void split (sim_data& sd, rates& rs, con_levels& baby_cl, int baby_time, int time) {
+	phase_timer timer(sd, PHASE_SPLIT);
 	// Calculate the next active start and current width
 	int next_active_start = (sd.active_start + 1) % sd.width_total;
 	sd.width_current = MIN(sd.width_current + 1, sd.width_total);
@@ -635,7 +1381,7 @@ void split (sim_data& sd, rates& rs, con_levels& baby_cl, int baby_time, int tim
 		bool dup;
 		do { // Ensure each parent produces exactly one child
 			dup = false;
-			index = random_int(pair<int, int>(0, sd.height - 1));
+			index = random_int(sd.rng_split, pair<int, int>(0, sd.height - 1));
 			for (int j = 0; j < i; j++) {
 				if (index == parents[j]) {
 					dup = true;
@@ -648,40 +1394,33 @@ void split (sim_data& sd, rates& rs, con_levels& baby_cl, int baby_time, int tim
 	
 	// Transfer each new cell's parent concentration levels to the new cell 
 	
-	for (int i = 0; i < NUM_CON_LEVELS; i++) {
+	for (int i = MIN_CON_LEVEL; i <= MAX_CON_LEVEL; i++) {
 		for (int k = 0; k < sd.height; k++) {
 			//child cells column replace some other column that are old (previous time steps) in the baby_cl .
 			baby_cl.cons[i][baby_time][next_active_start + k * sd.width_total] = baby_cl.cons[i][baby_time][sd.active_start + parents[k] * sd.width_total];
 		}
 	}
 	
-	// Set each new cell's birth to the current time and store its assigned parent. 20160519: this can be integrated into the above loop for efficiency improvements 
+	// Log the split and give each new cell its parent's ancestors, one generation further back
+	lineage& lin = sd.lin;
+	lin.num_splits++;
+	lin.split_times[lin.num_splits] = time;
+	lin.split_columns[lin.num_splits] = next_active_start;
 	for (int k = 0; k < sd.height; k++) {
-		baby_cl.cons[BIRTH][baby_time][next_active_start + k * sd.width_total] = time;
-		baby_cl.cons[PARENT][baby_time][next_active_start + k * sd.width_total] = sd.active_start + parents[k] * sd.width_total;
-	}
-	
-	// Perturb the new cells and update the active record data
-	perturb_rates_column(sd, rs, next_active_start);
-	sd.active_start = next_active_start;//change the active_start.
-	sd.active_end = WRAP(sd.active_start - sd.width_current + 1, sd.width_total);///20160519: this can be a problem
-}
-
-/* copy_records copies each cell's birth and parent to the given time step
-	parameters:
-		sd: the current simulation's data
-		cl: the concentration levels used for analysis and storage
-		time: the time step
-		time_prev: the previous time step
-	returns: nothing
-	notes:
-	todo:
-*/
-inline void copy_records (sim_data& sd, con_levels& cl, int time, int time_prev) {
-	for (int k = 0; k < sd.cells_total; k++) {
-		cl.cons[BIRTH][time][k] = cl.cons[BIRTH][time_prev][k];
-		cl.cons[PARENT][time][k] = cl.cons[PARENT][time_prev][k];
+		int child = next_active_start + k * sd.width_total;
+		int parent = sd.active_start + parents[k] * sd.width_total;
+		lin.ancestors[child * lin.depth] = child;
+		for (int d = 1; d < lin.depth; d++) {
+			lin.ancestors[child * lin.depth + d] = lin.ancestors[parent * lin.depth + d - 1];
+		}
+		lin.births[child] = lin.num_splits;
 	}
+	lin.record(time);
+	
+	// Perturb the new cells and update the active record data
+	perturb_rates_column(sd, rs, next_active_start);
+	sd.active_start = next_active_start;//change the active_start.
+	sd.active_end = WRAP(sd.active_start - sd.width_current + 1, sd.width_total);///20160519: this can be a problem
 }
 
 /* update_rates updates the rates_active array in the given rates struct to account for perturbations and gradients.
@@ -697,20 +1436,7 @@ void update_rates (rates& rs, int active_start) {
 	if (rs.using_gradients) { // If at least one rate has a gradient
 		for (int i = 0; i < NUM_RATES; i++) {
 			if (rs.has_gradient[i]) { // If this rate has a gradient
-				// Iterate through every cell
-				for (int k = 0; k < rs.cells; k++) {
-					// Calculate the cell's index relative to the active start
-					int col = k % rs.width;
-					int gradient_index;
-					if (col <= active_start) {
-						gradient_index = active_start - col;
-					} else {
-						gradient_index = active_start + rs.width - col;
-					}
-					
-					// Set the cell's active rate to its perturbed rate modified by its position's gradient factor
-					rs.rates_active[i][k] = rs.rates_cell[i][k] * rs.factors_gradient[i][gradient_index];
-				}
+				update_gradient_rate(rs, i, active_start);
 			} else { // If this rate does not have a gradient then set every cell's active rate to its perturbed rate
 				for (int k = 0; k < rs.cells; k++) {
 					rs.rates_active[i][k] = rs.rates_cell[i][k];
@@ -724,6 +1450,83 @@ void update_rates (rates& rs, int active_start) {
 			}
 		}
 	}
+	rs.cells_changed = false;
+}
+
+/* update_rates_split updates the rates_active array in the given rates struct after a split, touching only what the split changed
+	parameters:
+		rs: the current simulation's rates
+		column: the column of cells the split produced
+		active_start: the column at the start of the posterior after the split
+	returns: nothing
+	notes:
+		A split perturbs only the new column's rates with perturbation factors and moves every gradient by one column, so only those rates of the new column and the rates with gradients are updated.
+		If rates_cell has changed elsewhere since the last update (e.g. every cell was perturbed again at an induction) every rate is updated instead.
+	todo:
+*/
+void update_rates_split (rates& rs, int column, int active_start) {
+	if (rs.cells_changed) {
+		update_rates(rs, active_start);
+		return;
+	}
+	for (int i = 0; i < NUM_RATES; i++) {
+		if (rs.has_gradient[i]) { // If this rate has a gradient then every cell's position in it has changed
+			update_gradient_rate(rs, i, active_start);
+		} else if (rs.factors_perturb[i] != 0) { // If this rate has a perturbation then only the new cells have changed
+			for (int k = column; k < rs.cells; k += rs.width) {
+				rs.rates_active[i][k] = rs.rates_cell[i][k];
+			}
+		}
+	}
+}
+
+/* update_gradient_rate sets every cell's active rate of the given rate to its perturbed rate modified by its position's gradient factor
+	parameters:
+		rs: the current simulation's rates
+		rate: the index of the rate, which must have a gradient
+		active_start: the column at the start of the posterior
+	returns: nothing
+	notes:
+		Every cell in a column is at the same position relative to the active start, so each column's gradient factor is looked up once.
+	todo:
+*/
+inline void update_gradient_rate (rates& rs, int rate, int active_start) {
+	for (int col = 0; col < rs.width; col++) {
+		// Calculate the column's index relative to the active start
+		int gradient_index;
+		if (col <= active_start) {
+			gradient_index = active_start - col;
+		} else {
+			gradient_index = active_start + rs.width - col;
+		}
+		
+		double factor = rs.factors_gradient[rate][gradient_index];
+		for (int k = col; k < rs.cells; k += rs.width) {
+			rs.rates_active[rate][k] = rs.rates_cell[rate][k] * factor;
+		}
+	}
+}
+
+/* interleave_rates copies the active rates of every lane of the given ensemble into its interleaved rates
+	parameters:
+		ens: the worker's ensemble
+	returns: nothing
+	notes:
+		Lanes that are not simulating get rates of 0.
+	todo:
+*/
+void interleave_rates (ensemble& ens) {
+	ens.rates_active.reset();
+	for (int l = 0; l < ens.lanes; l++) {
+		if (ens.passed[l]) {
+			rates& rs = *(ens.ctxs[l].rs);
+			for (int i = 0; i < NUM_RATES; i++) {
+				for (int k = 0; k < rs.cells; k++) {
+					ens.rs[i][k * ens.lanes + l] = rs.rates_active[i][k];
+				}
+			}
+		}
+	}
 }
 
 /* protein_synthesis calculates the concentrations of every protein for a given cell
@@ -825,7 +1628,7 @@ bool protein_synthesis (sim_data& sd, double** rs, con_levels& baby_cl, st_conte
 */
 inline void dim_int (di_args& a, di_indices dii) {
 	double** r = a.rs; //active_rates
-	double*** c = a.cl.cons; // concentration levels of all rate, at all time steps, of all cells
+	con_array& c = a.cl.cons; // concentration levels of all rate, at all time steps, of all cells
 	int tp = a.stc.time_prev; //prev_time_step	
 	int cell = a.stc.cell; // cell index
 	
@@ -846,12 +1649,12 @@ inline void dim_int (di_args& a, di_indices dii) {
 */
 inline bool con_protein_her (cp_args& a, cph_indices i) {
 	double** r = a.rs;	//active_rates
-	double*** c = a.cl.cons;	//(baby_cl)3D table of concentration of different things in diff cells at diff time_steps
+	con_array& c = a.cl.cons;	//(baby_cl)3D table of concentration of different things in diff cells at diff time_steps
 	int cell = a.stc.cell;		//index of the cell
 	int delay_steps = r[i.delay_protein][cell] / a.sd.step_size;	// this protein's rate of delay in the current cell (unit: steps)
 	int tc = a.stc.time_cur;	//current time step
 	int tp = a.stc.time_prev;	// previous time step
-	int td = WRAP(tc - delay_steps, a.sd.max_delay_size);	// how many steps are we in the delay cycle
+	int td = RING(tc - delay_steps, a.sd.history_mask);	// how many steps are we in the delay cycle
 	
 	// The part of the given Her protein concentration's differential equation that accounts for everything but heterodimers, whose influence is calculated in dim_int
 	double result =
@@ -881,12 +1684,12 @@ inline bool con_protein_her (cp_args& a, cph_indices i) {
 */
 inline bool con_protein_delta (cp_args& a, cpd_indices i) {
 	double** r = a.rs;
-	double*** c = a.cl.cons;
+	con_array& c = a.cl.cons;
 	int cell = a.stc.cell;
 	int delay_steps = r[i.delay_protein][cell] / a.sd.step_size;
 	int tc = a.stc.time_cur;
 	int tp = a.stc.time_prev;
-	int td = WRAP(tc - delay_steps, a.sd.max_delay_size);
+	int td = RING(tc - delay_steps, a.sd.history_mask);
 	
 	// The Delta protein concentration's differential equation (no dimerization occurs)
 	c[i.con_protein][tc][cell] =
@@ -979,7 +1782,7 @@ bool  dimer_proteins (sim_data& sd, double** rs, con_levels& baby_cl, st_context
 */
 inline bool con_dimer (cd_args& a, int con, int offset, cd_indices i) {
 	double** r = a.rs;	//active_rates
-	double*** c = a.cl.cons;	
+	con_array& c = a.cl.cons;	
 	int tc = a.stc.time_cur;	//current time step
 	int tp = a.stc.time_prev;	//prev ts
 	int cell = a.stc.cell;		//index of the cell 
@@ -1027,12 +1830,70 @@ bool mRNA_synthesis (sim_data& sd, double** rs, con_levels& baby_cl, st_context&
 	
 	// Calculate the influence of the given cell's neighbors (via Delta-Notch signaling)
 	double avg_delays[NUM_DD_INDICES]; // Averaged delays for each mRNA concentration caused by the given cell's neighbors' Delta protein concentrations
+	delta_averages(sd, baby_cl, 1, 0, stc.time_cur, delays, old_cells_mrna, avg_delays);
+	
+	// Calculate every mRNA concentration
+	for (int j = 0; j < NUM_INDICES; j++) {
+		double mtrans;
+		if (j == IMH13) { // her13 mRNA is not affected by dimers' repression
+			mtrans = rs[RMSH13][stc.cell];
+		} else {
+			double avgpd;
+			if (j >= IMH1 && j <= IMMESPB) {
+				avgpd = avg_delays[IMH1 + j];
+			} else { // delta mRNA is not affected by Delta-Notch signaling
+				avgpd = 0;
+			}
+
+			double oe = 0;
+			if (past_induction && !past_recovery && ((IMH1 + j) == md.overexpression_rate)) {
+				oe = md.overexpression_factor;
+			}
+			if (j == IMMESPA && sd.section == SEC_ANT) {
+				mtrans = transcription_mespa(rs, baby_cl, RING(stc.time_cur - delays[j], sd.history_mask), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
+				//cout<<"mespa"<<mtrans<<endl;
+			} else if (j == IMMESPB && sd.section == SEC_ANT) {
+				mtrans = transcription_mespb(rs, baby_cl, RING(stc.time_cur - delays[j], sd.history_mask), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
+				
+			} else {
+				mtrans = transcription(rs, baby_cl, RING(stc.time_cur - delays[j], sd.history_mask), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
+			}
+			
+		}
+		
+		// The current mRNA concentration's differential equation
+		baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] =
+			baby_cl.cons[CMH1 + j][stc.time_prev][stc.cell]
+			+ sd.step_size * (mtrans - rs[RMDH1 + j][stc.cell] * baby_cl.cons[CMH1 + j][stc.time_prev][stc.cell]);
+		if (baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] <0 || baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] > sd.max_con_thresh){
+			return false;
+		}
+	}
+	return true;
+}
+
+/* delta_averages calculates the average Delta protein concentration of a given cell's neighbors at the start of each Delta-dependent mRNA's delay
+	parameters:
+		sd: the current simulation's data
+		baby_cl: the concentration levels for simulating
+		lanes: the number of simulations interleaved in baby_cl (1 for a single simulation, see ensemble)
+		lane: the lane of the given cell
+		time_cur: the current time step
+		delays: an array of the cell's mRNA delays in time steps
+		old_cells_mrna: an array of the cell's indices at the start of each mRNA's delay
+		avg_delays: the array of NUM_DD_INDICES averages to fill
+	returns: nothing
+	notes:
+		This is the Delta-Notch signaling part of mRNA_synthesis, shared with gather_step_inputs.
+	todo:
+*/
+void delta_averages (sim_data& sd, con_levels& baby_cl, int lanes, int lane, int time_cur, int delays[], int old_cells_mrna[], double avg_delays[]) {
 	if (sd.height == 1) { // For 2-cell and 1D simulations
 		if (sd.width_current > 2) { // For 1D simulations
 			// Each cell has 2 neighbors so calculate where they and the active start and end were at the start of each mRNA concentration's delay
 			int neighbors[NUM_DD_INDICES][NEIGHBORS_1D];
-			for (int j = 0; j < NUM_INDICES; j++) {
-				int old_time = WRAP(stc.time_cur - delays[j], sd.max_delay_size);
+			for (int j = 0; j < NUM_DD_INDICES; j++) {
+				int old_time = RING(time_cur - delays[j], sd.history_mask);
 				int old_active_start = baby_cl.active_start_record[old_time];
 				int old_active_end = baby_cl.active_end_record[old_time];
 				calc_neighbors_1d(sd, neighbors[IMH1 + j], old_cells_mrna[IMH1 + j], old_active_start, old_active_end);
@@ -1042,20 +1903,20 @@ bool mRNA_synthesis (sim_data& sd, double** rs, con_levels& baby_cl, st_context&
 			for (int j = 0; j < NUM_DD_INDICES; j++) {
 				int* cells = neighbors[IMH1 + j];
 				int cell = old_cells_mrna[IMH1 + j];
-				int time = WRAP(stc.time_cur - delays[j], sd.max_delay_size);
+				int time = RING(time_cur - delays[j], sd.history_mask);
 
 				if (cell % sd.width_total == baby_cl.active_start_record[time]) {
-					avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][time][cells[0]];
+					avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][time][cells[0] * lanes + lane];
 				} else if (cell % sd.width_total == baby_cl.active_end_record[time]) {
-					avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][time][cells[1]];
+					avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][time][cells[1] * lanes + lane];
 				} else {
-					avg_delays[IMH1 + j] = (baby_cl.cons[CPDELTA][time][cells[0]] + baby_cl.cons[CPDELTA][time][cells[1]]) / 2;
+					avg_delays[IMH1 + j] = (baby_cl.cons[CPDELTA][time][cells[0] * lanes + lane] + baby_cl.cons[CPDELTA][time][cells[1] * lanes + lane]) / 2;
 				}
 			}
 		} else { // For 2-cell simulations
 			// Both cells have one neighbor each so no averaging is required
 			for (int j = 0; j < NUM_DD_INDICES; j++) {
-				avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][WRAP(stc.time_cur - delays[j], sd.max_delay_size)][1 - old_cells_mrna[IMH1 + j]];
+				avg_delays[IMH1 + j] = baby_cl.cons[CPDELTA][RING(time_cur - delays[j], sd.history_mask)][(1 - old_cells_mrna[IMH1 + j]) * lanes + lane];
 			}
 		}
 	} else { // For 2D simulations
@@ -1071,58 +1932,336 @@ bool mRNA_synthesis (sim_data& sd, double** rs, con_levels& baby_cl, st_context&
 		for (int j = 0; j < NUM_DD_INDICES; j++) {
 			int* cells = neighbors[IMH1 + j];
 			int cell = old_cells_mrna[IMH1 + j];
-			int time = WRAP(stc.time_cur - delays[j], sd.max_delay_size);
-			double* cur_cons = baby_cl.cons[CPDELTA][time];
+			int time = RING(time_cur - delays[j], sd.history_mask);
+			double* cur_cons = baby_cl.cons[CPDELTA][time] + lane; // Neighbors of the same lane are lanes doubles apart
 			double sum;
 			if (cell % sd.width_total == baby_cl.active_start_record[time]) {
-				sum = (cur_cons[cells[0]] + cur_cons[cells[3]] + cur_cons[cells[4]] + cur_cons[cells[5]]) / 4;
+				sum = (cur_cons[cells[0] * lanes] + cur_cons[cells[3] * lanes] + cur_cons[cells[4] * lanes] + cur_cons[cells[5] * lanes]) / 4;
 			} else if (cell % sd.width_total == baby_cl.active_start_record[time]) {
-				sum = (cur_cons[cells[0]] + cur_cons[cells[1]] + cur_cons[cells[2]] + cur_cons[cells[3]]) / 4;
+				sum = (cur_cons[cells[0] * lanes] + cur_cons[cells[1] * lanes] + cur_cons[cells[2] * lanes] + cur_cons[cells[3] * lanes]) / 4;
 			} else {
-				sum = (cur_cons[cells[0]] + cur_cons[cells[1]] + cur_cons[cells[2]] + cur_cons[cells[3]] + cur_cons[cells[4]] + cur_cons[cells[5]]) / 6;
+				sum = (cur_cons[cells[0] * lanes] + cur_cons[cells[1] * lanes] + cur_cons[cells[2] * lanes] + cur_cons[cells[3] * lanes] + cur_cons[cells[4] * lanes] + cur_cons[cells[5] * lanes]) / 6;
 			}
 			avg_delays[IMH1 + j] = sum;
 		}
 	}
-	
-	// Calculate every mRNA concentration
+}
+
+/* step_cells calculates every concentration of every active cell for one time step of a posterior simulation with the batched kernels
+	parameters:
+		sd: the current simulation's data
+		rs: the active rates
+		baby_cl: the concentration levels for simulating
+		inputs: the concentration levels to gather each cell's step inputs in
+		lanes: the number of simulations interleaved in rs, baby_cl, and inputs (1 for a single simulation, see ensemble)
+		passed: whether or not each lane is still within the concentration bounds, set to false for every lane that leaves them
+		time_prev: the previous time step
+		time_cur: the current time step
+		md: the currently simulating mutant's data
+		past_induction: whether or not the mutant's induction has passed
+		past_recovery: whether or not the mutant has recovered from its induction
+	returns: true if any lane is still within the concentration bounds, false otherwise
+	notes:
+		This produces the same concentrations as calling protein_synthesis, dimer_proteins, and mRNA_synthesis for each cell, but updates simd_vector::width cells at once.
+		Each row of active cells is processed in blocks of simd_vector::width cells and whatever cells are left over are processed one at a time.
+		Cells in posterior simulations do not split, so every cell's delayed values come from the cell itself. Anterior simulations use the per-cell functions.
+		Cells are independent within a time step unless a delay is shorter than one time step, in which case a cell reads its neighbors' current values as if they had all already been calculated.
+		Lanes that have already failed are still calculated but their failures are ignored. Once every lane has failed the time step is abandoned.
+	todo:
+*/
+bool step_cells (sim_data& sd, double** rs, con_levels& baby_cl, con_levels& inputs, int lanes, bool passed[], int time_prev, int time_cur, mutant_data& md, bool past_induction, bool past_recovery) {
+	// Overexpression applies to every cell alike
+	double oe[NUM_INDICES];
 	for (int j = 0; j < NUM_INDICES; j++) {
-		double mtrans;
-		if (j == IMH13) { // her13 mRNA is not affected by dimers' repression
-			mtrans = rs[RMSH13][stc.cell];
-		} else {
-			double avgpd;
-			if (j >= IMH1 && j <= IMMESPB) {
-				avgpd = avg_delays[IMH1 + j];
-			} else { // delta mRNA is not affected by Delta-Notch signaling
-				avgpd = 0;
+		oe[j] = 0;
+		if (past_induction && !past_recovery && ((IMH1 + j) == md.overexpression_rate)) {
+			oe[j] = md.overexpression_factor;
+		}
+	}
+	int lanes_running = 0;
+	for (int l = 0; l < lanes; l++) {
+		lanes_running += passed[l];
+	}
+	
+	sb_args sba(sd, rs, baby_cl, inputs, time_prev, time_cur, oe);
+	int rows = sd.width_current == sd.width_total ? 1 : sd.height; // Every cell is active once the PSM is fully grown, otherwise only the columns up to the active start in each row are
+	int row_cells = sd.width_current == sd.width_total ? sd.cells_total : sd.active_start + 1;
+	for (int y = 0; y < rows; y++) {
+		int first = y * sd.width_total;
+		int last = first + row_cells;
+		gather_step_inputs(sd, rs, baby_cl, inputs, lanes, time_cur, first, last);
+		
+		// Calculate as many full blocks as fit and then the leftover cells (every lane of a cell is stored next to each other)
+		int k;
+		for (k = first * lanes; k + simd_vector::width <= last * lanes; k += simd_vector::width) {
+			sba.cell = k;
+			int failed = simd_vector::bits(step_block<simd_vector>(sba));
+			for (int b = 0; failed != 0; b++, failed >>= 1) {
+				if ((failed & 1) && passed[(k + b) % lanes]) {
+					passed[(k + b) % lanes] = false;
+					if (--lanes_running == 0) {
+						return false;
+					}
+				}
+			}
+		}
+		for (; k < last * lanes; k++) {
+			sba.cell = k;
+			if (simd_scalar::any(step_block<simd_scalar>(sba)) && passed[k % lanes]) {
+				passed[k % lanes] = false;
+				if (--lanes_running == 0) {
+					return false;
+				}
 			}
+		}
+	}
+	return true;
+}
 
-			double oe = 0;
-			if (past_induction && !past_recovery && ((IMH1 + j) == md.overexpression_rate)) {
-				oe = md.overexpression_factor;
+/* gather_step_inputs stores the delayed and neighbor-averaged values the given cells read in the current time step in the given inputs
+	parameters:
+		sd: the current simulation's data
+		rs: the active rates
+		baby_cl: the concentration levels for simulating
+		inputs: the concentration levels to store the step inputs in
+		lanes: the number of simulations interleaved in rs, baby_cl, and inputs
+		time_cur: the current time step
+		first: the first cell to gather for
+		last: one past the last cell to gather for
+	returns: nothing
+	notes:
+		Every cell's delays differ, so these reads cannot be vectorized like the rest of the time step. Gathering them first leaves the batched kernels with only contiguous loads.
+		Inputs are gathered for every lane of every given cell.
+	todo:
+*/
+void gather_step_inputs (sim_data& sd, double** rs, con_levels& baby_cl, con_levels& inputs, int lanes, int time_cur, int first, int last) {
+	con_array& c = baby_cl.cons;
+	con_array& in = inputs.cons;
+	for (int cell = first; cell < last; cell++) {
+		for (int l = 0; l < lanes; l++) {
+			int k = cell * lanes + l;
+			int delays[NUM_INDICES];
+			int old_cells[NUM_INDICES];
+			for (int j = 0; j < NUM_INDICES; j++) {
+				delays[j] = rs[RDELAYMH1 + j][k] / sd.step_size;
+				old_cells[j] = cell;
 			}
-			if (j == IMMESPA && sd.section == SEC_ANT) {
-				mtrans = transcription_mespa(rs, baby_cl, WRAP(stc.time_cur - delays[j], sd.max_delay_size), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
-				//cout<<"mespa"<<mtrans<<endl;
-			} else if (j == IMMESPB && sd.section == SEC_ANT) {
-				mtrans = transcription_mespb(rs, baby_cl, WRAP(stc.time_cur - delays[j], sd.max_delay_size), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
-				
-			} else {
-				mtrans = transcription(rs, baby_cl, WRAP(stc.time_cur - delays[j], sd.max_delay_size), old_cells_mrna[IMH1 + j], avgpd, rs[RMSH1 + j][stc.cell], oe, sd.section);
+			
+			// Dimers repressing transcription and the neighbors' Delta at the start of each mRNA's delay
+			for (int j = 0; j < NUM_INDICES; j++) {
+				int td = RING(time_cur - delays[j], sd.history_mask);
+				in[SI_H1H1 + j][0][k] = c[CPH1H1][td][k];
+				in[SI_H7H13 + j][0][k] = c[CPH7H13][td][k];
+			}
+			double avg_delays[NUM_DD_INDICES];
+			delta_averages(sd, baby_cl, lanes, l, time_cur, delays, old_cells, avg_delays);
+			for (int j = 0; j < NUM_DD_INDICES; j++) {
+				in[SI_DELTA + j][0][k] = avg_delays[j];
 			}
 			
+			// mRNA at the start of each protein's delay (MespA and MespB are only translated in the anterior)
+			for (int j = 0; j < NUM_INDICES; j++) {
+				if (j != IPMESPA && j != IPMESPB) {
+					int td = RING(time_cur - (int)(rs[RDELAYPH1 + j][k] / sd.step_size), sd.history_mask);
+					in[SI_MRNA + j][0][k] = c[CMH1 + j][td][k];
+				}
+			}
 		}
-		
-		// The current mRNA concentration's differential equation
-		baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] =
-			baby_cl.cons[CMH1 + j][stc.time_prev][stc.cell]
-			+ sd.step_size * (mtrans - rs[RMDH1 + j][stc.cell] * baby_cl.cons[CMH1 + j][stc.time_prev][stc.cell]);
-		if (baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] <0 || baby_cl.cons[CMH1 + j][stc.time_cur][stc.cell] > sd.max_con_thresh){
-			return false;
+	}
+}
+
+/* step_block calculates every concentration of one block of cells for one time step
+	parameters:
+		a: a struct containing the arguments needed, whose cell is the first cell of the block
+	returns: a mask of the cells with a concentration less than 0 or greater than sd.max_con_thresh
+	notes:
+		V is simd_vector or simd_scalar and determines how many cells the block contains.
+		The calculations follow protein_synthesis, dimer_proteins, and mRNA_synthesis for the posterior step by step, in the same order, so the results match the per-cell functions exactly.
+	todo:
+*/
+template <class V> inline typename V::mask step_block (sb_args& a) {
+	typedef typename V::vec vec;
+	typename V::mask failed = V::mask_none();
+	
+	// Proteins (see protein_synthesis)
+	vec de = V::set1(0);
+	de = block_dim_int<V>(a, de, di_indices(CPH1, CPH7,  CPH1H7,  RDAH1H7,  RDDIH1H7,  IH1));
+	de = block_dim_int<V>(a, de, di_indices(CPH1, CPH13, CPH1H13, RDAH1H13, RDDIH1H13, IH1));
+	failed = V::mask_or(failed, block_protein_her<V>(a, de, cph_indices(CMH1, CPH1, CPH1H1, RPSH1, RPDH1, RDAH1H1, RDDIH1H1, RDELAYPH1, IH1, IPH1)));
+	de = V::set1(0);
+	de = block_dim_int<V>(a, de, di_indices(CPH7, CPH1,  CPH1H7,  RDAH1H7,  RDDIH1H7,  IH7));
+	de = block_dim_int<V>(a, de, di_indices(CPH7, CPH13, CPH7H13, RDAH7H13, RDDIH7H13, IH7));
+	failed = V::mask_or(failed, block_protein_her<V>(a, de, cph_indices(CMH7, CPH7, CPH7H7, RPSH7, RPDH7, RDAH7H7, RDDIH7H7, RDELAYPH7, IH7, IPH7)));
+	de = V::set1(0);
+	de = block_dim_int<V>(a, de, di_indices(CPH13, CPH1,  CPH1H13,  RDAH1H13,  RDDIH1H13,  IH13));
+	de = block_dim_int<V>(a, de, di_indices(CPH13, CPH7,  CPH7H13,  RDAH7H13,  RDDIH7H13,  IH13));
+	failed = V::mask_or(failed, block_protein_her<V>(a, de, cph_indices(CMH13, CPH13, CPH13H13, RPSH13, RPDH13, RDAH13H13, RDDIH13H13, RDELAYPH13, IH13, IPH13)));
+	failed = V::mask_or(failed, block_protein_delta<V>(a, cpd_indices(CMDELTA, CPDELTA, RPSDELTA, RPDDELTA, RDELAYPDELTA, IPDELTA)));
+	
+	// Dimers (see dimer_proteins)
+	for (int i = CPH1H1, j = 0; i <= CPH1H13; i++, j++) {
+		failed = V::mask_or(failed, block_dimer<V>(a, i, j, cd_indices(CPH1, RDAH1H1, RDDIH1H1, RDDGH1H1)));
+	}
+	for (int i = CPH7H7, j = 0; i <= CPH7H13; i++, j++) {
+		failed = V::mask_or(failed, block_dimer<V>(a, i, j, cd_indices(CPH7, RDAH7H7, RDDIH7H7, RDDGH7H7)));
+	}
+	failed = V::mask_or(failed, block_dimer<V>(a, CPH13H13, 0, cd_indices(CPH13, RDAH13H13, RDDIH13H13, RDDGH13H13)));
+	
+	// mRNAs (see mRNA_synthesis)
+	failed = V::mask_or(failed, block_mrna<V>(a));
+	return failed;
+}
+
+/* block_dim_int calculates the dimer interactions for a given protein for a block of cells (see dim_int)
+	parameters:
+		a: a struct containing the arguments needed
+		de: the dimer effects accumulated so far
+		dii: a struct containing the indices needed
+	returns: the dimer effects including this interaction
+	notes:
+	todo:
+*/
+template <class V> inline typename V::vec block_dim_int (sb_args& a, typename V::vec de, di_indices dii) {
+	double** r = a.rs;
+	con_array& c = a.cl.cons;
+	int tp = a.time_prev;
+	int k = a.cell;
+	
+	return de
+		- V::load(r[dii.rate_association] + k) * V::load(c[dii.con_protein_self][tp] + k) * V::load(c[dii.con_protein_other][tp] + k)
+		+ V::load(r[dii.rate_dissociation] + k) * V::load(c[dii.con_dimer][tp] + k);
+}
+
+/* block_protein_her calculates the protein concentration of the given Her gene for a block of cells (see con_protein_her)
+	parameters:
+		a: a struct containing the arguments needed
+		de: the protein's dimer effects calculated by block_dim_int
+		i: a struct containing the indices needed
+	returns: a mask of the cells whose concentration is out of bounds
+	notes:
+	todo:
+*/
+template <class V> inline typename V::mask block_protein_her (sb_args& a, typename V::vec de, cph_indices i) {
+	typedef typename V::vec vec;
+	double** r = a.rs;
+	con_array& c = a.cl.cons;
+	int tp = a.time_prev;
+	int k = a.cell;
+	vec two = V::set1(2);
+	vec protein = V::load(c[i.con_protein][tp] + k);
+	
+	vec result =
+		protein
+		+ V::set1(a.sd.step_size) * (V::load(r[i.rate_synthesis] + k) * V::load(a.inputs.cons[SI_MRNA + i.old_cell][0] + k)
+		- V::load(r[i.rate_degradation] + k) * protein
+		- two * V::load(r[i.rate_association] + k) * (protein * protein)
+		+ two * V::load(r[i.rate_dissociation] + k) * V::load(c[i.con_dimer][tp] + k)
+		+ de);
+	
+	V::store(c[i.con_protein][a.time_cur] + k, result);
+	return V::out_of_bounds(result, V::set1(a.sd.max_con_thresh));
+}
+
+/* block_protein_delta calculates the protein concentration of the given Delta gene for a block of cells (see con_protein_delta)
+	parameters:
+		a: a struct containing the arguments needed
+		i: a struct containing the indices needed
+	returns: a mask of the cells whose concentration is out of bounds
+	notes:
+	todo:
+*/
+template <class V> inline typename V::mask block_protein_delta (sb_args& a, cpd_indices i) {
+	typedef typename V::vec vec;
+	double** r = a.rs;
+	con_array& c = a.cl.cons;
+	int k = a.cell;
+	vec protein = V::load(c[i.con_protein][a.time_prev] + k);
+	
+	vec result =
+		protein
+		+ V::set1(a.sd.step_size) * (V::load(r[i.rate_synthesis] + k) * V::load(a.inputs.cons[SI_MRNA + i.old_cell][0] + k)
+		- V::load(r[i.rate_degradation] + k) * protein);
+	
+	V::store(c[i.con_protein][a.time_cur] + k, result);
+	return V::out_of_bounds(result, V::set1(a.sd.max_con_thresh));
+}
+
+/* block_dimer calculates the given dimer's concentration for a block of cells (see con_dimer)
+	parameters:
+		a: a struct containing the arguments needed
+		con: the index of the dimer
+		offset: an index offset for reusability purposes
+		i: a struct containing the indices needed
+	returns: a mask of the cells whose concentration is out of bounds
+	notes:
+	todo:
+*/
+template <class V> inline typename V::mask block_dimer (sb_args& a, int con, int offset, cd_indices i) {
+	typedef typename V::vec vec;
+	double** r = a.rs;
+	con_array& c = a.cl.cons;
+	int tp = a.time_prev;
+	int k = a.cell;
+	int con_offset = offset;
+	if (i.con_protein == CPH1 && offset == 2) {
+		con_offset = 4;
+	}
+	if (i.con_protein == CPH7 && offset == 1) {
+		con_offset = 3;
+	}
+	vec dimer = V::load(c[con][tp] + k);
+	
+	vec result =
+		dimer
+		+ V::set1(a.sd.step_size) * (V::load(r[i.rate_association + offset] + k) * V::load(c[i.con_protein][tp] + k) * V::load(c[i.con_protein + con_offset][tp] + k)
+			- V::load(r[i.rate_dissociation + offset] + k) * dimer
+			- V::load(r[i.rate_degradation + offset] + k) * dimer);
+	
+	V::store(c[con][a.time_cur] + k, result);
+	return V::out_of_bounds(result, V::set1(a.sd.max_con_thresh));
+}
+
+/* block_mrna calculates the concentrations of every mRNA for a block of cells (see mRNA_synthesis and transcription)
+	parameters:
+		a: a struct containing the arguments needed
+	returns: a mask of the cells with a concentration out of bounds
+	notes:
+		The MespA-MespA, MespA-MespB, and MespB-MespB repression terms of transcription are always 0 and are left out.
+	todo:
+*/
+template <class V> inline typename V::mask block_mrna (sb_args& a) {
+	typedef typename V::vec vec;
+	double** r = a.rs;
+	con_array& c = a.cl.cons;
+	con_array& in = a.inputs.cons;
+	int tp = a.time_prev;
+	int k = a.cell;
+	vec one = V::set1(1);
+	vec step = V::set1(a.sd.step_size);
+	vec max = V::set1(a.sd.max_con_thresh);
+	typename V::mask failed = V::mask_none();
+	
+	for (int j = 0; j < NUM_INDICES; j++) {
+		vec mtrans;
+		if (j == IMH13) { // her13 mRNA is not affected by dimers' repression
+			mtrans = V::load(r[RMSH13] + k);
+		} else {
+			vec avgpd = j <= IMMESPB ? V::load(in[SI_DELTA + j][0] + k) : V::set1(0); // delta mRNA is not affected by Delta-Notch signaling
+			vec crit_h1h1 = V::load(r[RCRITPH1H1] + k);
+			vec crit_h7h13 = V::load(r[RCRITPH7H13] + k);
+			vec crit_delta = V::load(r[RCRITPDELTA] + k);
+			vec th1h1 = V::zero_where_zero(V::load(in[SI_H1H1 + j][0] + k) / crit_h1h1, crit_h1h1);
+			vec th7h13 = V::zero_where_zero(V::load(in[SI_H7H13 + j][0] + k) / crit_h7h13, crit_h7h13);
+			vec tdelta = V::zero_where_zero(avgpd / crit_delta, crit_delta);
+			mtrans = V::load(r[RMSH1 + j] + k) * (V::set1(a.oe[j]) + (one + tdelta) / (one + tdelta + th1h1 * th1h1 + th7h13 * th7h13));
 		}
+		
+		vec mrna = V::load(c[CMH1 + j][tp] + k);
+		vec result = mrna + step * (mtrans - V::load(r[RMDH1 + j] + k) * mrna);
+		V::store(c[CMH1 + j][a.time_cur] + k, result);
+		failed = V::mask_or(failed, V::out_of_bounds(result, max));
 	}
-	return true;
+	return failed;
 }
 
 /* transcription calculates mRNA transcription, taking into account the effects of dimer repression
@@ -1290,12 +2429,14 @@ void calc_neighbors_2d (sim_data& sd) {
 
 /* perturb_rates_all perturbs every rate for every cell
 	parameters:
+		sd: the current simulation's data
 		rs: the current simulation's rates
 	returns: nothing
 	notes:
 	todo:
 */
-void perturb_rates_all (rates& rs) {
+void perturb_rates_all (sim_data& sd, rates& rs) {
+	rs.cells_changed = true;
 	for (int i = 0; i < NUM_RATES; i++) {
 		if (rs.factors_perturb[i] == 0) { // If the current rate has no perturbation factor then set every cell's rate to the base rate
 			for (int j = 0; j < rs.cells; j++) {
@@ -1303,7 +2444,7 @@ void perturb_rates_all (rates& rs) {
 			}
 		} else { // If the current rate has a perturbation factor then set every cell's rate to a randomly perturbed positive or negative variation of the base with a maximum perturbation up to the rate's perturbation factor
 			for (int j = 0; j < rs.cells; j++) {
-				rs.rates_cell[i][j] = rs.rates_base[i] * random_perturbation(rs.factors_perturb[i]);
+				rs.rates_cell[i][j] = rs.rates_base[i] * random_perturbation(sd.rng_perturb, rs.factors_perturb[i]);
 			}
 		}
 	}
@@ -1322,7 +2463,7 @@ void perturb_rates_column (sim_data& sd, rates& rs, int column) {
 	for (int i = 0; i < NUM_RATES; i++) {
 		if (rs.factors_perturb[i] != 0) { // Alter only rates with a perturbation factor
 			for (int j = 0; j < sd.height; j++) {
-				rs.rates_cell[i][j * sd.width_total + column] = rs.rates_base[i] * random_perturbation(rs.factors_perturb[i]);
+				rs.rates_cell[i][j * sd.width_total + column] = rs.rates_base[i] * random_perturbation(sd.rng_perturb, rs.factors_perturb[i]);
 			}
 		}
 	}
@@ -1330,27 +2471,37 @@ void perturb_rates_column (sim_data& sd, rates& rs, int column) {
 
 /* random_perturbation calculates a random perturbation with a maximum absolute change up to the given perturbation factor
 	parameters:
+		rng: the random number generator to draw from
 		perturb: the perturbation factor
 	returns: the random perturbation
 	notes:
 	todo:
 */
-inline double random_perturbation (double perturb) {
-	return random_double(pair<double, double>(1 - perturb, 1 + perturb));
+inline double random_perturbation (rng_state& rng, double perturb) {
+	return random_double(rng, pair<double, double>(1 - perturb, 1 + perturb));
 }
 
 /* baby_to_cl copies the data from the given time step in baby_cl to cl
 	parameters:
+		sd: the current simulation's data
 		baby_cl: the concentration levels for simulating
 		cl: the concentration levels for analysis and storage
 		baby_time: the time step to access baby_cl with
 		time: the time step to access cl with
 	returns: nothing
 	notes:
+		If the simulation's features are streamed the time step is given to the stream instead of cl.
 	todo:
 */
-void baby_to_cl (con_levels& baby_cl, con_levels& cl, int baby_time, int time) {
-	for (int i = 0; i < cl.num_con_levels; i++) {
+void baby_to_cl (sim_data& sd, con_levels& baby_cl, con_levels& cl, int baby_time, int time) {
+	if (sd.stream.active) {
+		double* row = sd.stream.give(time);
+		for (int i = 0; i < NUM_STREAM_CONS; i++) {
+			memcpy(row + i * sd.stream.cells, baby_cl.cons[sd.stream.cons[i]][baby_time], sizeof(double) * sd.stream.cells);
+		}
+		return;
+	}
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
 		for (int k = 0; k < cl.cells; k++) {
 			cl.cons[i][time][k] = baby_cl.cons[i][baby_time][k];
 		}
@@ -1359,6 +2510,42 @@ void baby_to_cl (con_levels& baby_cl, con_levels& cl, int baby_time, int time) {
 	cl.active_end_record[time] = baby_cl.active_end_record[baby_time];
 }
 
+/* ensemble_to_cl copies the given lane's concentrations from the given ensemble's interleaved cl to the lane's analysis cl
+	parameters:
+		ens: the worker's ensemble
+		lane: the lane to copy
+		baby_time: the time step to copy from the interleaved cl
+		time: the time step to copy to in the lane's cl
+	returns: nothing
+	notes:
+		This is baby_to_cl for one lane of an ensemble.
+	todo:
+*/
+void ensemble_to_cl (ensemble& ens, int lane, int baby_time, int time) {
+	con_levels& cl = ens.ctxs[lane].cl;
+	feature_stream& fs = ens.ctxs[lane].sd->stream;
+	if (fs.active) {
+		double* row = fs.give(time);
+		for (int i = 0; i < NUM_STREAM_CONS; i++) {
+			double* from = ens.baby_cl.cons[fs.cons[i]][baby_time] + lane;
+			double* to = row + i * fs.cells;
+			for (int k = 0; k < fs.cells; k++) {
+				to[k] = from[k * ens.lanes];
+			}
+		}
+		return;
+	}
+	for (int i = cl.first_level; i < cl.num_con_levels; i++) {
+		double* from = ens.baby_cl.cons[i][baby_time] + lane;
+		double* to = cl.cons[i][time];
+		for (int k = 0; k < cl.cells; k++) {
+			to[k] = from[k * ens.lanes];
+		}
+	}
+	cl.active_start_record[time] = ens.baby_cl.active_start_record[baby_time];
+	cl.active_end_record[time] = ens.baby_cl.active_end_record[baby_time];
+}
+
 /* anterior_time converts the given time step to its equivalent in anterior time
 	parameters:
 		sd: the current simulation's data
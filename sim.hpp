@@ -27,25 +27,53 @@ sim.hpp contains function declarations for sim.cpp.
 
 using namespace std;
 
-void simulate_all_params(input_params&, rates&, sim_data&, double**, mutant_data[], ofstream*, ofstream*, char**, ofstream*, ofstream*);
+/*
+Targets with FMA (e.g. -mavx512f, -mfma, or -march=native) let GCC contract a multiply and an add into one fused instruction that rounds once instead of twice.
+The batched kernels only match the per-cell functions (and builds without FMA) bit for bit when every operation is rounded separately, so contraction is turned off for every function declared here.
+GCC takes a function's optimization options from its first declaration, which is why this wraps the declarations rather than the definitions in sim.cpp.
+*/
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+
+void simulate_all_params(input_params&, rates&, sim_data&, double**&, mutant_data[], ofstream*, ofstream*, char**, ofstream*, ofstream*);
+void fit_contexts(input_params&, rates&, sim_data&, double**, mutant_data[], set_queue*, char**, sim_context*&, ensemble*&);
+void simulate_queue(input_params&, sim_context[], ensemble[]);
+void* simulate_sets(void*);
+void* simulate_ensembles(void*);
+int take_set(sim_context&, int);
+int take_sets(ensemble&);
+void give_results(sim_context&, int, set_results*);
 bool determine_set_passed(sim_data&, int, double);
-double simulate_param_set(int, input_params&, sim_data&, rates&, con_levels&, con_levels&, mutant_data[], ofstream*, ofstream*, char**, ofstream*, ofstream*);
+double simulate_param_set(int, input_params&, sim_data&, rates&, con_levels&, con_levels&, mutant_data[], double[], ostream*, ostream*, char**, ostream*, ostream*);
+void begin_param_set(int, con_levels&, con_levels&, mutant_data[]);
+double end_param_set(int, input_params&, sim_data&, rates&, mutant_data[], double[], int, ostream*, ostream*, ostream*, ostream*);
 int simulate_section(int, input_params&, sim_data&, rates&, con_levels&, con_levels&, mutant_data[], char**, double[]);
+void simulate_ensemble(ensemble&);
 void determine_start_end(sim_data&);
+void plan_checkpoint(input_params&, sim_data&, rates&, mutant_data[], checkpoint&);
+int induction_time(sim_data&, rates&, mutant_data&);
 void reset_mutant_scores(input_params&, mutant_data[]);
 void mutant_sim_message(mutant_data&, int);
 void store_original_rates (rates&, mutant_data&, double[]);
 void knockout(rates& rs, mutant_data&, bool induction);
 void revert_knockout(rates& rs, mutant_data&, double[]);
 double simulate_mutant(int, input_params&, sim_data&, rates&, con_levels&, con_levels&, mutant_data&, features&, char*, double[2]);
+void begin_mutant(int, sim_data&, rates&, con_levels&, con_levels&, mutant_data&);
+double end_mutant(int, input_params&, sim_data&, con_levels&, con_levels&, mutant_data&, features&, char*, bool);
 bool model(sim_data&, rates&, con_levels&, con_levels&, mutant_data&, double[2]);
-void calculate_delay_indices (sim_data&, con_levels&, int, int, int, double*[], int[], int[]);
-int index_with_splits(sim_data&, con_levels&, int, int, int, double);
+void ensemble_model(ensemble&, int);
+void take_checkpoint(sim_data&, con_levels&, con_levels&, int);
+void resume_checkpoint(sim_data&, con_levels&, con_levels&);
+void copy_time_steps(con_levels&, con_levels&, int);
+void calculate_delay_indices (sim_data&, int, double*[]);
+int index_with_splits(sim_data&, int, int, double);
 //bool any_less_than_0(con_levels&, int);
 //bool concentrations_too_high(con_levels&, int, double);
 void split(sim_data&, rates& rs, con_levels&, int, int);
-void copy_records(sim_data& sd, con_levels& cl, int, int);
 void update_rates(rates&, int);
+void update_rates_split(rates&, int, int);
+void update_gradient_rate(rates&, int, int);
+void interleave_rates(ensemble&);
 bool protein_synthesis(sim_data&, double**, con_levels&, st_context&, int[]);
 void dim_int(di_args&, di_indices);
 bool con_protein_her(cp_args&, cph_indices);
@@ -53,16 +81,28 @@ bool con_protein_delta(cp_args&, cpd_indices);
 bool dimer_proteins(sim_data&, double**, con_levels&, st_context&);
 bool con_dimer(cd_args&, int, int, cd_indices);
 bool mRNA_synthesis(sim_data&, double**, con_levels&, st_context&, int[], mutant_data&, bool, bool);
+void delta_averages(sim_data&, con_levels&, int, int, int, int[], int[], double[]);
+bool step_cells(sim_data&, double**, con_levels&, con_levels&, int, bool[], int, int, mutant_data&, bool, bool);
+void gather_step_inputs(sim_data&, double**, con_levels&, con_levels&, int, int, int, int);
+template <class V> typename V::mask step_block(sb_args&);
+template <class V> typename V::vec block_dim_int(sb_args&, typename V::vec, di_indices);
+template <class V> typename V::mask block_protein_her(sb_args&, typename V::vec, cph_indices);
+template <class V> typename V::mask block_protein_delta(sb_args&, cpd_indices);
+template <class V> typename V::mask block_dimer(sb_args&, int, int, cd_indices);
+template <class V> typename V::mask block_mrna(sb_args&);
 void calc_neighbors_1d(sim_data&, int[], int, int, int);
 void calc_neighbors_2d(sim_data&);
 double transcription(double**, con_levels&, int, int, double, double, double, int);
 double transcription_mespa(double**, con_levels&, int, int, double, double, double, int);
 double transcription_mespb(double**, con_levels&, int, int, double, double, double, int);
-void perturb_rates_all(rates&);
+void perturb_rates_all(sim_data&, rates&);
 void perturb_rates_column(sim_data&, rates&, int);
-double random_perturbation(double);
-void baby_to_cl (con_levels&, con_levels&, int, int);
+double random_perturbation(rng_state&, double);
+void baby_to_cl (sim_data&, con_levels&, con_levels&, int, int);
+void ensemble_to_cl(ensemble&, int, int, int);
 int anterior_time(sim_data&, int);
 
+#pragma GCC pop_options
+
 #endif
 
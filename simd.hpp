@@ -0,0 +1,104 @@
+/*
+Simulation for zebrafish segmentation
+Copyright (C) 2013 Ahmet Ay, Jack Holland, Adriana Sperlea, Sebastian Sangervasi
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+simd.hpp contains the vector types the batched simulation kernels in sim.cpp are written with.
+Each type works on a fixed number of lanes (one cell per lane, or one cell of one parameter set in ensemble mode) and supplies the few operations the kernels need besides arithmetic, which uses the usual operators.
+simd_vector is the widest type the compiler targets (AVX-512 with -mavx512f, AVX with -mavx or -mavx2, otherwise one lane) and simd_scalar always works on one lane, handling whatever cells are left over.
+Every width gives the same results only without floating-point contraction, which -mavx512f and -mfma would otherwise allow; sim.hpp turns it off for the kernels and the per-cell functions (other compilers than GCC need -ffp-contract=off).
+*/
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#if defined(__AVX512F__) || defined(__AVX__)
+	#include <immintrin.h>
+#endif
+
+/* simd_scalar works on one lane with plain doubles
+	notes:
+	todo:
+*/
+struct simd_scalar {
+	typedef double vec; // A lane of doubles
+	typedef bool mask; // Whether the lane is set
+	static const int width = 1; // The number of lanes
+
+	static inline vec load (const double* mem) { return *mem; }
+	static inline void store (double* mem, vec a) { *mem = a; }
+	static inline vec set1 (double x) { return x; }
+	static inline vec zero_where_zero (vec a, vec test) { return test == 0 ? 0 : a; } // a in every lane test is not 0, 0 elsewhere
+	static inline mask out_of_bounds (vec a, vec max) { return a < 0 || a > max; } // Lanes less than 0 or greater than max (NaN lanes are not set)
+	static inline mask mask_none () { return false; }
+	static inline mask mask_or (mask a, mask b) { return a || b; }
+	static inline bool any (mask a) { return a; }
+	static inline int bits (mask a) { return a; } // One bit per lane, the first lane in the lowest bit
+};
+
+#if defined(__AVX512F__)
+
+/* simd_vector works on the 8 lanes of an AVX-512 register
+	notes:
+	todo:
+*/
+struct simd_vector {
+	typedef __m512d vec;
+	typedef __mmask8 mask;
+	static const int width = 8;
+
+	static inline vec load (const double* mem) { return _mm512_loadu_pd(mem); }
+	static inline void store (double* mem, vec a) { _mm512_storeu_pd(mem, a); }
+	static inline vec set1 (double x) { return _mm512_set1_pd(x); }
+	static inline vec zero_where_zero (vec a, vec test) { return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(test, _mm512_setzero_pd(), _CMP_NEQ_UQ), a); }
+	static inline mask out_of_bounds (vec a, vec max) { return _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_LT_OQ) | _mm512_cmp_pd_mask(a, max, _CMP_GT_OQ); }
+	static inline mask mask_none () { return 0; }
+	static inline mask mask_or (mask a, mask b) { return a | b; }
+	static inline bool any (mask a) { return a != 0; }
+	static inline int bits (mask a) { return a; }
+};
+
+#elif defined(__AVX__)
+
+/* simd_vector works on the 4 lanes of an AVX register
+	notes:
+	todo:
+*/
+struct simd_vector {
+	typedef __m256d vec;
+	typedef __m256d mask; // Set lanes have every bit set
+	static const int width = 4;
+
+	static inline vec load (const double* mem) { return _mm256_loadu_pd(mem); }
+	static inline void store (double* mem, vec a) { _mm256_storeu_pd(mem, a); }
+	static inline vec set1 (double x) { return _mm256_set1_pd(x); }
+	static inline vec zero_where_zero (vec a, vec test) { return _mm256_andnot_pd(_mm256_cmp_pd(test, _mm256_setzero_pd(), _CMP_EQ_OQ), a); }
+	static inline mask out_of_bounds (vec a, vec max) { return _mm256_or_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_LT_OQ), _mm256_cmp_pd(a, max, _CMP_GT_OQ)); }
+	static inline mask mask_none () { return _mm256_setzero_pd(); }
+	static inline mask mask_or (mask a, mask b) { return _mm256_or_pd(a, b); }
+	static inline bool any (mask a) { return _mm256_movemask_pd(a) != 0; }
+	static inline int bits (mask a) { return _mm256_movemask_pd(a); }
+};
+
+#else
+
+typedef simd_scalar simd_vector; // Without vector instructions the batched kernels run one cell at a time
+
+#endif
+
+#endif
+
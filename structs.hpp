@@ -26,10 +26,19 @@ structs.hpp contains every struct used in the program.
 #include <cmath> // Needed for INFINITY
 #include <cstdlib> // Needed for cmath
 #include <cstring> // Needed for strlen, memset, memcpy
+#include <stdint.h> // Needed for int32_t, uint32_t, uint64_t
 #include <iostream> // Needed for cout
 #include <bitset> // Needed for bitset
 #include <fstream> // Needed for ofstream
 #include <map> // Needed for map
+#include <sstream> // Needed for ostringstream
+#include <pthread.h> // Needed for pthread_t, pthread_mutex_t
+#include <semaphore.h> // Needed for sem_t
+#include <sys/mman.h> // Needed for munmap
+#include <time.h> // Needed for clock_gettime
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h> // Needed for __rdtsc
+#endif
 
 #include "macros.hpp"
 #include "memory.hpp"
@@ -112,6 +121,177 @@ struct terminal {
 	}
 };
 
+/* null_buffer is a stream buffer that discards everything written to it
+	notes:
+		Unlike a file stream to /dev/null, this buffer has no state that changes when written to, so several threads can write to it at once.
+	todo:
+*/
+struct null_buffer : public streambuf {
+	int overflow (int c) {
+		return traits_type::not_eof(c);
+	}
+	
+	streamsize xsputn (const char*, streamsize n) {
+		return n;
+	}
+};
+
+/* line_buffer is a stream buffer that keeps only the last line written to it, used to catch error messages when running as a library
+	notes:
+		Worker threads can write at the same time, so every write is made while holding lock.
+		Other workers can go on printing after one fails, so the failing worker keeps its message in error_line (see quit in main.cpp).
+	todo:
+*/
+struct line_buffer : public streambuf {
+	pthread_mutex_t lock; // The lock guarding the lines
+	string line; // The line being written
+	string last_line; // The last non-empty line finished
+	string error_line; // The last non-empty line finished before the first failure, empty if nothing has failed
+	
+	line_buffer () {
+		pthread_mutex_init(&(this->lock), NULL);
+	}
+	
+	int overflow (int c) {
+		if (c != traits_type::eof()) {
+			char ch = c;
+			this->xsputn(&ch, 1);
+		}
+		return traits_type::not_eof(c);
+	}
+	
+	streamsize xsputn (const char* s, streamsize n) {
+		pthread_mutex_lock(&(this->lock));
+		for (streamsize i = 0; i < n; i++) {
+			if (s[i] != '\n') {
+				this->line += s[i];
+			} else if (!this->line.empty()) {
+				this->last_line = this->line;
+				this->line.clear();
+			}
+		}
+		pthread_mutex_unlock(&(this->lock));
+		return n;
+	}
+	
+	// Keeps the last line finished as the error message unless an earlier failure already kept one
+	void keep_error () {
+		pthread_mutex_lock(&(this->lock));
+		if (this->error_line.empty()) {
+			this->error_line = this->last_line;
+		}
+		pthread_mutex_unlock(&(this->lock));
+	}
+	
+	// Forgets every line written so far
+	void clear () {
+		pthread_mutex_lock(&(this->lock));
+		this->line.clear();
+		this->last_line.clear();
+		this->error_line.clear();
+		pthread_mutex_unlock(&(this->lock));
+	}
+	
+	~line_buffer () {
+		pthread_mutex_destroy(&(this->lock));
+	}
+};
+
+/* early_exit is thrown in place of exiting the program when it is running as a library
+	notes:
+		Only the library's entry points catch it (see quit in main.cpp and segclock.cpp).
+	todo:
+*/
+struct early_exit {
+	int status; // The status the program would have exited with
+	
+	explicit early_exit (int status) {
+		this->status = status;
+	}
+};
+
+/* shm_ring contains the state of a lock-free single-producer single-consumer ring of bytes in a shared memory region (see shm_region)
+	notes:
+		head counts every byte ever written and is only advanced by the producer; tail counts every byte ever read and is only advanced by the consumer. The bytes between them are waiting to be read, at RING(tail, capacity - 1) onward in the ring's data.
+		Both counters are read with acquire and written with release ordering so the bytes they cover are visible before the counters are. They sit on separate cache lines so the two sides do not fight over one line.
+		This is a copying transport, not a zero-copy one: the consumer copies bytes out of the ring (each parameter set into its own array) and the producer copies them in (each score record), after which their space can be reused at once. Workers never read rates from the ring, since a set is simulated long after its bytes would have been overwritten.
+		The layout is shared with the sampler, so fields must never be reordered or resized.
+	todo:
+*/
+struct shm_ring {
+	uint64_t head; // The number of bytes ever written (only written by the producer)
+	char pad_head[SHM_LINE - sizeof(uint64_t)];
+	uint64_t tail; // The number of bytes ever read (only written by the consumer)
+	char pad_tail[SHM_LINE - sizeof(uint64_t)];
+	uint64_t capacity; // The size in bytes of the ring's data, a power of two (set by the sampler)
+	uint32_t closed; // Whether or not the producer will write no more bytes (set by the producer)
+	char pad_end[SHM_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+};
+
+/* shm_region contains the header of a shared memory region created by the sampler to exchange data with the simulation without pipes
+	notes:
+		The region is the header followed by the data of the ring in (SHM_HEADER_SIZE bytes from the start) and then the data of the ring out.
+		The sampler fills in the capacities and its process ID and then the magic number before passing the region's name with -H. The bytes sent through the rings are exactly what would be sent through the pipes.
+		A waiting simulation checks that the sampler is still running (see wait_shm), since a sampler that dies never closes its ring. A sampler_pid of 0 (as in regions laid out before it was added) makes it watch its parent process instead.
+	todo:
+*/
+struct shm_region {
+	uint32_t magic; // SHM_MAGIC once the sampler has filled in the header
+	uint32_t version; // SHM_VERSION
+	int32_t sampler_pid; // The sampler's process ID, or 0 if the sampler is the simulation's parent process
+	char pad[SHM_LINE - 3 * sizeof(uint32_t)];
+	shm_ring in; // The ring the sampler writes parameter sets to
+	shm_ring out; // The ring the simulation writes scores to
+	
+	// Returns the start of the ring in's data
+	char* in_data () {
+		return (char*)this + SHM_HEADER_SIZE;
+	}
+	
+	// Returns the start of the ring out's data
+	char* out_data () {
+		return (char*)this + SHM_HEADER_SIZE + this->in.capacity;
+	}
+};
+
+/* ccons_header contains the header of a chunked concentrations output file (.ccons)
+	notes:
+		The file is the header followed by the chunks and then the index of chunks (index_offset bytes from the start), which is an array of num_chunks ccons_chunk structs ordered by time. Numbers are stored in the machine's byte order, like .bcons files.
+		Each chunk holds chunk_steps time steps (the last of a section can hold fewer) and is a column per printed level, in the order of levels. A column holds every cell's concentration as a float at every time step of the chunk, indexed by [time steps][cells], with cells ordered like .cons files.
+		A compressed column was delta encoded (each float's bits minus the bits of the same cell's float one time step earlier, as 32-bit integers, except in the chunk's first time step), split into four planes of bytes from the lowest to the highest byte of each value, and compressed in the LZ4 block format (see compress_block). A column whose stored size equals its raw size was stored raw because compressing did not make it smaller.
+		Fields must never be reordered or resized since readers map the file directly.
+	todo:
+*/
+struct ccons_header {
+	uint32_t magic; // CCONS_MAGIC once the file is complete
+	uint32_t version; // CCONS_VERSION
+	int32_t width; // The total width of the simulation
+	int32_t height; // The height of the simulation
+	int32_t big_gran; // The number of time steps between rows of a column
+	int32_t chunk_steps; // The largest number of rows in a chunk
+	int32_t compressed; // Whether or not the columns were compressed
+	int32_t num_levels; // The number of levels printed
+	int32_t levels[CCONS_MAX_LEVELS]; // The indices of the levels printed (see the concentration levels in macros.hpp)
+	int32_t num_chunks; // The number of chunks in the file
+	int32_t pad;
+	uint64_t index_offset; // The offset in bytes of the index of chunks from the start of the file
+};
+
+/* ccons_chunk contains the location of a chunk of a chunked concentrations output file (see ccons_header)
+	notes:
+	todo:
+*/
+struct ccons_chunk {
+	uint64_t offset; // The offset in bytes of the chunk's first column from the start of the file
+	int32_t first_step; // The time step of the chunk's first row
+	int32_t num_steps; // The number of rows in the chunk
+	uint32_t sizes[CCONS_MAX_LEVELS]; // The size in bytes of each level's column as stored
+};
+
+struct output_writer; // Declared after set_queue
+struct params_stream; // Declared after input_data
+struct trace_recorder; // Declared after profile
+
 /* input_params contains all of the program's input parameters (i.e. the given command-line arguments) as well as data associated with them
 	notes:
 		There should be only one instance of input_params at any time.
@@ -134,6 +314,10 @@ struct input_params {
 	char* dir_path; // The path of the output directory for concentrations or oscillation features, default=none
 	bool print_cons; // Whether or not to print concentrations, default=false
 	bool binary_cons_output; // Whether or not to print the binary or ASCII value of numbers in the concentrations output files
+	int chunk_steps; // The number of time steps in each chunk of the chunked concentrations output files, default=0 (print .cons or .bcons files instead)
+	bool compress_cons; // Whether or not to delta encode and compress the columns of the chunked concentrations output files, default=false
+	int num_cons_levels; // The number of concentration levels to print in the chunked concentrations output files, default=0 (each mutant's print_con)
+	int cons_levels[CCONS_MAX_LEVELS]; // The concentration levels to print in the chunked concentrations output files
 	char* features_file; // The path and file of the features file, default=none
 	bool ant_features; // Whether or not to print oscillation features in the anterior
 	bool post_features; // Whether or not to print oscillation features in the posterior
@@ -143,6 +327,11 @@ struct input_params {
 	char* scores_file; // The path and file of the scores file, default=none
 	bool print_scores; // Whether or not to print the scores for every mutant, default=false
 	int num_colls_print; // The number of columns of cells to print for plotting of single cells on top of each other
+	char* profile_file; // The path and file of the profile, default=none
+	bool print_profile; // Whether or not to time each phase of the simulations and print the times to the profile, default=false
+	char* trace_file; // The path and file of the trace, default=none
+	bool print_trace; // Whether or not to record each worker's timeline and print it to the trace, default=false
+	trace_recorder* tracer; // Every worker's timeline, NULL if not tracing or before any contexts are created (see create_contexts)
 	
 	// Sets
 	int num_sets; // The number of parameter sets to simulate, default=1
@@ -165,6 +354,7 @@ struct input_params {
 	double step_size; // The time step in minutes used for Euler's method, default=0.01
 	double max_con_thresh; // Maximum threshold for concentrations, default=INFINITY
 	bool short_circuit; // Whether or not to stop simulating a parameter set after a mutant fails
+	int predict_fail; // The number of expected periods without clear mh1 oscillations after which the wild type is predicted to fail and its parameter set is abandoned, default=0 (unused)
 	int num_active_mutants; // The number of mutants to simulate for each parameter set, default=num_mutants
 	int big_gran; // The granularity in time steps with which to store data, default=1
 	int small_gran; // The granularit in time steps with which to simulate data, default=1
@@ -173,17 +363,27 @@ struct input_params {
 	int DAPT_induction; // The time point of the induction of NICD perturbation
 	int mespa_induction; // The time point of the induction of mespa overexpression
 	int mespb_induction; // The time point of the induction of mespb overexpression
+	int num_threads; // The number of worker threads to simulate parameter sets with, default=1
+	int num_lanes; // The number of parameter sets each worker simulates at once in ensemble mode (1 disables ensemble mode), default=1
 	
 	// Piping data
 	bool piping; // Whether or not input and output should be piped (as opposed to written to disk), default=false
 	int pipe_in; // The file descriptor to pipe data from, default=none (0)
 	int pipe_out; // The file descriptor to pipe data into, default=none (0)
+	bool daemon; // Whether or not to keep serving batches of parameter sets over the pipe until the sampler ends the session, default=false
+	bool pipe_records; // Whether or not to pipe each set's score record as soon as it finishes instead of every score once the batch finishes, default=false
+	char* shm_name; // The name of the shared memory region to exchange data through instead of the pipes, default=none
+	shm_region* shm; // The mapped shared memory region, NULL if not using one
+	size_t shm_size; // The size in bytes of the mapped shared memory region
+	int shm_parent; // The simulation's parent process ID when the region was mapped, watched if the sampler gave no process ID
 	
 	// Output stream data
 	bool verbose; // Whether or not the program is verbose, i.e. prints many messages about program and simulation state, default=false
 	bool quiet; // Whether or not the program is quiet, i.e. redirects cout to /dev/null, default=false
 	streambuf* cout_orig; // cout's original buffer to be restored at program completion
-	ofstream* null_stream; // A stream to /dev/null that cout is redirected to if quiet mode is set
+	null_buffer* null_stream; // A buffer that discards output, which cout is redirected to if quiet mode is set
+	output_writer* writer; // The background writer the result files and concentrations are handed to while simulating, NULL if they are written directly
+	params_stream* pstream; // The stream the parameter sets file is read from a chunk at a time, NULL if the sets are not read from a file
 	
 	input_params () {
 		this->params_file = NULL;
@@ -199,6 +399,9 @@ struct input_params {
 		this->dir_path = NULL;
 		this->print_cons = false;
 		this->binary_cons_output = false;
+		this->chunk_steps = 0;
+		this->compress_cons = false;
+		this->num_cons_levels = 0;
 		this->features_file = NULL;
 		this->ant_features = false;
 		this->post_features = false;
@@ -208,6 +411,11 @@ struct input_params {
 		this->scores_file = NULL;
 		this->print_scores = false;
 		this->num_colls_print = 0;
+		this->profile_file = NULL;
+		this->print_profile = false;
+		this->trace_file = NULL;
+		this->print_trace = false;
+		this->tracer = NULL;
 		this->num_sets = 1;
 		this->big_gran = 1;
 		this->small_gran = 1;
@@ -226,14 +434,25 @@ struct input_params {
 		this->step_size = 0.01;
 		this->max_con_thresh = INFINITY;
 		this->short_circuit = false;
+		this->predict_fail = 0;
 		this->num_active_mutants = NUM_MUTANTS;
+		this->num_threads = 1;
+		this->num_lanes = 1;
 		this->piping = false;
 		this->pipe_in = 0;
 		this->pipe_out = 0;
+		this->daemon = false;
+		this->pipe_records = false;
+		this->shm_name = NULL;
+		this->shm = NULL;
+		this->shm_size = 0;
+		this->shm_parent = 0;
 		this->verbose = false;
 		this->quiet = false;
 		this->cout_orig = NULL;
-		this->null_stream = new ofstream("/dev/null");
+		this->null_stream = new null_buffer();
+		this->writer = NULL;
+		this->pstream = NULL;
 	}
 	
 	~input_params () {
@@ -245,14 +464,17 @@ struct input_params {
 		mfree(this->features_file);
 		mfree(this->conditions_file);
 		mfree(this->scores_file);
+		mfree(this->profile_file);
+		mfree(this->trace_file);
 		mfree(this->seed_file);
+		mfree(this->shm_name);
 		delete this->null_stream;
 	}
 };
 
 /* rates contains the rates specified by the current parameter set as well as perturbation and gradient data
 	notes:
-		There should be only one instance of rates at any time.
+		There should be only one instance of rates per worker thread.
 		rates_active is the final, active rates that should be used in the simulation.
 	todo:
 */
@@ -266,6 +488,7 @@ struct rates {
 	int cells; // The total number of cells in the simulation
 	double* rates_cell[NUM_RATES]; // Rates per cell that factor in the base rates and each cell's perturbations
 	double* rates_active[NUM_RATES]; // Rates per cell position that factor in the base rates, each cell's perburations, and the gradients at each position
+	bool cells_changed; // Whether rates_cell has changed in more than the column the last split produced since rates_active was last updated
 	
 	explicit rates (int width, int cells) {
 		memset(this->rates_base, 0, sizeof(this->rates_base));
@@ -282,6 +505,7 @@ struct rates {
 			this->rates_cell[i] = new double[cells];
 			this->rates_active[i] = new double[cells];
 		}
+		this->cells_changed = true;
 	}
 	
 	~rates () {
@@ -293,17 +517,57 @@ struct rates {
 	}
 };
 
+/* con_slice gives [time steps][cells] access to one concentration level of a con_levels struct
+	notes:
+		slice[j] returns the row of cells at time step j, so slice[j][k] reads like the old double** tables.
+	todo:
+*/
+struct con_slice {
+	double* base; // The first cell of the first time step of this concentration level
+	long row_size; // The number of doubles between consecutive time steps
+	
+	double* operator[] (int time) const {
+		return this->base + time * this->row_size;
+	}
+};
+
+/* con_array gives [concentration levels][time steps][cells] access to the single block of memory a con_levels struct stores its concentrations in
+	notes:
+		Indexing computes addresses from strides rather than following pointers, so cons[i][j][k] costs two multiply-adds and no extra memory reads.
+	todo:
+*/
+struct con_array {
+	double* slab; // The block of memory storing every concentration
+	long level_size; // The number of doubles between consecutive concentration levels
+	long row_size; // The number of doubles between consecutive time steps
+	int first_level; // The index of the first concentration level stored (lower indices are not stored)
+	
+	con_array () {
+		this->slab = NULL;
+		this->level_size = 0;
+		this->row_size = 0;
+		this->first_level = 0;
+	}
+	
+	con_slice operator[] (int level) const {
+		con_slice slice = {this->slab + (level - this->first_level) * this->level_size, this->row_size};
+		return slice;
+	}
+};
+
 /* con_levels contains concentration levels and active records for specific portions of a simulation
 	notes:
 		This is a general struct used in several places so make sure any changes are compatible with the main cl, baby_cl and each mutant's cl.
+		Every concentration is stored in one aligned block of memory, level by level, then time step by time step. Each row of cells is padded to a multiple of CON_ALIGNMENT bytes so every row starts aligned.
 	todo:
 */
 struct con_levels {
 	bool initialized; // Whether or not this struct's data have been initialized
-	int num_con_levels; // The number of concentration levels this struct stores (not necessarily the total number of concentration levels)
+	int first_level; // The index of the first concentration level this struct stores
+	int num_con_levels; // One more than the index of the last concentration level this struct stores (not necessarily the total number of concentration levels)
 	int time_steps; // The number of time steps this struct stores concentrations for
 	int cells; // The number of cells this struct stores concentrations for
-	double*** cons; // A three dimensional array that stores [concentration levels][time steps][cells] in that order
+	con_array cons; // The concentrations, indexed by [concentration levels][time steps][cells] in that order
 	int* active_start_record; // Record of the start of the active PSM at each time step
 	int* active_end_record; // Record of the end of the active PSM at each time step
 	
@@ -311,73 +575,54 @@ struct con_levels {
 		this->initialized = false;
 	}
 	
-	con_levels (int num_con_levels, int time_steps, int cells, int active_start) {
+	con_levels (int first_level, int num_con_levels, int time_steps, int cells, int active_start) {
 		this->initialized = false;
-		initialize(num_con_levels, time_steps, cells, active_start);
+		initialize(first_level, num_con_levels, time_steps, cells, active_start);
 	}
 	
-	// Initializes the struct with the given number of concentration levels, time steps, and cells
-	void initialize (int num_con_levels, int time_steps, int cells, int active_start) {
+	// Initializes the struct with the given range of concentration levels, time steps, and cells
+	void initialize (int first_level, int num_con_levels, int time_steps, int cells, int active_start) {
 		// If the current size is big enough to fit the new size then reuse the memory, otherwise allocate the required memory
-		if (this->initialized && this->num_con_levels >= num_con_levels && this->time_steps >= time_steps && this->cells >= cells) {
+		if (this->initialized && this->first_level == first_level && this->num_con_levels >= num_con_levels && this->time_steps >= time_steps && this->cells >= cells) {
 			this->reset();
 			this->active_start_record[0] = active_start;
 		} else {
+			this->clear();
+			this->first_level = first_level;
 			this->num_con_levels = num_con_levels;
 			this->time_steps = time_steps;
 			this->cells = cells;
 			this->active_start_record = new int[time_steps];
-			this->active_start_record[0] = active_start; // Initialize the active start record with the given position
 			this->active_end_record = new int[time_steps];
-			this->active_end_record[0] = 0; // Initialize the active end record at position 0
-		
-			this->cons = new double**[num_con_levels];
-			for (int i = 0; i < num_con_levels; i++) {
-				this->cons[i] = new double*[time_steps];
-				for (int j = 0; j < time_steps; j++) {
-					this->cons[i][j] = new double[cells];
-					for (int k = 0; k < cells; k++) {
-						this->cons[i][j][k] = 0; // Initialize every concentration level at every time step for every cell to 0
-					}
-				}
-			}
-			for (int j = 1; j < time_steps; j++) {
-				this->active_start_record[j] = 0;
-		        this->active_end_record[j] = 0;
-			}
+			
+			long row_align = CON_ALIGNMENT / sizeof(double);
+			this->cons.row_size = (cells + row_align - 1) / row_align * row_align;
+			this->cons.level_size = this->cons.row_size * time_steps;
+			this->cons.first_level = first_level;
+			this->cons.slab = (double*)mallocate_aligned(sizeof(double) * this->cons.level_size * (num_con_levels - first_level), CON_ALIGNMENT);
 			this->initialized = true;
+			
+			this->reset(); // Initialize every concentration level at every time step for every cell to 0
+			this->active_start_record[0] = active_start; // Initialize the active start record with the given position
 		}
 	}
 	
 	// Sets every value in the struct to 0 but does not free any memory
 	void reset () {
 		if (this->initialized) {
-			for (int i = 0; i < this->num_con_levels; i++) {
-				for (int j = 0; j < this->time_steps; j++) {
-					for (int k = 0; k < this->cells; k++) {
-						this->cons[i][j][k] = 0;
-					}
-				}
-			}
-			for (int j = 0; j < this->time_steps; j++) {
-				this->active_start_record[j] = 0;
-				this->active_end_record[j] = 0;
-			}
+			memset(this->cons.slab, 0, sizeof(double) * this->cons.level_size * (this->num_con_levels - this->first_level));
+			memset(this->active_start_record, 0, sizeof(int) * this->time_steps);
+			memset(this->active_end_record, 0, sizeof(int) * this->time_steps);
 		}
 	}
 	
 	// Frees the memory used by the struct
 	void clear () {
 		if (this->initialized) {
-			for (int i = 0; i < this->num_con_levels; i++) {
-				for (int j = 0; j < this->time_steps; j++) {
-					delete[] this->cons[i][j];
-				}
-				delete[] this->cons[i];
-			}
-			delete[] this->cons;
+			mfree_aligned(this->cons.slab, CON_ALIGNMENT);
+			this->cons.slab = NULL;
 			delete[] this->active_start_record;
-            delete[] this->active_end_record;
+			delete[] this->active_end_record;
 			this->initialized = false;
 		}
 	}
@@ -400,6 +645,7 @@ struct growin_array {
 
 	void initialize(int size) {
 		array = new int[size];
+		memset(array, 0, sizeof(int) * size); // Zero the array so reading an index that was never written is at least deterministic
 		this->size = size;
 	}
 	
@@ -413,6 +659,7 @@ struct growin_array {
 			for (int i = 0; i < this->size; i++) {
 				new_array[i] = array[i];
 			}
+			memset(new_array + this->size, 0, sizeof(int) * this->size);
 			delete[] array;
 			this->size = 2 * this->size;
 			array = new_array;
@@ -433,6 +680,72 @@ struct growin_array {
 	}
 };
 
+/* extremum_window keeps track of the largest or smallest concentration of one cell within a window of time steps that slides forward
+	notes:
+		The window holds its time steps in a ring ordered by concentration, each no more extreme than the one before it, so the extremum is always first and adding or dropping time steps costs amortized constant time.
+		Time steps with the same concentration as the extremum are all kept so ties can be told apart from strict extrema.
+		NaN concentrations are never added since every comparison with NaN is false.
+	todo:
+*/
+struct extremum_window {
+	con_slice conc; // The concentration level to look at
+	int cell; // The cell to look at
+	bool largest; // Whether the window keeps track of the largest (true) or smallest (false) concentration
+	int* times; // The ring of time steps
+	int capacity; // The size of the ring, at least the number of time steps the window can hold
+	int first; // The index in the ring of the first time step
+	int size; // The number of time steps in the ring
+	
+	explicit extremum_window (con_slice conc, int cell, bool largest, int capacity) {
+		this->conc = conc;
+		this->cell = cell;
+		this->largest = largest;
+		this->times = new int[capacity];
+		this->capacity = capacity;
+		this->first = 0;
+		this->size = 0;
+	}
+	
+	// Adds the given time step to the end of the window, dropping the time steps that can no longer be the extremum
+	void add (int time) {
+		double con = this->conc[time][this->cell];
+		if (con != con) {
+			return;
+		}
+		while (this->size > 0) {
+			double last = this->conc[this->times[(this->first + this->size - 1) % this->capacity]][this->cell];
+			if (this->largest ? last < con : last > con) {
+				this->size--;
+			} else {
+				break;
+			}
+		}
+		this->times[(this->first + this->size) % this->capacity] = time;
+		this->size++;
+	}
+	
+	// Drops every time step before the given one from the start of the window
+	void drop_before (int time) {
+		while (this->size > 0 && this->times[this->first] < time) {
+			this->first = (this->first + 1) % this->capacity;
+			this->size--;
+		}
+	}
+	
+	// Whether the concentration at the given time step, which must be in the window, is strictly more extreme than every other one in the window
+	bool strict (int time) {
+		double con = this->conc[time][this->cell];
+		if (con != con) { // Every comparison with NaN is false, so nothing rules it out
+			return true;
+		}
+		return this->times[this->first] == time && (this->size == 1 || this->conc[this->times[(this->first + 1) % this->capacity]][this->cell] != con);
+	}
+	
+	~extremum_window () {
+		delete[] this->times;
+	}
+};
+
 /* features contains the oscillation features for a particular simulation
 	notes:
 	todo:
@@ -484,6 +797,43 @@ struct features {
 	}
 };
 
+/* feature_demand contains which oscillation features a mutant's anterior conditions tests read
+	notes:
+		Each entry is a (feature, gene, time) triple: the feature is an FD_* index, the gene an mRNA index, and the time the number of hours after induction the feature is measured at (0 for features without a time).
+		The times are stored as bit masks, bit i standing for i half hours, so a feature without a time sets bit 0.
+		The wild type's demand also holds every entry the other active mutants read from the wild type's features (wtfeat).
+	todo:
+*/
+struct feature_demand {
+	uint32_t entries[NUM_FD][NUM_INDICES]; // The time points needed of each feature of each gene
+	
+	feature_demand () {
+		this->clear();
+	}
+	
+	void clear () {
+		memset(this->entries, 0, sizeof(this->entries));
+	}
+	
+	// Demands every feature of every gene at every time, used when the features are printed or dumped to files
+	void need_all () {
+		memset(this->entries, 0xFF, sizeof(this->entries));
+	}
+	
+	void need (int feat, int gene, double hours = 0) {
+		this->entries[feat][gene] |= (uint32_t)1 << (int)(hours * 2);
+	}
+	
+	// Whether the feature of the gene is needed at any time
+	bool needs (int feat, int gene) {
+		return this->entries[feat][gene] != 0;
+	}
+	
+	bool needs (int feat, int gene, double hours) {
+		return (this->entries[feat][gene] >> (int)(hours * 2)) & 1;
+	}
+};
+
 /* mutant_data contains data for a particular mutant
 	notes:
 	todo:
@@ -508,6 +858,8 @@ struct mutant_data {
 	double conds_passed[NUM_SECTIONS][1 + MAX_CONDS_ANY]; // The score this mutant achieved for each condition when run
 	features feat; // The oscillation features this mutant produced when run
 	int print_con; // The index of the concentration that should be printed (usually mh1)
+	void (*ant_demand)(feature_demand&, feature_demand&); // Declares the features the anterior conditions test reads (NULL demands every feature)
+	feature_demand demand; // The oscillation features osc_features_ant has to calculate for this mutant
 	
 	mutant_data () {
 		this->index = 0;
@@ -527,6 +879,7 @@ struct mutant_data {
 		memset(this->max_cond_scores, 0, sizeof(this->max_cond_scores));
 		memset(this->secs_passed, false, sizeof(this->secs_passed));
 		this->print_con = CMH1;
+		this->ant_demand = NULL;
 	}
 	
 	~mutant_data () {
@@ -546,9 +899,704 @@ struct mutant_data {
 	}
 };
 
+/* rng_state contains a counter-based (Philox-4x32-10) random number generator for one stream of random numbers
+	notes:
+		Every number is a pure function of the key (seed and set) and the counter (stream, section, and position), so any stream can be started at any position in O(1) without generating the numbers before it.
+		This makes every set reproducible on its own, regardless of which thread or machine simulates it or which sets were simulated before it.
+		See Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (2011) for the algorithm and its constants.
+	todo:
+*/
+struct rng_state {
+	uint32_t key[2]; // The key: the seed and the index of the parameter set
+	uint32_t counter[4]; // The counter: the block position in the stream, the stream, the section, and an unused word
+	uint32_t block[4]; // The four random numbers generated from the current counter
+	int used; // How many numbers from block have been returned
+	
+	rng_state () {
+		this->seed(1, 0, 0, 0);
+	}
+	
+	// Starts the stream identified by the given seed, set, section, and stream at its first number
+	void seed (uint32_t seed, uint32_t set_num, uint32_t section, uint32_t stream) {
+		this->key[0] = seed;
+		this->key[1] = set_num;
+		this->counter[1] = stream;
+		this->counter[2] = section;
+		this->counter[3] = 0;
+		this->seek(0);
+	}
+	
+	// Moves to the given position in the current stream in constant time
+	void seek (uint32_t position) {
+		this->counter[0] = position / 4;
+		this->generate();
+		this->used = position % 4;
+	}
+	
+	// Returns the next random number, uniformly distributed over every 32 bit unsigned integer
+	uint32_t next () {
+		if (this->used == 4) {
+			this->counter[0]++;
+			this->generate();
+			this->used = 0;
+		}
+		return this->block[this->used++];
+	}
+	
+	// Fills block with the numbers for the current key and counter
+	void generate () {
+		uint32_t k0 = this->key[0];
+		uint32_t k1 = this->key[1];
+		uint32_t c0 = this->counter[0];
+		uint32_t c1 = this->counter[1];
+		uint32_t c2 = this->counter[2];
+		uint32_t c3 = this->counter[3];
+		for (int i = 0; i < 10; i++) {
+			uint64_t product0 = (uint64_t)0xD2511F53 * c0;
+			uint64_t product1 = (uint64_t)0xCD9E8D57 * c2;
+			uint32_t hi0 = product0 >> 32;
+			uint32_t hi1 = product1 >> 32;
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = (uint32_t)product1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = (uint32_t)product0;
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+		this->block[0] = c0;
+		this->block[1] = c1;
+		this->block[2] = c2;
+		this->block[3] = c3;
+	}
+};
+
+/* lineage contains the ancestry and births of every cell, replacing the birth and parent records concentration levels used to carry at every time step
+	notes:
+		New cells are born only when split creates a column, whose parents are always the column the previous split created, so the ancestor d generations back of a cell born at split n was born at split n - d. Every cell present at the start of a simulation counts as born at split 0.
+		Only split changes the ancestors and logs the split's time and column; every other time step just records how many splits have happened by then.
+	todo:
+*/
+struct lineage {
+	bool initialized; // Whether or not this struct's data have been initialized
+	int cells; // The number of cells
+	int width; // The width in cells of the PSM
+	int depth; // The number of generations stored for each cell, including the cell itself
+	int* ancestors; // The index of each cell's ancestors, indexed by [cell * depth + generations back]
+	int* births; // The split each cell was born at
+	int* splits; // The number of splits that happened by each time step, treated cyclically like baby_cl
+	int mask; // The size of splits - 1 (a power of two), used to wrap time steps with RING
+	int num_splits; // The number of splits that have happened in the current simulation
+	int* split_times; // The time step of each split, in order (index 0 is unused)
+	int* split_columns; // The column of cells each split created (index 0 is unused)
+
+	lineage () {
+		this->initialized = false;
+	}
+
+	// Initializes the struct for the given number of cells and columns, generations, time steps of history (a power of two), and splits
+	void initialize (int cells, int width, int depth, int history_size, int max_splits) {
+		this->clear();
+		this->cells = cells;
+		this->width = width;
+		this->depth = depth;
+		this->ancestors = new int[cells * depth];
+		this->births = new int[cells];
+		this->splits = new int[history_size];
+		this->mask = history_size - 1;
+		this->split_times = new int[max_splits + 1];
+		this->split_columns = new int[max_splits + 1];
+		this->initialized = true;
+		this->reset();
+	}
+
+	// Makes every cell its own ancestor, born before any split
+	void reset () {
+		for (int k = 0; k < this->cells; k++) {
+			for (int d = 0; d < this->depth; d++) {
+				this->ancestors[k * this->depth + d] = k;
+			}
+			this->births[k] = 0;
+		}
+		memset(this->splits, 0, sizeof(int) * (this->mask + 1));
+		this->num_splits = 0;
+	}
+
+	// Records how many splits have happened by the given time step
+	void record (int time) {
+		this->splits[RING(time, this->mask)] = this->num_splits;
+	}
+
+	// Returns the index of the cell holding the given cell's lineage at the given time step, which must be within the history
+	int ancestor (int cell, int time) {
+		int generations = this->births[cell] - this->splits[RING(time, this->mask)];
+		if (generations <= 0) {
+			return cell;
+		}
+		return this->ancestors[cell * this->depth + MIN(generations, this->depth - 1)];
+	}
+
+	// Returns the split the cell at the given position at the given time step was born at (0 if it was present from the start), looking the time up in the split log
+	int born (int cell, int time) {
+		int low = 0;
+		int high = this->num_splits;
+		while (low < high) { // Find the last split at or before the time step
+			int mid = (low + high + 1) / 2;
+			if (this->split_times[mid] <= time) {
+				low = mid;
+			} else {
+				high = mid - 1;
+			}
+		}
+		int column = cell % this->width;
+		for (int n = low; n > 0; n--) { // Splits create columns in turn, so this looks back at most one split per column
+			if (this->split_columns[n] == column) {
+				return n;
+			}
+		}
+		return 0;
+	}
+
+	// Frees the memory used by the struct
+	void clear () {
+		if (this->initialized) {
+			delete[] this->ancestors;
+			delete[] this->births;
+			delete[] this->splits;
+			delete[] this->split_times;
+			delete[] this->split_columns;
+			this->initialized = false;
+		}
+	}
+
+	~lineage () {
+		this->clear();
+	}
+};
+
+/* feature_stream follows the oscillations of the posterior's mRNA concentrations as each time step for analysis is produced, so their oscillation features can be calculated without storing every time step
+	notes:
+		This finds the same peaks and troughs osc_features_post does: a time step's concentration is a peak if it is greater than the ones just before and after it and a trough if it is smaller than both.
+		Rows of the analysis cl are given in order and the last one given may be given again to overwrite it, so a row only counts once a later row is given or the stream finishes. Rows never given count as 0, like the rows of a reset cl.
+		Only the concentrations at peaks and troughs and the three latest rows are kept, not the whole history.
+	todo:
+*/
+struct feature_stream {
+	bool initialized; // Whether or not this struct's data have been initialized
+	bool active; // Whether or not the current simulation's features are being streamed
+	int cells; // The number of cells
+	int cons[NUM_STREAM_CONS]; // The concentration levels to follow
+	int start; // The first row of the analysis time steps
+	int end; // One more than the last row of the analysis time steps
+	int next_row; // The next row to count (every earlier row has been counted)
+	int given_row; // The row given last, -1 if no row has been given
+	double* rows; // The latest rows, indexed by [row % STREAM_ROWS][concentration][cell]
+	double* row_zero; // The concentrations of row 0, which osc_features_post reads in place of peaks and troughs it did not find
+	int* num_peaks; // The number of peaks of each concentration of each cell, indexed by [concentration][cell]
+	int* num_troughs; // The number of troughs of each concentration of each cell
+	bool* stopped; // Whether each concentration of each cell has stopped being followed because its peaks and troughs stopped alternating
+	double** peaks; // The concentration at each peak of each concentration of each cell
+	double** troughs; // The concentration at each trough of each concentration of each cell
+	int* capacity; // The number of peaks and of troughs each concentration of each cell has room for
+	
+	feature_stream () {
+		this->initialized = false;
+		this->active = false;
+	}
+	
+	// Initializes the struct for the given number of cells
+	void initialize (int cells) {
+		this->clear();
+		static const int cons[NUM_STREAM_CONS] = {CMH1, CMH7, CMDELTA};
+		memcpy(this->cons, cons, sizeof(cons));
+		this->cells = cells;
+		int series = NUM_STREAM_CONS * cells;
+		this->rows = new double[STREAM_ROWS * series];
+		this->row_zero = new double[series];
+		this->num_peaks = new int[series];
+		this->num_troughs = new int[series];
+		this->stopped = new bool[series];
+		this->peaks = new double*[series];
+		this->troughs = new double*[series];
+		this->capacity = new int[series];
+		for (int i = 0; i < series; i++) {
+			this->capacity[i] = STREAM_POINTS;
+			this->peaks[i] = new double[STREAM_POINTS];
+			this->troughs[i] = new double[STREAM_POINTS];
+		}
+		this->initialized = true;
+		this->begin(false, 0, 0);
+	}
+	
+	// Starts following a simulation whose analysis rows run from start to end, if active
+	void begin (bool active, int start, int end) {
+		int series = NUM_STREAM_CONS * this->cells;
+		this->active = active;
+		this->start = start;
+		this->end = end;
+		this->next_row = 0;
+		this->given_row = -1;
+		memset(this->row_zero, 0, sizeof(double) * series);
+		memset(this->num_peaks, 0, sizeof(int) * series);
+		memset(this->num_troughs, 0, sizeof(int) * series);
+		memset(this->stopped, 0, sizeof(bool) * series);
+	}
+	
+	// Returns where to store the given row's concentrations, indexed by [concentration][cell], counting every earlier row
+	double* give (int row) {
+		if (row != this->given_row) {
+			this->count_before(row);
+			this->given_row = row;
+		}
+		return this->rows + (row % STREAM_ROWS) * NUM_STREAM_CONS * this->cells;
+	}
+	
+	// Counts every row up to the end of the analysis time steps
+	void finish () {
+		this->count_before(this->end);
+	}
+	
+	// Counts every row before the given one that has not been counted yet
+	void count_before (int row) {
+		int series = NUM_STREAM_CONS * this->cells;
+		for (; this->next_row < row && this->next_row < this->end; this->next_row++) {
+			int r = this->next_row;
+			double* cur = this->rows + (r % STREAM_ROWS) * series;
+			if (r != this->given_row) { // A row never given counts as 0
+				memset(cur, 0, sizeof(double) * series);
+			}
+			if (r == 0) {
+				memcpy(this->row_zero, cur, sizeof(double) * series);
+			}
+			int j = r - 1; // The row that now has both of its neighbors
+			if (j >= this->start + 1 && j < this->end - 1) {
+				double* before = this->rows + ((j - 1) % STREAM_ROWS) * series;
+				double* at = this->rows + (j % STREAM_ROWS) * series;
+				for (int i = 0; i < series; i++) {
+					if (this->stopped[i]) {
+						continue;
+					}
+					if (ABS(this->num_peaks[i] - this->num_troughs[i]) > 1) { // osc_features_post stops looking and discards the peaks
+						this->num_peaks[i] = 0;
+						this->stopped[i] = true;
+						continue;
+					}
+					if (before[i] < at[i] && at[i] > cur[i]) {
+						this->add(this->peaks, this->num_peaks, i, at[i]);
+					}
+					if (before[i] > at[i] && at[i] < cur[i]) {
+						this->add(this->troughs, this->num_troughs, i, at[i]);
+					}
+				}
+			}
+		}
+	}
+	
+	// Adds the given concentration to the given series' peaks or troughs
+	void add (double** points, int* num_points, int series, double con) {
+		if (num_points[series] == this->capacity[series]) {
+			this->grow(series);
+		}
+		points[series][num_points[series]++] = con;
+	}
+	
+	// Doubles the room for the given series' peaks and troughs
+	void grow (int series) {
+		int size = this->capacity[series];
+		double* new_peaks = new double[2 * size];
+		double* new_troughs = new double[2 * size];
+		memcpy(new_peaks, this->peaks[series], sizeof(double) * size);
+		memcpy(new_troughs, this->troughs[series], sizeof(double) * size);
+		delete[] this->peaks[series];
+		delete[] this->troughs[series];
+		this->peaks[series] = new_peaks;
+		this->troughs[series] = new_troughs;
+		this->capacity[series] = 2 * size;
+	}
+	
+	// Returns the concentration at the given peak of the given concentration and cell, or at row 0 if there is no such peak
+	double peak (int con, int cell, int index) {
+		int series = con * this->cells + cell;
+		return index >= 0 && index < this->num_peaks[series] ? this->peaks[series][index] : this->row_zero[series];
+	}
+	
+	// Returns the concentration at the given trough of the given concentration and cell, or at row 0 if there is no such trough
+	double trough (int con, int cell, int index) {
+		int series = con * this->cells + cell;
+		return index >= 0 && index < this->num_troughs[series] ? this->troughs[series][index] : this->row_zero[series];
+	}
+	
+	// Copies the state of another stream following the same number of cells
+	void copy_from (feature_stream& from) {
+		if (!this->initialized) {
+			this->initialize(from.cells);
+		}
+		int series = NUM_STREAM_CONS * this->cells;
+		this->active = from.active;
+		this->start = from.start;
+		this->end = from.end;
+		this->next_row = from.next_row;
+		this->given_row = from.given_row;
+		memcpy(this->rows, from.rows, sizeof(double) * STREAM_ROWS * series);
+		memcpy(this->row_zero, from.row_zero, sizeof(double) * series);
+		memcpy(this->num_peaks, from.num_peaks, sizeof(int) * series);
+		memcpy(this->num_troughs, from.num_troughs, sizeof(int) * series);
+		memcpy(this->stopped, from.stopped, sizeof(bool) * series);
+		for (int i = 0; i < series; i++) {
+			while (this->capacity[i] < from.capacity[i]) {
+				this->grow(i);
+			}
+			memcpy(this->peaks[i], from.peaks[i], sizeof(double) * from.num_peaks[i]);
+			memcpy(this->troughs[i], from.troughs[i], sizeof(double) * from.num_troughs[i]);
+		}
+	}
+	
+	// Frees the memory used by the struct
+	void clear () {
+		if (this->initialized) {
+			for (int i = 0; i < NUM_STREAM_CONS * this->cells; i++) {
+				delete[] this->peaks[i];
+				delete[] this->troughs[i];
+			}
+			delete[] this->rows;
+			delete[] this->row_zero;
+			delete[] this->num_peaks;
+			delete[] this->num_troughs;
+			delete[] this->stopped;
+			delete[] this->peaks;
+			delete[] this->troughs;
+			delete[] this->capacity;
+			this->initialized = false;
+		}
+	}
+	
+	~feature_stream () {
+		this->clear();
+	}
+};
+
+/* fail_watchdog predicts from a feature stream's mh1 peaks whether the wild type's posterior simulation will fail its conditions, so it can be stopped early
+	notes:
+		The peaks are checked once every expected period (WATCH_PERIOD minutes), so each check sees about one new peak per cell, which is measured against the latest trough.
+		A cell has stopped oscillating if none of the given number of checks in a row found a new peak, or if each of them found a peak that is not clear (its peak to trough ratio, measured like peaktotrough_end, is under WATCH_MIN_RATIO) and smaller than the one before it, i.e. the oscillations are decaying toward a fixed point.
+		The simulation is predicted to fail once every cell has stopped oscillating. Oscillations that are weak but growing are never predicted to fail.
+	todo:
+*/
+struct fail_watchdog {
+	bool initialized; // Whether or not this struct's data have been initialized
+	bool active; // Whether or not the current simulation is being watched
+	bool predicted_fail; // Whether or not the current simulation has been predicted to fail
+	int height; // The height of the tissue
+	int width_total; // The width of the tissue
+	int width; // The number of columns of cells to watch
+	int interval; // The number of rows between checks
+	int periods; // The number of checks in a row without clear oscillations after which a cell has stopped oscillating
+	int next_check; // The row of the next check
+	int* peaks_seen; // The number of mh1 peaks of each cell at the last check
+	int* quiet; // The number of checks in a row that found no new peak of each cell
+	int* decays; // The number of checks in a row that found a smaller peak that is not clear of each cell
+	double* amplitude; // The amplitude of the latest peak of each cell
+	
+	fail_watchdog () {
+		this->initialized = false;
+		this->active = false;
+		this->predicted_fail = false;
+	}
+	
+	// Initializes the struct for the given number of cells
+	void initialize (int cells) {
+		this->clear();
+		this->peaks_seen = new int[cells];
+		this->quiet = new int[cells];
+		this->decays = new int[cells];
+		this->amplitude = new double[cells];
+		this->initialized = true;
+		this->active = false;
+		this->predicted_fail = false;
+	}
+	
+	// Starts watching a simulation whose analysis rows start at start, if active
+	void begin (bool active, int start, int interval, int periods, int height, int width_total, int width) {
+		this->active = active;
+		this->predicted_fail = false;
+		if (active) {
+			int cells = height * width_total;
+			this->height = height;
+			this->width_total = width_total;
+			this->width = width;
+			this->interval = MAX(interval, 1);
+			this->periods = periods;
+			this->next_check = start + this->interval;
+			memset(this->peaks_seen, 0, sizeof(int) * cells);
+			memset(this->quiet, 0, sizeof(int) * cells);
+			memset(this->decays, 0, sizeof(int) * cells);
+			for (int i = 0; i < cells; i++) {
+				this->amplitude[i] = INFINITY;
+			}
+		}
+	}
+	
+	// Checks the stream's mh1 peaks if it is time to, returns whether the simulation is predicted to fail
+	bool check (feature_stream& fs, int row) {
+		if (!this->active || row < this->next_check) {
+			return false;
+		}
+		this->next_check = row + this->interval;
+		bool stopped = true;
+		for (int x = 0; x < this->height; x++) {
+			for (int y = 0; y < this->width; y++) {
+				int cell = x * this->width_total + y; // mh1 is the stream's first concentration level, so its series are indexed by cell
+				int num_peaks = fs.num_peaks[cell];
+				int num_troughs = fs.num_troughs[cell];
+				if (num_peaks <= this->peaks_seen[cell]) {
+					this->quiet[cell]++;
+				} else if (num_troughs > 0) {
+					double peak = fs.peaks[cell][num_peaks - 1];
+					double trough = fs.troughs[cell][num_troughs - 1];
+					double amplitude = peak - trough;
+					bool clear = (trough > 1 ? peak / trough : peak) >= WATCH_MIN_RATIO;
+					this->decays[cell] = (!clear && amplitude < this->amplitude[cell]) ? this->decays[cell] + 1 : 0;
+					this->amplitude[cell] = amplitude;
+					this->quiet[cell] = 0;
+				} else {
+					this->quiet[cell] = 0;
+				}
+				this->peaks_seen[cell] = num_peaks;
+				stopped = stopped && (this->quiet[cell] >= this->periods || this->decays[cell] >= this->periods);
+			}
+		}
+		this->predicted_fail = stopped;
+		return stopped;
+	}
+	
+	// Frees the memory used by the struct
+	void clear () {
+		if (this->initialized) {
+			delete[] this->peaks_seen;
+			delete[] this->quiet;
+			delete[] this->decays;
+			delete[] this->amplitude;
+			this->initialized = false;
+		}
+	}
+	
+	~fail_watchdog () {
+		this->clear();
+	}
+};
+
+/* checkpoint contains a posterior simulation's state at the earliest induction of the mutants that simulate exactly like one another until their inductions
+	notes:
+		The first of these mutants to reach the checkpoint's time stores it and the rest continue from it instead of simulating from the start again.
+		Rates and random number streams are not stored because begin_mutant resets them to the same state for every mutant.
+	todo:
+*/
+struct checkpoint {
+	int time; // The absolute time step the checkpoint is taken before, 0 if no mutants can share one in the current section
+	int baby_time; // The cyclical time step matching time
+	bool taken; // Whether or not the checkpoint has been stored for the current parameter set
+	bool shares[NUM_MUTANTS]; // Whether or not each mutant simulates like the others until the checkpoint
+	con_levels baby_cl; // A copy of the concentration levels used for simulating
+	con_levels cl; // A copy of the time steps before the checkpoint of the concentration levels used for analysis
+	feature_stream stream; // A copy of the posterior feature stream, used instead of cl when features are streamed
+
+	checkpoint () {
+		this->time = 0;
+		this->baby_time = 0;
+		this->taken = false;
+		memset(this->shares, 0, sizeof(this->shares));
+	}
+};
+
+/* tick_clock counts time in ticks of the processor's time stamp counter where there is one and in nanoseconds otherwise
+	notes:
+		Reading the time stamp counter takes a few cycles, so phases can be timed even when they run once per cell and time step. The number of ticks per second is measured over the time since the clock was created.
+	todo:
+*/
+struct tick_clock {
+	uint64_t start_ticks; // The ticks when the clock was created
+	timespec start_time; // The time when the clock was created
+	
+	tick_clock () {
+		this->start_ticks = now();
+		clock_gettime(CLOCK_MONOTONIC, &(this->start_time));
+	}
+	
+	// Returns the current ticks
+	static inline uint64_t now () {
+		#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+		#else
+			timespec time;
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+		#endif
+	}
+	
+	// Returns the seconds since the clock was created
+	double elapsed () {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		return (time.tv_sec - this->start_time.tv_sec) + (time.tv_nsec - this->start_time.tv_nsec) / 1e9;
+	}
+	
+	// Returns the number of ticks per second since the clock was created
+	double ticks_per_second () {
+		double seconds = this->elapsed();
+		return (seconds > 0) ? (now() - this->start_ticks) / seconds : 1;
+	}
+};
+
+/* profile contains the time a worker has spent in each phase of its simulations, split by section and mutant
+	notes:
+		Every worker's sim_data has its own profile so timing never needs a lock. The workers' profiles are added to the first worker's when their contexts are deleted (see delete_contexts), which is printed once the run ends (see print_profile).
+		Times are counted in ticks of the profile's clock, which starts when the profile is created.
+		Phases nest (e.g. split is called within the model), so a phase's time includes the time of every phase within it.
+		Phases outside of any mutant's simulation (i.e. printing a set's results) are counted in the extra section and mutant, NUM_SECTIONS and NUM_MUTANTS.
+	todo:
+*/
+struct profile {
+	int section; // The section being simulated, NUM_SECTIONS if no mutant is being simulated
+	int mutant; // The index of the mutant being simulated, NUM_MUTANTS if no mutant is being simulated
+	uint64_t ticks[NUM_PHASES][NUM_SECTIONS + 1][NUM_MUTANTS + 1]; // The ticks spent in each phase
+	uint64_t calls[NUM_PHASES][NUM_SECTIONS + 1][NUM_MUTANTS + 1]; // The number of times each phase was timed
+	tick_clock clock; // The clock the ticks are counted with
+	
+	profile () {
+		this->end();
+		memset(this->ticks, 0, sizeof(this->ticks));
+		memset(this->calls, 0, sizeof(this->calls));
+	}
+	
+	// Counts the following phases towards the given section and mutant
+	void begin (int section, int mutant) {
+		this->section = section;
+		this->mutant = mutant;
+	}
+	
+	// Counts the following phases towards no mutant
+	void end () {
+		this->section = NUM_SECTIONS;
+		this->mutant = NUM_MUTANTS;
+	}
+	
+	// Adds the given ticks to the given phase
+	inline void add (int phase, uint64_t ticks) {
+		this->ticks[phase][this->section][this->mutant] += ticks;
+		this->calls[phase][this->section][this->mutant]++;
+	}
+	
+	// Adds every phase of the given profile to this one
+	void merge (profile& other) {
+		for (int i = 0; i < NUM_PHASES; i++) {
+			for (int j = 0; j <= NUM_SECTIONS; j++) {
+				for (int k = 0; k <= NUM_MUTANTS; k++) {
+					this->ticks[i][j][k] += other.ticks[i][j][k];
+					this->calls[i][j][k] += other.calls[i][j][k];
+				}
+			}
+		}
+	}
+};
+
+/* trace_event contains one span of a worker's timeline
+	notes:
+		Fields that do not apply to the span's kind are -1.
+	todo:
+*/
+struct trace_event {
+	uint64_t start; // The ticks when the span started
+	uint64_t end; // The ticks when the span ended
+	int kind; // One of the TRACE_ macros, or TRACE_PHASE plus one of the PHASE_ macros
+	int set; // The index of the parameter set (the first lane's set for an ensemble)
+	int section; // The section
+	int mutant; // The index of the mutant
+};
+
+/* trace_buffer contains the latest spans of one worker thread's timeline
+	notes:
+		The buffer is a ring of TRACE_EVENTS spans allocated when it is created, so recording a span never allocates or locks. Once the ring is full each span replaces the oldest one.
+		Spans are recorded when they end, so a span is recorded after every span within it.
+		In ensemble mode every lane's context records into its worker's buffer, since the lanes are simulated on the same thread.
+	todo:
+*/
+struct trace_buffer {
+	trace_event* events; // The ring of spans
+	uint64_t count; // The number of spans ever recorded, the latest TRACE_EVENTS of which are in the ring
+	
+	trace_buffer () {
+		this->events = new trace_event[TRACE_EVENTS];
+		this->count = 0;
+	}
+	
+	~trace_buffer () {
+		delete[] this->events;
+	}
+	
+	// Records a span of the given kind that started at the given ticks and ends now
+	inline void record (int kind, uint64_t start, int set, int section, int mutant) {
+		trace_event& event = this->events[this->count & (TRACE_EVENTS - 1)];
+		event.start = start;
+		event.end = tick_clock::now();
+		event.kind = kind;
+		event.set = set;
+		event.section = section;
+		event.mutant = mutant;
+		this->count++;
+	}
+};
+
+/* trace_recorder contains every worker thread's timeline for the trace file (see print_trace)
+	notes:
+		There should be only one instance of trace_recorder, created with the first contexts and kept until the trace is printed so the timelines cover every batch in daemon mode.
+	todo:
+*/
+struct trace_recorder {
+	tick_clock clock; // The clock every span is timed with, whose start is time 0 of the trace
+	int num_buffers; // The number of worker threads
+	trace_buffer* buffers; // Each worker thread's timeline
+	
+	explicit trace_recorder (int num_buffers) {
+		this->num_buffers = num_buffers;
+		this->buffers = new trace_buffer[num_buffers];
+	}
+	
+	~trace_recorder () {
+		delete[] this->buffers;
+	}
+};
+
+/* trace_span records a span of the given kind in the given trace buffer from its creation until it goes out of scope
+	notes:
+		Nothing is recorded if the buffer is NULL, so declaring a span when not tracing costs only a check.
+	todo:
+*/
+struct trace_span {
+	trace_buffer* trace; // The buffer to record the span in, NULL if not tracing
+	int kind; // The kind of span (one of the TRACE_ macros)
+	int set; // The index of the parameter set, -1 if none
+	int section; // The section, -1 if none
+	int mutant; // The index of the mutant, -1 if none
+	uint64_t start; // The ticks when the span was created
+	
+	trace_span (trace_buffer* trace, int kind, int set, int section, int mutant) {
+		this->trace = trace;
+		this->kind = kind;
+		this->set = set;
+		this->section = section;
+		this->mutant = mutant;
+		this->start = (trace != NULL) ? tick_clock::now() : 0;
+	}
+	
+	~trace_span () {
+		if (this->trace != NULL) {
+			this->trace->record(this->kind, this->start, this->set, this->section, this->mutant);
+		}
+	}
+};
+
 /* sim_data contains simulation data, partially taken from input_params and partially derived from other information
 	notes:
-		There should be only one instance of sim_data at any time.
+		There should be only one instance of sim_data per worker thread.
 		sim_data copies some data from the input_params struct so simulation-irrelevant data does not have to be passed around in sim.cpp.
 	todo:
 */
@@ -568,6 +1616,8 @@ struct sim_data {
 	// Cutoff values
 	double max_con_thresh; // The maximum threshold concentrations can reach before the simulation is prematurely ended
 	int max_delay_size; // The maximum number of time steps any delay in the current parameter set takes plus 1 (so that baby_cl and each mutant know how many minutes to store)
+	int history_size; // The number of time steps baby_cl and each mutant store: max_delay_size rounded up to a power of two so cyclic time can be wrapped with a mask
+	int history_mask; // history_size - 1, used to wrap cyclic time with RING
 	
 	// Sizes
 	int width_total; // The width in cells of the PSM
@@ -580,18 +1630,35 @@ struct sim_data {
 	int** neighbors; // An array of neighbor indices for each cell position used in 2D simulations (2-cell and 1D calculate these on the fly)
 	int active_start; // The start of the active portion of the PSM
 	int active_end; // The end of the active portion of the PSM
+	con_levels step_inputs; // The delayed and neighbor-averaged values every cell reads in the current time step, gathered for the batched kernels (indexed by the SI_* macros, one time step deep)
 	
 	// PSM section and section-specific times
 	int section; // Posterior or anterior (sec_post or sec_ant)
 	int time_start; // The start time (in time steps) of the current simulation
 	int time_end; // The end time (in time steps) of the current simulation
-	int time_baby; // Time 0 for baby_cl at the end of a simulation
+	int time_baby; // The position of baby_cl's oldest time step (time 0 of its history) at the end of a simulation
+	checkpoint cp; // The posterior checkpoint mutants continue from (see plan_checkpoint)
+	lineage lin; // The ancestry of every cell, used to find where anterior cells were at the start of their delays
+	int* delay_indices; // Where each cell was at the start of its delays in the current anterior time step, indexed by [cell][mRNA delays then protein delays] (2 * NUM_INDICES per cell, see calculate_delay_indices)
+	bool stream_features; // Whether or not posterior oscillation features are calculated while simulating instead of from every stored time step (when no stored time steps are printed)
+	feature_stream stream; // The posterior oscillation features being calculated while simulating
+	int predict_fail; // The number of expected periods without clear mh1 oscillations in any cell after which the wild type is predicted to fail (0 disables the watchdog)
+	fail_watchdog watch; // The watchdog predicting whether the wild type's posterior simulation will fail
+
+	// Random numbers
+	int seed; // The seed used for the parameter set currently being simulated
+	rng_state rng_perturb; // The stream used to perturb each cell's rates
+	rng_state rng_split; // The stream used to assign parents when cells split
 	
 	// Mutants and condition scores
 	int num_active_mutants; // The number of mutants to simulate for each parameter set
 	double max_scores[NUM_SECTIONS]; // The maximum score possible for all mutants for each testing section
 	double max_score_all; // The maximum score possible for all mutants for all testing sections
 	
+	// Profiling and tracing
+	profile* prof; // The time spent in each phase of this sim_data's simulations, NULL if not profiling
+	trace_buffer* trace; // The timeline of the worker thread simulating with this sim_data, NULL if not tracing (see create_contexts)
+	
 	explicit sim_data (input_params& ip) {
 		this->step_size = ip.step_size;
 		this->time_total = ip.time_total;
@@ -603,6 +1670,8 @@ struct sim_data {
 		this->small_gran = ip.small_gran;
 		this->max_con_thresh = ip.max_con_thresh;
 		this->max_delay_size = 0;
+		this->history_size = 0;
+		this->history_mask = 0;
 		this->width_total = ip.width_total;
 		this->width_initial = ip.width_initial;
 		this->width_current = ip.width_initial;
@@ -618,13 +1687,20 @@ struct sim_data {
 		for (int k = 0; k < this->cells_total; k++) {
 			this->neighbors[k] = new int[num_neighbors];
 		}
+		this->step_inputs.initialize(0, NUM_STEP_INPUTS, 1, this->cells_total, 0);
+		this->delay_indices = new int[this->cells_total * 2 * NUM_INDICES];
 		this->section = 0;
 		this->time_start = 0;
 		this->time_end = 0;
 		this->time_baby = 0;
+		this->stream_features = !ip.print_cons && !ip.post_features;
+		this->predict_fail = ip.predict_fail;
+		this->seed = ip.seed;
 		this->num_active_mutants = ip.num_active_mutants;
 		memset(this->max_scores, 0, sizeof(this->max_scores));
 		this->max_score_all = 0;
+		this->prof = ip.print_profile ? new profile() : NULL;
+		this->trace = NULL;
 	}
 	
 	// Initializes the scores once mutants have been initialized
@@ -649,29 +1725,445 @@ struct sim_data {
 			delete[] this->neighbors[k];
 		}
 		delete[] this->neighbors;
+		delete[] this->delay_indices;
+		delete this->prof;
+	}
+};
+
+/* phase_timer times a phase from its creation until it goes out of scope, adding the time to the given simulation data's profile and recording the phase in its trace
+	notes:
+		Nothing is timed if neither profiling nor tracing, so declaring a timer then costs only a couple of checks.
+		Only the phases PHASE_TRACED accepts are recorded in the trace.
+	todo:
+*/
+struct phase_timer {
+	profile* prof; // The profile to add the time to, NULL if not profiling
+	trace_buffer* trace; // The buffer to record the phase in, NULL if not tracing or the phase is not traced
+	int phase; // The phase being timed (one of the PHASE_ macros)
+	uint64_t start; // The ticks when the timer was created
+	
+	phase_timer (sim_data& sd, int phase) {
+		this->prof = sd.prof;
+		this->trace = PHASE_TRACED(phase) ? sd.trace : NULL;
+		this->phase = phase;
+		this->start = (this->prof != NULL || this->trace != NULL) ? tick_clock::now() : 0;
+	}
+	
+	~phase_timer () {
+		if (this->prof != NULL) {
+			this->prof->add(this->phase, tick_clock::now() - this->start);
+		}
+		if (this->trace != NULL) {
+			this->trace->record(TRACE_PHASE + this->phase, this->start, -1, -1, -1);
+		}
 	}
 };
 
 /* input_data contains information for retrieving data from an input file
 	notes:
 		All input files should be read with read_file and an input_data struct, storing their contents in a string buffer.
+		The parameter sets file is the exception: it is opened with open_stream and read a block of whole lines at a time with read_stream, so the buffer only holds the current block.
 	todo:
 */
 struct input_data {
 	char* filename; // The path and name of the file
-	char* buffer; // A buffer to store the file's contents
-	int size; // The number of bytes the file's contents take up
+	char* buffer; // The file's contents, or the block of them being parsed if the file is parsed a block at a time
+	int size; // The number of bytes the buffer's contents take up
 	int index; // The current index to access the buffer from
+	FILE* file; // The file being read a block at a time, NULL if the whole file was read at once (see open_stream)
+	int capacity; // The number of bytes the buffer can take from the file when read a block at a time
+	int left; // The number of bytes of a partial line read after the block in the buffer, which start the next block
+	int line; // The number of lines the parser has finished, used to point at errors
+	int line_start; // The index in the buffer of the start of the line being parsed
+	char* map; // The file mapped into memory, NULL if the file was read instead (see map_file)
+	size_t map_length; // The number of bytes mapped, including the page of zeros after the file
+	size_t map_size; // The number of bytes the file takes up
+	size_t map_offset; // The offset in the mapped file of the next block to parse when the file is parsed a block at a time
 	
 	explicit input_data (char* filename) {
 		this->filename = filename;
 		this->buffer = NULL;
 		this->size = 0;
 		this->index = 0;
+		this->file = NULL;
+		this->capacity = 0;
+		this->left = 0;
+		this->line = 0;
+		this->line_start = 0;
+		this->map = NULL;
+		this->map_length = 0;
+		this->map_size = 0;
+		this->map_offset = 0;
 	}
 	
 	~input_data () {
-		mfree(this->buffer);
+		if (this->file != NULL) {
+			fclose(this->file);
+		}
+		if (this->map != NULL) { // The buffer points into the mapping
+			munmap(this->map, this->map_length);
+		} else {
+			mfree(this->buffer);
+		}
+	}
+};
+
+/* params_header contains the header of a binary parameter sets file
+	notes:
+		The header is followed by num_sets sets of num_rates doubles each, in the machine's byte order like the sets piped in by the sampler. Reading them skips parsing text entirely.
+		No text parameter sets file can start with the magic number, so files of either format can be given with -i.
+	todo:
+*/
+struct params_header {
+	uint32_t magic; // PARAMS_MAGIC
+	int32_t num_rates; // The number of rates in each set, which must be NUM_RATES
+	int64_t num_sets; // The number of sets in the file
+};
+
+/* params_stream contains the chunk of parameter sets most recently parsed from a parameter sets file, which is read a chunk at a time as the workers take sets
+	notes:
+		There should be only one instance of params_stream at any time.
+		Each chunk holds up to PARAMS_CHUNK sets, parsed by whichever worker takes the first set after the previous chunk is used up (see take_set). A worker copies the rates of each set it takes, so a chunk can be replaced as soon as its last set has been taken.
+		The delays of each chunk's sets are sized for separately, so a file of any length only needs the sizes its worst chunk needs and simulating starts once the first chunk is parsed.
+	todo:
+*/
+struct params_stream {
+	input_data* data; // The parameter sets file's input data
+	double** sets; // The sets of the current chunk
+	int chunk; // The index of the current chunk
+	int first_set; // The index of the current chunk's first set
+	int num_sets; // The number of sets in the current chunk
+	int delay_size; // The maximum delay size of the current chunk's sets (see calc_delay_size)
+	bool binary; // Whether or not the file is a binary parameter sets file (see params_header)
+	int64_t sets_left; // The number of sets in a binary file not yet read
+	
+	explicit params_stream (input_data* data) {
+		this->data = data;
+		this->binary = false;
+		this->sets_left = 0;
+		this->sets = new double*[PARAMS_CHUNK];
+		for (int i = 0; i < PARAMS_CHUNK; i++) {
+			this->sets[i] = new double[NUM_RATES];
+		}
+		this->chunk = -1;
+		this->first_set = 0;
+		this->num_sets = 0;
+		this->delay_size = 0;
+	}
+	
+	~params_stream () {
+		for (int i = 0; i < PARAMS_CHUNK; i++) {
+			delete[] this->sets[i];
+		}
+		delete[] this->sets;
+	}
+};
+
+/* set_results contains the output a worker produced for a single parameter set
+	notes:
+		Workers can finish sets out of order, so each set's output is buffered here until every earlier set's output has been written.
+	todo:
+*/
+struct set_results {
+	double score; // The cumulative score of every mutant
+	double mutant_scores[NUM_SECTIONS * NUM_MUTANTS]; // The score of every mutant in every section (mutant i of section s is at s * num_active_mutants + i)
+	ostringstream passed; // The set's lines for the passed file
+	ostringstream scores; // The set's lines for the scores file
+	ostringstream features; // The set's lines for the features file
+	ostringstream conditions; // The set's lines for the conditions file
+	
+	set_results () {
+		this->score = 0;
+		memset(this->mutant_scores, 0, sizeof(this->mutant_scores));
+	}
+};
+
+/* set_queue contains the parameter sets waiting to be simulated and the results waiting to be written, shared by every worker
+	notes:
+		There should be only one instance of set_queue at any time.
+		Every field that changes during simulations must only be accessed while holding lock (see held_lock).
+		When running as a library a worker that fails records its status instead of exiting, after which no worker takes another set and the status is reported once they have all finished (see simulate_queue).
+	todo:
+*/
+struct set_queue {
+	pthread_mutex_t lock; // The lock guarding the queue
+	double** sets; // The array of parameter sets
+	int num_sets; // The number of parameter sets
+	int next_set; // The index of the next set to hand out to a worker
+	int next_write; // The index of the next set whose results should be written
+	set_results** pending; // The results of finished sets that cannot be written until every earlier set has been
+	double* scores; // The score of every set, in set order
+	int sets_passed; // The number of sets that passed all conditions
+	bool keep_results; // Whether or not to keep every set's results in pending for the caller instead of writing them to the output files (used by the library)
+	params_stream* stream; // The stream to take sets from instead of sets, NULL if every set is already in sets (num_sets is then only the most that can be taken until the stream ends)
+	int status; // EXIT_SUCCESS, or the exit status of the first worker that failed
+	
+	explicit set_queue (double** sets, int num_sets) {
+		pthread_mutex_init(&(this->lock), NULL);
+		this->num_sets = 0;
+		this->pending = NULL;
+		this->scores = NULL;
+		this->keep_results = false;
+		this->stream = NULL;
+		this->begin(sets, num_sets);
+	}
+	
+	// Starts handing out the given parameter sets, forgetting the previous sets and their scores (used by daemon mode for every batch after the first)
+	void begin (double** sets, int num_sets) {
+		this->clear();
+		this->sets = sets;
+		this->num_sets = num_sets;
+		this->next_set = 0;
+		this->next_write = 0;
+		this->sets_passed = 0;
+		this->status = EXIT_SUCCESS;
+		if (num_sets == 0) { // mallocate refuses empty blocks, so an empty batch keeps pending and scores NULL
+			return;
+		}
+		this->pending = new set_results*[num_sets];
+		this->scores = new double[num_sets];
+		for (int i = 0; i < num_sets; i++) {
+			this->pending[i] = NULL;
+			this->scores[i] = 0;
+		}
+	}
+	
+	// Records that a worker failed with the given status, keeping the first failure's status
+	void fail (int status) {
+		pthread_mutex_lock(&(this->lock));
+		if (this->status == EXIT_SUCCESS) {
+			this->status = status;
+		}
+		pthread_mutex_unlock(&(this->lock));
+	}
+	
+	// Frees the pending results and scores of the current sets
+	void clear () {
+		for (int i = 0; i < this->num_sets; i++) {
+			delete this->pending[i];
+		}
+		delete[] this->pending;
+		delete[] this->scores;
+		this->pending = NULL;
+		this->scores = NULL;
+		this->num_sets = 0;
+	}
+	
+	~set_queue () {
+		this->clear();
+		pthread_mutex_destroy(&(this->lock));
+	}
+};
+
+/* held_lock holds the given lock from its creation until it goes out of scope
+	notes:
+		The lock is released even if quit throws an early_exit while it is held, so a worker that fails never leaves the others waiting for it.
+	todo:
+*/
+struct held_lock {
+	pthread_mutex_t* lock; // The lock held
+	
+	explicit held_lock (pthread_mutex_t& lock) {
+		this->lock = &lock;
+		pthread_mutex_lock(this->lock);
+	}
+	
+	~held_lock () {
+		pthread_mutex_unlock(this->lock);
+	}
+};
+
+/* cons_block contains a copy of the concentrations a mutant's simulation prints, taken so the simulation can go on while they are written (see print_concentrations)
+	notes:
+		The block owns its filename and concentrations.
+		Only one of cons and floats is used: binary and chunked files print floats, so only the floats are copied for them, while ASCII files print the doubles' own digits.
+	todo:
+*/
+struct cons_block {
+	char* filename; // The path and name of the file to write to
+	int section; // The section simulated (the posterior section's block creates the file and the anterior section's block adds to it)
+	int width; // The total width of the simulation
+	int height; // The height of the simulation
+	int big_gran; // The number of time steps between stored time steps
+	int first_step; // The index of the first time step copied, counted in stored time steps
+	int num_steps; // The number of time steps copied
+	int num_levels; // The number of concentration levels copied
+	int levels[CCONS_MAX_LEVELS]; // The indices of the concentration levels copied
+	double* cons; // The concentrations to print as text, indexed by [levels][time steps][cells] with cells ordered by their position relative to the active start of the PSM, NULL if printed as floats
+	float* floats; // The concentrations to print as floats, indexed like cons, NULL if printed as text
+	
+	cons_block (char* filename, int section, int width, int height, int big_gran, int first_step, int num_steps) {
+		this->filename = filename;
+		this->section = section;
+		this->width = width;
+		this->height = height;
+		this->big_gran = big_gran;
+		this->first_step = first_step;
+		this->num_steps = num_steps;
+		this->num_levels = 0;
+		this->cons = NULL;
+		this->floats = NULL;
+	}
+	
+	// Returns the size in bytes of the copied concentrations
+	uint64_t size () {
+		uint64_t values = (uint64_t)this->num_levels * this->num_steps * this->width * this->height;
+		return values * (this->cons != NULL ? sizeof(double) : sizeof(float));
+	}
+	
+	~cons_block () {
+		mfree(this->filename);
+		delete[] this->cons;
+		delete[] this->floats;
+	}
+};
+
+/* output_slot contains a slot of the output writer's queue (see output_writer)
+	notes:
+		sequence tells the slot's state: equal to the position a worker is pushing to, the slot is free; one more than the position the writer is popping from, the slot holds a record.
+	todo:
+*/
+struct output_slot {
+	uint64_t sequence; // The position the slot is ready for (see notes)
+	set_results* results; // The set's results to write to the result files, NULL if the record is concentrations or the end of output
+	cons_block* block; // The concentrations to write, NULL if the record is results or the end of output
+};
+
+/* output_writer contains the queue of records the workers hand to the background thread that writes the output files
+	notes:
+		There should be only one instance of output_writer at any time.
+		The queue is a bounded lock-free queue of OUTPUT_QUEUE_SIZE slots: any worker can push, claiming a position by advancing head, and only the writer pops. A worker only waits if every slot is full.
+		ready counts the records pushed but not yet popped so the writer can sleep while there are none.
+		Records are popped in the order their positions were claimed, so a worker's records (e.g. a mutant's posterior and anterior concentrations) are written in the order it pushed them.
+		Concentrations can be far bigger than results, so besides the slots the queue also limits the bytes of concentrations waiting to OUTPUT_QUEUE_BYTES (one block is always let in, however big).
+	todo:
+*/
+struct output_writer {
+	output_slot slots[OUTPUT_QUEUE_SIZE]; // The queue's slots
+	char pad_slots[SHM_LINE];
+	uint64_t head; // The next position to push to (advanced by the workers)
+	char pad_head[SHM_LINE - sizeof(uint64_t)];
+	uint64_t block_bytes; // The bytes of concentrations pushed but not yet written (added to by the workers, subtracted from by the writer)
+	char pad_block_bytes[SHM_LINE - sizeof(uint64_t)];
+	uint64_t tail; // The next position to pop from (only used by the writer)
+	sem_t ready; // The number of records waiting to be popped
+	pthread_t thread; // The writer's thread
+	input_params* ip; // The program's input parameters
+	
+	// Output files
+	ofstream* file_passed;
+	ofstream* file_scores;
+	ofstream* file_features;
+	ofstream* file_conditions;
+	
+	output_writer (input_params* ip, ofstream* file_passed, ofstream* file_scores, ofstream* file_features, ofstream* file_conditions) {
+		for (uint64_t i = 0; i < OUTPUT_QUEUE_SIZE; i++) {
+			this->slots[i].sequence = i;
+			this->slots[i].results = NULL;
+			this->slots[i].block = NULL;
+		}
+		this->head = 0;
+		this->block_bytes = 0;
+		this->tail = 0;
+		sem_init(&(this->ready), 0, 0);
+		this->ip = ip;
+		this->file_passed = file_passed;
+		this->file_scores = file_scores;
+		this->file_features = file_features;
+		this->file_conditions = file_conditions;
+	}
+	
+	~output_writer () {
+		sem_destroy(&(this->ready));
+	}
+};
+
+/* sim_context contains everything a worker thread needs to simulate parameter sets independently of every other worker
+	notes:
+		Workers never share a context. The first context borrows the sim_data, rates, and mutant data created in main while the others allocate their own copies.
+	todo:
+*/
+struct sim_context {
+	int index; // The index of the worker that owns this context
+	pthread_t thread; // The worker's thread (unused if the first context is run on the main thread)
+	bool owns_data; // Whether or not sd, rs, and mds were allocated for this context and must be freed with it
+	input_params* ip; // The program's input parameters, shared by every worker and read-only during simulations
+	set_queue* queue; // The queue to take parameter sets from and give results to
+	char** dirnames_cons; // The array of mutant directory paths
+	sim_data* sd; // The worker's simulation data
+	rates* rs; // The worker's rates
+	mutant_data* mds; // The worker's array of mutant data
+	con_levels cl; // The worker's concentration levels for analysis and storage
+	con_levels baby_cl; // The worker's concentration levels for simulating
+	int chunk; // The chunk of the streamed parameter sets file the worker's current set came from (see params_stream)
+	
+	sim_context () {
+		this->index = 0;
+		this->chunk = 0;
+		this->owns_data = false;
+		this->ip = NULL;
+		this->queue = NULL;
+		this->dirnames_cons = NULL;
+		this->sd = NULL;
+		this->rs = NULL;
+		this->mds = NULL;
+	}
+};
+
+/* ensemble contains everything a worker needs to simulate several parameter sets at once, one per lane of the batched kernels
+	notes:
+		Each lane has its own sim_context for everything but the simulation itself: seeds, rates, mutant data, analysis, and output. The simulation runs once for every lane on interleaved concentrations and rates, where cell k of lane l is stored at index k * lanes + l.
+		Ensembles are only used for posterior-only simulations, where cells never split and every lane runs the same number of time steps.
+	todo:
+*/
+struct ensemble {
+	pthread_t thread; // The worker's thread (unused if the first ensemble is run on the main thread)
+	int lanes; // The number of parameter sets simulated at once
+	sim_context* ctxs; // The context of each lane
+	con_levels baby_cl; // Interleaved concentration levels for simulating (time in this cl is treated cyclically)
+	con_levels rates_active; // Interleaved active rates, stored as one concentration level per rate
+	double* rs[NUM_RATES]; // Each interleaved rate's row, arranged like the active rates the kernels take
+	con_levels step_inputs; // Interleaved step inputs (see sim_data's step_inputs)
+	int* set_nums; // The set each lane is simulating, -1 if the lane is idle
+	bool* active; // Whether or not each lane is still simulating mutants (lanes stop early when short circuiting)
+	bool* passed; // Whether or not each lane's current mutant is still within the concentration bounds
+	double* temp_rates; // Each lane's knockout rates (2 per lane) so knockouts can be quickly applied and reverted
+	set_results** results; // Each lane's results
+	checkpoint cp; // The posterior checkpoint of the interleaved concentration levels (each lane's analysis concentration levels are stored in the lane's own checkpoint)
+	bool* passed_checkpoint; // Whether or not each lane was still within the concentration bounds when the checkpoint was taken
+
+	ensemble () {
+		this->lanes = 0;
+	}
+	
+	// Initializes the ensemble's lanes with the given contexts and sizes its interleaved data for the given simulation data
+	void initialize (int lanes, sim_context* ctxs, sim_data& sd) {
+		int cells = sd.cells_total * lanes;
+		this->lanes = lanes;
+		this->ctxs = ctxs;
+		this->baby_cl.initialize(MIN_CON_LEVEL, NUM_CON_LEVELS, sd.history_size, cells, sd.active_start);
+		this->rates_active.initialize(0, NUM_RATES, 1, cells, 0);
+		for (int i = 0; i < NUM_RATES; i++) {
+			this->rs[i] = this->rates_active.cons[i][0];
+		}
+		this->step_inputs.initialize(0, NUM_STEP_INPUTS, 1, cells, 0);
+		this->set_nums = new int[lanes];
+		this->active = new bool[lanes];
+		this->passed = new bool[lanes];
+		this->temp_rates = new double[2 * lanes];
+		this->results = new set_results*[lanes];
+		this->passed_checkpoint = new bool[lanes];
+	}
+	
+	~ensemble () {
+		if (this->lanes > 0) {
+			delete[] this->set_nums;
+			delete[] this->active;
+			delete[] this->passed;
+			delete[] this->temp_rates;
+			delete[] this->results;
+			delete[] this->passed_checkpoint;
+		}
 	}
 };
 
@@ -816,5 +2308,59 @@ struct cd_indices {
 	{}
 };
 
+/* sb_args contains arguments for the batched kernels, which calculate a block of consecutive cells at once
+	notes:
+		This struct is just a wrapper used to minimize the number of arguments passed into the batched kernels.
+	todo:
+*/
+struct sb_args {
+	sim_data& sd; // Simulation data
+	double** rs; // Active rates
+	con_levels& cl; // Concentration levels
+	con_levels& inputs; // Gathered step inputs (see sim_data's step_inputs)
+	int time_prev; // The previous time step
+	int time_cur; // The current time step
+	int cell; // The first cell of the block
+	double* oe; // The overexpression rate of each mRNA in the current time step
+	
+	explicit sb_args (sim_data& sd, double** rs, con_levels& cl, con_levels& inputs, int time_prev, int time_cur, double oe[]) :
+		sd(sd), rs(rs), cl(cl), inputs(inputs), time_prev(time_prev), time_cur(time_cur), cell(0), oe(oe)
+	{}
+};
+
+/* segclock contains everything a library context needs to evaluate batches of parameter sets for the program it is embedded in
+	notes:
+		The library's caller only sees this struct as an opaque handle (see segclock.hpp). Everything in it is created by segclock_create and the first batch and then kept between batches, like in daemon mode.
+		The mutant data, queue, and contexts are sized by the delays of the sets, so they are NULL until the first batch arrives.
+	todo:
+*/
+struct segclock {
+	input_params ip; // The context's input parameters, filled in from the caller's configuration
+	sim_data* sd; // The simulation data borrowed by the first worker
+	rates* rs; // The rates borrowed by the first worker
+	mutant_data* mds; // The mutant data borrowed by the first worker
+	char** dirnames_cons; // The array of mutant directory paths (all NULL since nothing is printed)
+	set_queue* queue; // The queue of the current batch's sets, which keeps every set's results for the caller
+	sim_context* contexts; // The array of every worker's contexts
+	ensemble* ensembles; // The array of every worker's ensembles, NULL if not in ensemble mode
+	double** sets; // The current batch's parameter sets
+	line_buffer output; // Everything the program prints during a call, of which the last line is kept for error messages
+	int status; // EXIT_SUCCESS if the context can be used, otherwise the status of the failure that broke it
+	string error; // The message of the failure that broke the context
+	string text; // The text given to the caller by the latest request for a set's features or conditions
+	
+	segclock () {
+		this->sd = NULL;
+		this->rs = NULL;
+		this->mds = NULL;
+		this->dirnames_cons = NULL;
+		this->queue = NULL;
+		this->contexts = NULL;
+		this->ensembles = NULL;
+		this->sets = NULL;
+		this->status = EXIT_SUCCESS;
+	}
+};
+
 #endif
 
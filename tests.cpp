@@ -232,6 +232,83 @@ double test_MESPBOVER_mutant_ant (mutant_data& md, features& wtfeat) {
     return (md.conds_passed[SEC_ANT][0] * md.cond_scores[SEC_ANT][0]) + (md.conds_passed[SEC_ANT][1] * md.cond_scores[SEC_ANT][1]);
 }
 
+/*
+The demand functions declare which anterior features (see feature_demand) the matching test above reads, from the mutant's own features (demand) and from the wild type's (wtdemand).
+*/
+
+void demand_wildtype_ant (feature_demand& demand, feature_demand&) {
+	demand.need(FD_PERIOD_ANT, IMH1); // Also tests condition 0 (the Giudicelli test) while finding the periods
+	demand.need(FD_SYNC_ANT, IMH1);
+	demand.need(FD_AMPLITUDE_ANT, IMDELTA);
+	demand.need(FD_AMPLITUDE_POST, IMDELTA);
+	demand.need(FD_COMP, IMMESPA);
+	demand.need(FD_COMP, IMMESPB);
+}
+
+void demand_delta_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_AMPLITUDE_POST, IMH1);
+	demand.need(FD_SYNC_ANT, IMH1);
+	demand.need(FD_AMPLITUDE_ANT, IMH1);
+	demand.need(FD_AMPLITUDE_ANT, IMMESPA);
+	demand.need(FD_SYNC_ANT, IMMESPB);
+	wtdemand.need(FD_AMPLITUDE_POST, IMH1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPA);
+}
+
+void demand_her7over_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_AMPLITUDE_POST_TIME, IMH1, 0.5);
+	demand.need(FD_AMPLITUDE_POST_TIME, IMH7, 0.5);
+	demand.need(FD_AMPLITUDE_POST_TIME, IMDELTA, 0.5);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH1, 0.5);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH7, 0.5);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMMESPA, 0.5);
+	demand.need(FD_SYNC_TIME, IMDELTA, 1);
+	demand.need(FD_SYNC_TIME, IMMESPB, 1.5);
+	wtdemand.need(FD_AMPLITUDE_POST, IMH1);
+	wtdemand.need(FD_AMPLITUDE_POST, IMH7);
+	wtdemand.need(FD_AMPLITUDE_POST, IMDELTA);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH7);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPA);
+}
+
+void demand_her1over_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_AMPLITUDE_POST_TIME, IMH1, 0.5);
+	demand.need(FD_AMPLITUDE_POST_TIME, IMH7, 0.5);
+	demand.need(FD_AMPLITUDE_POST_TIME, IMDELTA, 0.5);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH1, 0.5);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH7, 0.5);
+	wtdemand.need(FD_AMPLITUDE_POST, IMH1);
+	wtdemand.need(FD_AMPLITUDE_POST, IMH7);
+	wtdemand.need(FD_AMPLITUDE_POST, IMDELTA);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH7);
+}
+
+void demand_DAPT_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_SYNC_TIME, IMH1, 3);
+	demand.need(FD_SYNC_TIME, IMH7, 3);
+	demand.need(FD_SYNC_TIME, IMMESPB, 3);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH1, 3);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMH7, 3);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMMESPA, 2);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMH7);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPA);
+}
+
+void demand_MESPAOVER_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMMESPB, 1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPB);
+}
+
+void demand_MESPBOVER_mutant_ant (feature_demand& demand, feature_demand& wtdemand) {
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMMESPA, 1);
+	demand.need(FD_AMPLITUDE_ANT_TIME, IMMESPB, 1);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPA);
+	wtdemand.need(FD_AMPLITUDE_ANT, IMMESPB);
+}
 
 int test_wildtype_wave (pair<int, int> waves[], int num_waves, mutant_data& md, int wlength_post, int wlength_ant) {
 	md.conds_passed[SEC_WAVE][0] = md.conds_passed[SEC_WAVE][0] && (2 <= num_waves && num_waves <= 3); //JY WT.4.
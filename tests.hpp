@@ -55,6 +55,13 @@ double test_her1her7_mutant_ant(mutant_data&, features&);
 double test_DAPT_mutant_ant(mutant_data&, features&);
 double test_MESPAOVER_mutant_ant (mutant_data& md, features& wtfeat);
 double test_MESPBOVER_mutant_ant (mutant_data& md, features& wtfeat);
+void demand_wildtype_ant(feature_demand&, feature_demand&);
+void demand_delta_mutant_ant(feature_demand&, feature_demand&);
+void demand_her7over_mutant_ant(feature_demand&, feature_demand&);
+void demand_her1over_mutant_ant(feature_demand&, feature_demand&);
+void demand_DAPT_mutant_ant(feature_demand&, feature_demand&);
+void demand_MESPAOVER_mutant_ant(feature_demand&, feature_demand&);
+void demand_MESPBOVER_mutant_ant(feature_demand&, feature_demand&);
 int test_wildtype_wave (pair<int, int>[], int, mutant_data&, int, int);
 int test_her1_wave (pair<int, int>[], int, mutant_data&, int, int);
 